@@ -29,6 +29,307 @@
 #  define PUP(a) *++(a)
 #endif
 
+#ifdef INFFAST_WIDE
+
+/*
+   Wide variant of inflate_fast(), see inffast.h.  Same entry assumptions and
+   return states as the stock version below, except that it needs
+   strm->avail_in >= INFLATE_FAST_MIN_INPUT and strm->avail_out >=
+   INFLATE_FAST_MIN_OUTPUT.
+
+   Notes:
+
+    - The bit buffer is topped up to at least 24 bits with a single 32-bit
+      load.  Only the whole bytes that fit are consumed; the leftover bits of
+      the word sit above "bits" in hold and are exactly the bits the next
+      refill will OR in again, so hold is only masked on the way out.
+
+    - After a literal, if at least 15 bits are still buffered the next code
+      is decoded without refilling.  That makes a loop iteration at most one
+      literal plus a length/distance pair: 63 bits of codes.  With up to 31
+      bits buffered on exit and a refill looking two bytes past what it
+      consumes, that is INFLATE_FAST_MIN_INPUT == 13 bytes of input.
+
+    - Matches are copied a word at a time and may store up to three bytes
+      past their end, hence INFLATE_FAST_MIN_OUTPUT == 1 + 258 + 3.  Those
+      bytes are within avail_out and always overwritten by the next output.
+ */
+
+typedef unsigned int __attribute__((may_alias, aligned(1))) inf_word;
+
+#define LOAD32(p) (*(const inf_word FAR *)(p))
+#define STORE32(p, w) (*(inf_word FAR *)(p) = (w))
+
+#define REFILL() \
+    do { \
+        hold |= (unsigned long)LOAD32(in) << bits; \
+        in += (31 - bits) >> 3; \
+        bits |= 24; \
+    } while (0)
+
+#define PULLBYTE() \
+    do { \
+        hold |= (unsigned long)(*in++) << bits; \
+        bits += 8; \
+    } while (0)
+
+/* copy len bytes from the window, exactly, a word at a time while possible */
+local unsigned char FAR *copy_exact(out, from, len)
+unsigned char FAR *out;
+const unsigned char FAR *from;
+unsigned len;
+{
+    while (len >= 4) {
+        STORE32(out, LOAD32(from));
+        out += 4;
+        from += 4;
+        len -= 4;
+    }
+    while (len) {
+        *out++ = *from++;
+        len--;
+    }
+    return out;
+}
+
+/* copy len >= 1 bytes from dist back in the output, possibly overlapping */
+local unsigned char FAR *copy_match(out, dist, len)
+unsigned char FAR *out;
+unsigned dist;
+unsigned len;
+{
+    const unsigned char FAR *from = out - dist;
+    unsigned char FAR *stop = out + len;
+    inf_word pat;
+
+    if (dist >= 4) {
+        do {
+            STORE32(out, LOAD32(from));
+            out += 4;
+            from += 4;
+        } while (out < stop);
+    }
+    else if (dist == 1) {                       /* run of one byte */
+        pat = from[0] * 0x01010101U;
+        do {
+            STORE32(out, pat);
+            out += 4;
+        } while (out < stop);
+    }
+    else if (dist == 2) {                       /* run of a byte pair */
+        pat = (from[0] | (from[1] << 8)) * 0x00010001U;
+        do {
+            STORE32(out, pat);
+            out += 4;
+        } while (out < stop);
+    }
+    else {
+        do {
+            *out++ = *from++;
+        } while (out < stop);
+    }
+    return stop;
+}
+
+void inflate_fast(strm, start)
+z_streamp strm;
+unsigned start;         /* inflate()'s starting value for strm->avail_out */
+{
+    struct inflate_state FAR *state;
+    unsigned char FAR *in;      /* local strm->next_in */
+    unsigned char FAR *last;    /* while in < last, enough input available */
+    unsigned char FAR *out;     /* local strm->next_out */
+    unsigned char FAR *beg;     /* inflate()'s initial strm->next_out */
+    unsigned char FAR *end;     /* while out < end, enough space available */
+#ifdef INFLATE_STRICT
+    unsigned dmax;              /* maximum distance from zlib header */
+#endif
+    unsigned wsize;             /* window size or zero if not using window */
+    unsigned whave;             /* valid bytes in the window */
+    unsigned write;             /* window write index */
+    unsigned char FAR *window;  /* allocated sliding window, if wsize != 0 */
+    unsigned long hold;         /* local strm->hold */
+    unsigned bits;              /* local strm->bits */
+    code const FAR *lcode;      /* local strm->lencode */
+    code const FAR *dcode;      /* local strm->distcode */
+    unsigned lmask;             /* mask for first level of length codes */
+    unsigned dmask;             /* mask for first level of distance codes */
+    code this;                  /* retrieved table entry */
+    unsigned op;                /* code bits, operation, extra bits, or */
+                                /*  window position, window bytes to copy */
+    unsigned len;               /* match length, unused bytes */
+    unsigned dist;              /* match distance */
+    unsigned char FAR *from;    /* where to copy match from */
+
+    /* copy state to local variables */
+    state = (struct inflate_state FAR *)strm->state;
+    in = strm->next_in;
+    last = in + (strm->avail_in - (INFLATE_FAST_MIN_INPUT - 1));
+    out = strm->next_out;
+    beg = out - (start - strm->avail_out);
+    end = out + (strm->avail_out - (INFLATE_FAST_MIN_OUTPUT - 1));
+#ifdef INFLATE_STRICT
+    dmax = state->dmax;
+#endif
+    wsize = state->wsize;
+    whave = state->whave;
+    write = state->write;
+    window = state->window;
+    hold = state->hold;
+    bits = state->bits;
+    lcode = state->lencode;
+    dcode = state->distcode;
+    lmask = (1U << state->lenbits) - 1;
+    dmask = (1U << state->distbits) - 1;
+
+    /* decode literals and length/distances until end-of-block or not enough
+       input data or output space */
+    do {
+        if (bits < 15)
+            REFILL();
+        this = lcode[hold & lmask];
+      dolen:
+        op = (unsigned)(this.bits);
+        hold >>= op;
+        bits -= op;
+        op = (unsigned)(this.op);
+        if (op == 0) {                          /* literal */
+            Tracevv((stderr, this.val >= 0x20 && this.val < 0x7f ?
+                    "inflate:         literal '%c'\n" :
+                    "inflate:         literal 0x%02x\n", this.val));
+            *out++ = (unsigned char)(this.val);
+            if (bits >= 15) {                   /* next code already here */
+                this = lcode[hold & lmask];
+                if (this.op == 0) {
+                    hold >>= this.bits;
+                    bits -= this.bits;
+                    *out++ = (unsigned char)(this.val);
+                }
+                else
+                    goto dolen;
+            }
+        }
+        else if (op & 16) {                     /* length base */
+            len = (unsigned)(this.val);
+            op &= 15;                           /* number of extra bits */
+            if (op) {
+                if (bits < op)
+                    PULLBYTE();
+                len += (unsigned)hold & ((1U << op) - 1);
+                hold >>= op;
+                bits -= op;
+            }
+            Tracevv((stderr, "inflate:         length %u\n", len));
+            if (bits < 15)
+                REFILL();
+            this = dcode[hold & dmask];
+          dodist:
+            op = (unsigned)(this.bits);
+            hold >>= op;
+            bits -= op;
+            op = (unsigned)(this.op);
+            if (op & 16) {                      /* distance base */
+                dist = (unsigned)(this.val);
+                op &= 15;                       /* number of extra bits */
+                if (bits < op) {
+                    PULLBYTE();
+                    if (bits < op)
+                        PULLBYTE();
+                }
+                dist += (unsigned)hold & ((1U << op) - 1);
+#ifdef INFLATE_STRICT
+                if (dist > dmax) {
+                    strm->msg = (char *)"invalid distance too far back";
+                    state->mode = BAD;
+                    break;
+                }
+#endif
+                hold >>= op;
+                bits -= op;
+                Tracevv((stderr, "inflate:         distance %u\n", dist));
+                op = (unsigned)(out - beg);     /* max distance in output */
+                if (dist > op) {                /* see if copy from window */
+                    op = dist - op;             /* distance back in window */
+                    if (op > whave) {
+                        strm->msg = (char *)"invalid distance too far back";
+                        state->mode = BAD;
+                        break;
+                    }
+                    from = window;
+                    if (write == 0)             /* very common case */
+                        from += wsize - op;
+                    else if (write < op) {      /* wrap around window */
+                        from += wsize + write - op;
+                        op -= write;
+                        if (op < len) {         /* some from end of window */
+                            len -= op;
+                            out = copy_exact(out, from, op);
+                            from = window;      /* rest from start */
+                            op = write;
+                        }
+                    }
+                    else                        /* contiguous in window */
+                        from += write - op;
+                    /* op bytes available at from */
+                    if (op < len) {             /* some from window */
+                        len -= op;
+                        out = copy_exact(out, from, op);
+                        out = copy_match(out, dist, len);   /* rest from output */
+                    }
+                    else
+                        out = copy_exact(out, from, len);
+                }
+                else                            /* copy direct from output */
+                    out = copy_match(out, dist, len);
+            }
+            else if ((op & 64) == 0) {          /* 2nd level distance code */
+                this = dcode[this.val + (hold & ((1U << op) - 1))];
+                goto dodist;
+            }
+            else {
+                strm->msg = (char *)"invalid distance code";
+                state->mode = BAD;
+                break;
+            }
+        }
+        else if ((op & 64) == 0) {              /* 2nd level length code */
+            this = lcode[this.val + (hold & ((1U << op) - 1))];
+            goto dolen;
+        }
+        else if (op & 32) {                     /* end-of-block */
+            Tracevv((stderr, "inflate:         end of block\n"));
+            state->mode = TYPE;
+            break;
+        }
+        else {
+            strm->msg = (char *)"invalid literal/length code";
+            state->mode = BAD;
+            break;
+        }
+    } while (in < last && out < end);
+
+    /* return unused bytes, and drop the look-ahead bits above them */
+    len = bits >> 3;
+    in -= len;
+    bits -= len << 3;
+    hold &= (1U << bits) - 1;
+
+    /* update state and return */
+    strm->next_in = in;
+    strm->next_out = out;
+    strm->avail_in = (unsigned)(in < last ?
+        (INFLATE_FAST_MIN_INPUT - 1) + (last - in) :
+        (INFLATE_FAST_MIN_INPUT - 1) - (in - last));
+    strm->avail_out = (unsigned)(out < end ?
+        (INFLATE_FAST_MIN_OUTPUT - 1) + (end - out) :
+        (INFLATE_FAST_MIN_OUTPUT - 1) - (out - end));
+    state->hold = hold;
+    state->bits = bits;
+    return;
+}
+
+#else /* !INFFAST_WIDE */
+
 /*
    Decode literal, length, and distance codes and write out the resulting
    literal and match bytes until either not enough input or output is
@@ -301,6 +602,8 @@ unsigned start;         /* inflate()'s starting value for strm->avail_out */
     return;
 }
 
+#endif /* INFFAST_WIDE */
+
 /*
    inflate_fast() speedups that turned out slower (on a PowerPC G3 750CXe):
    - Using bit fields for code structure
@@ -8,4 +8,21 @@
    subject to change. Applications should only use zlib.h.
  */
 
+/* Little-endian targets that can do unaligned 32-bit loads and stores (every
+   x86 from the 386 up) get the wide inflate_fast(): one load per bit buffer
+   refill and word-sized match copies.  It looks further ahead in the input
+   and may write up to three bytes past the end of a match, so it needs a
+   little more slack on both sides than the byte-at-a-time version.  Define
+   NO_INFFAST_WIDE to build the stock decoder instead.
+ */
+#if !defined(NO_INFFAST_WIDE) && defined(__GNUC__) && \
+    (defined(__i386__) || defined(__x86_64__))
+#  define INFFAST_WIDE
+#  define INFLATE_FAST_MIN_INPUT 13
+#  define INFLATE_FAST_MIN_OUTPUT 262
+#else
+#  define INFLATE_FAST_MIN_INPUT 6
+#  define INFLATE_FAST_MIN_OUTPUT 258
+#endif
+
 void inflate_fast OF((z_streamp strm, unsigned start));
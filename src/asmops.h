@@ -77,5 +77,16 @@ static inline uint32_t inl(uint16_t port)
 /* delay for about 1us */
 #define iodelay() outb(0, 0x80)
 
+/* pointer to a physical address in the first page (IVT, BIOS data area). The
+ * empty asm hides the constant from the compiler, which otherwise treats it as
+ * a null pointer and warns about every access.
+ */
+static inline void *lowmem_ptr(uint32_t addr)
+{
+	void *ptr;
+	asm("" : "=r"(ptr) : "0"(addr));
+	return ptr;
+}
+
 
 #endif	/* ASMOPS_H_ */
@@ -2,6 +2,10 @@
 #define BOOT_H_
 
 extern unsigned char low_mem_buffer[];
+/* start of the memory given to COM programs, above the low_mem_buffer area used
+ * as a bounce buffer for BIOS calls
+ */
+extern unsigned char com_mem_base[];
 extern int boot_drive_number;
 
 #endif	/* BOOT_H_ */
@@ -21,6 +21,8 @@
 	.section .boot2,"ax"
 
 	.set main_load_addr, 0x100000
+	# "256Z" magic number at the start of compressed kernel images
+	.set pack_magic, 0x5a363532
 	.set drive_number, 0x7bec
 
 	# make sure any BIOS call didn't re-enable interrupts
@@ -154,16 +156,34 @@ unreal:
 mainsz_msg: .asciz "Main program size: "
 mainsz_msg2: .asciz " ("
 mainsz_msg3: .asciz " sectors)\n"
+packsz_msg: .asciz "Packed image size: "
+loadtm_msg: .asciz "Load time: "
+loadtm_msg2: .asciz " ms\n"
 
 first_sect: .long 0
 sect_left: .long 0
 cur_track: .long 0
 trk_sect: .long 0
 dest_ptr: .long 0
+cur_lba: .long 0
+# max sectors per int 13h extended read, halved whenever the BIOS refuses
+lba_chunk: .long 127
+# extended reads go to a 64k aligned bounce area instead of buffer, so that a
+# full chunk never crosses a 64k boundary, which BIOSes enforcing the ISA DMA
+# limits reject. Nothing else uses that memory while the kernel loads.
+.set LBA_BUF_SEG, 0x2000
+pack_checked: .byte 0
+load_start_ticks: .long 0
 
 load_main:
 	movl $main_load_addr, dest_ptr
 
+	# keep interrupts enabled while loading, so that the BIOS tick count
+	# keeps running and we can report how long it took
+	call get_bios_ticks
+	mov %eax, load_start_ticks
+	sti
+
 	# calculate first sector
 	mov $_boot2_size, %eax
 	add $511, %eax
@@ -198,6 +218,50 @@ load_main:
 	mov $mainsz_msg3, %esi
 	call putstr
 
+	# hard disks (and USB sticks in HDD emulation) are read in large chunks
+	# with the int 13h extensions if available. Floppies go through CHS.
+	call check_lba
+	jc ldloop
+	mov first_sect, %eax
+	mov %eax, cur_lba
+
+ldloop_lba:
+	mov sect_left, %ecx
+	cmp lba_chunk, %ecx
+	jbe 0f
+	mov lba_chunk, %ecx
+0:	call read_lba
+	jc lba_fallback
+
+	# copy to high memory
+	push %ecx
+	mov $LBA_BUF_SEG << 4, %esi
+	mov dest_ptr, %edi
+	shl $9, %ecx
+	add %ecx, dest_ptr
+	shr $2, %ecx
+	addr32 rep movsl
+	pop %ecx
+
+	add %ecx, cur_lba
+	sub %ecx, sect_left
+	call check_packed
+	cmpl $0, sect_left
+	jg ldloop_lba
+	jmp ldloop_done
+
+	# the extended read failed even one sector at a time, carry on with the
+	# track loader from the sector it got stuck on
+lba_fallback:
+	mov $lbafb_msg, %esi
+	call putstr
+	mov cur_lba, %eax
+	movzxw sect_per_track, %ecx
+	xor %edx, %edx
+	div %ecx
+	mov %eax, cur_track
+	mov %edx, trk_sect
+
 	# read a whole track into the buffer (or partial first track)
 ldloop:
 	movzxw sect_per_track, %ecx
@@ -226,11 +290,24 @@ ldloop:
 
 	pop %ecx
 	sub %ecx, sect_left
-	ja ldloop
+	call check_packed
+	cmpl $0, sect_left
+	jg ldloop
 
-	# the BIOS might have enabled interrupts
+ldloop_done:
 	cli
 
+	mov $loadtm_msg, %esi
+	call putstr
+	call get_bios_ticks
+	sub load_start_ticks, %eax
+	# 18.2 ticks per second, about 55ms per tick
+	mov $55, %ecx
+	mul %ecx
+	call print_num
+	mov $loadtm_msg2, %esi
+	call putstr
+
 	# if we were loaded from floppy, turn all floppy motors off
 	movb drive_number, %bl
 	and $0x80, %bl
@@ -246,6 +323,147 @@ ldloop:
 
 	ret
 
+	# compressed kernel images (see src/unpack/entry.s) start with a short
+	# jump over a header with the magic number and the packed image size.
+	# The sector count calculated from _main_size is for the unpacked image,
+	# replace it with the actual number of sectors left to load.
+	# Called after every read, but only checks once, after the first one.
+check_packed:
+	testb $1, pack_checked
+	jnz 0f
+	movb $1, pack_checked
+
+	mov $main_load_addr, %ebx
+	cmpl $pack_magic, 4(%ebx)
+	jnz 0f
+
+	mov $packsz_msg, %esi
+	call putstr
+	mov 8(%ebx), %eax
+	call print_num
+	mov $mainsz_msg2, %esi
+	call putstr
+	add $511, %eax
+	shr $9, %eax
+	call print_num
+	mov $mainsz_msg3, %esi
+	call putstr
+
+	# subtract the sectors already loaded
+	mov dest_ptr, %ecx
+	sub $main_load_addr, %ecx
+	shr $9, %ecx
+	sub %ecx, %eax
+	mov %eax, sect_left
+0:	ret
+
+	# sets carry if the int 13h extensions are not available for the boot
+	# drive, or if it's a floppy drive
+check_lba:
+	movb drive_number, %dl
+	test $0x80, %dl
+	jz 0f
+	mov $0x41, %ah
+	mov $0x55aa, %bx
+	int $0x13
+	jc 0f
+	cmp $0xaa55, %bx
+	jnz 0f
+	# bit 0: disk address packet functions (42h-44h) supported
+	test $1, %cx
+	jz 0f
+	clc
+	ret
+0:	stc
+	ret
+
+	.align 4
+	# disk address packet for int 13h function 42h (16 bytes)
+lba_dap:
+	.byte 16
+	.byte 0
+dap_count: .short 0
+dap_offs: .short 0
+dap_seg: .short 0
+dap_lba: .long 0
+	.long 0
+
+rdlba_msg: .asciz "Reading sector: "
+rdcount_msg: .asciz " count: "
+
+	# reads up to ecx sectors starting from cur_lba into the LBA bounce area, and
+	# returns the number of sectors actually read in ecx. When a read fails,
+	# retry with half the sectors, and keep the smaller chunk size for the
+	# rest of the load. Single sector reads get 3 attempts before giving up
+	# and returning with carry set.
+read_lba:
+	movw $3, read_retries
+
+	movw $LBA_BUF_SEG, dap_seg
+	movw $0, dap_offs
+
+lba_try:
+	mov $rdlba_msg, %esi
+	call putstr
+	mov cur_lba, %eax
+	call print_num
+	mov $rdcount_msg, %esi
+	call putstr
+	mov %ecx, %eax
+	call print_num
+	mov $rdlast_msg, %esi
+	call putstr
+
+	mov %cx, dap_count
+	mov cur_lba, %eax
+	mov %eax, dap_lba
+	mov $lba_dap, %si
+	mov $0x42, %ah
+	movb drive_number, %dl
+	push %ecx
+	int $0x13
+	pop %ecx
+	jnc 2f
+
+	mov $rdfail_msg, %esi
+	call putstr
+
+	# reset controller before trying again
+	xor %ah, %ah
+	movb drive_number, %dl
+	int $0x13
+
+	cmp $1, %ecx
+	jbe 0f
+	shr $1, %ecx
+	mov %ecx, lba_chunk
+	jmp lba_try
+
+0:	decw read_retries
+	jnz lba_try
+	stc
+	ret
+
+2:	mov $rdok_msg, %esi
+	call putstr
+	clc
+	ret
+
+lbafb_msg: .asciz "Extended read failed, falling back to CHS\n"
+
+	# returns the BIOS timer tick count since midnight in eax
+get_bios_ticks:
+	push %ecx
+	push %edx
+	xor %ah, %ah
+	int $0x1a
+	mov %cx, %ax
+	shl $16, %eax
+	mov %dx, %ax
+	pop %edx
+	pop %ecx
+	ret
+
 rdtrk_msg: .asciz "Reading track: "
 rdcyl_msg: .asciz " - cyl: "
 rdhead_msg: .asciz " head: "
@@ -800,3 +1018,8 @@ boot_drive_number:
 buffer:
 	.global low_mem_buffer
 low_mem_buffer:
+	# once the kernel runs, the first 64k are the bounce buffer for its BIOS
+	# calls, and COM programs are loaded above, where disk I/O done on their
+	# behalf can't overwrite them
+	.global com_mem_base
+	.set com_mem_base, low_mem_buffer + 0x10000
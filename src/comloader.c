@@ -16,22 +16,107 @@ You should have received a copy of the GNU General Public License
 along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
 #include "comloader.h"
+#include "dosserv.h"
+#include "speedgov.h"
 #include "boot.h"
 #include "int86.h"
 #include "intr.h"
+#include "timer.h"
+#include "video.h"
+#include "asmops.h"
 
 #define COMRUN_INT	0xf0
 
+/* IVT and BIOS data area */
+#define LOWMEM_SNAP_SIZE	0x500
+#define IVT_SIZE			0x400
+
+#define TEXT_COLS	80
+#define TEXT_ROWS	25
+
+#define CRTC_ADDR	0x3d4
+#define CRTC_DATA	0x3d5
+#define CRTC_CURSTART	0x0a
+#define CRTC_CUREND		0x0b
+#define CRTC_CURLOC_H	0x0e
+#define CRTC_CURLOC_L	0x0f
+
+/* prefetch cache limits */
+#define CACHE_MAX_ENTRIES	8
+#define CACHE_MAX_BYTES		(256 * 1024)
+
+struct cache_entry {
+	char *path;		/* absolute path, null for unused slots */
+	void *data;
+	int size;
+	unsigned long last_use;
+};
+
+static char *abs_path(const char *path);
+static struct cache_entry *cache_find(const char *path);
+static struct cache_entry *cache_slot(int size);
+static void cache_drop(struct cache_entry *ent);
+static void print_stats(int (*print)(const char*, ...));
+
+static struct cache_entry cache[CACHE_MAX_ENTRIES];
+static int cache_bytes;
+static unsigned long cache_clock;
+
+static unsigned char lowmem_snap[LOWMEM_SNAP_SIZE];
+
+/* BIOS data area fields put back after a COM program runs, the video state
+ * only. The timer, keyboard and disk fields belong to BIOS handlers which kept
+ * running, and rewinding them would lose ticks, keys and drive state.
+ */
+static const struct {
+	uint16_t addr, size;
+} bda_restore[] = {
+	{0x410, 2},		/* equipment word */
+	{0x449, 0x1e},	/* video mode, columns, page, cursors, CRTC port */
+	{0x484, 7},		/* rows, char height, EGA/VGA control and flags */
+	{0x4a8, 4}		/* video save pointer table */
+};
+
+/* name and size of the loaded program, for looking up its speed profile */
+static char com_name[PATH_MAX];
+static int com_size;
+
+static uint16_t text_snap[TEXT_COLS * TEXT_ROWS];
+static unsigned char crtc_snap[4];
+static const unsigned char crtc_snap_regs[] = {
+	CRTC_CURSTART, CRTC_CUREND, CRTC_CURLOC_H, CRTC_CURLOC_L
+};
+
+
+int com_max_size(void)
+{
+	return (unsigned char*)0xa0000 - (com_mem_base + 256);
+}
+
 int load_com_binary(const char *path)
 {
 	FILE *fp;
-	unsigned char *dest = low_mem_buffer + 256;
-	int max_size = (unsigned char*)0xa0000 - dest;
+	unsigned char *dest = com_mem_base + 256;
+	int max_size = com_max_size();
 	int sz;
+	struct cache_entry *ent;
 
 	printf("com loader: max size: %d\n", max_size);
 
+	if((ent = cache_find(abs_path(path)))) {
+		memcpy(dest, ent->data, ent->size);
+		ent->last_use = ++cache_clock;
+		strcpy(com_name, ent->path);
+		com_size = ent->size;
+		printf("com loader: loaded %d bytes from the cache\n", ent->size);
+		return 0;
+	}
+
 	if(!(fp = fopen(path, "rb"))) {
 		printf("com loader: failed to open file: %s\n", path);
 		return -1;
@@ -39,13 +124,165 @@ int load_com_binary(const char *path)
 	sz = fread(dest, 1, max_size, fp);
 	fclose(fp);
 
+	strncpy(com_name, path, sizeof com_name - 1);
+	com_size = sz;
+
 	printf("com loader: loaded %d bytes\n", sz);
 	return 0;
 }
 
+int load_com_image(const char *name, const void *data, int size)
+{
+	if(size > com_max_size()) {
+		printf("com loader: image too large: %d bytes\n", size);
+		return -1;
+	}
+	memcpy(com_mem_base + 256, data, size);
+	if(name) {
+		strncpy(com_name, name, sizeof com_name - 1);
+	} else {
+		com_name[0] = 0;
+	}
+	com_size = size;
+	return 0;
+}
+
+int com_prefetch(const char *path)
+{
+	FILE *fp;
+	long sz;
+	void *data;
+	unsigned long start = nticks;
+	struct cache_entry *ent;
+
+	path = abs_path(path);
+	if((ent = cache_find(path))) {
+		ent->last_use = ++cache_clock;
+		return 0;
+	}
+
+	if(!(fp = fopen(path, "rb"))) {
+		return -1;
+	}
+	sz = filesize(fp);
+	if(sz <= 0 || sz > com_max_size() || sz > CACHE_MAX_BYTES) {
+		fclose(fp);
+		return -1;
+	}
+	if(!(data = malloc(sz))) {
+		fclose(fp);
+		return -1;
+	}
+	if(fread(data, 1, sz, fp) != sz) {
+		printf("com loader: failed to prefetch: %s\n", path);
+		free(data);
+		fclose(fp);
+		return -1;
+	}
+	fclose(fp);
+
+	if(!(ent = cache_slot(sz)) || !(ent->path = malloc(strlen(path) + 1))) {
+		free(data);
+		return -1;
+	}
+	strcpy(ent->path, path);
+	ent->data = data;
+	ent->size = sz;
+	ent->last_use = ++cache_clock;
+	cache_bytes += sz;
+
+	printf("com loader: prefetched %s: %ld bytes in %lu ms\n", path, sz,
+			TICKS_TO_MSEC(nticks - start));
+	return 0;
+}
+
+void *com_cache_lookup(const char *path, int *size)
+{
+	struct cache_entry *ent;
+
+	if(!(ent = cache_find(abs_path(path)))) {
+		return 0;
+	}
+	ent->last_use = ++cache_clock;
+	*size = ent->size;
+	return ent->data;
+}
+
+void com_cache_flush(void)
+{
+	int i;
+
+	for(i=0; i<CACHE_MAX_ENTRIES; i++) {
+		if(cache[i].path) {
+			cache_drop(cache + i);
+		}
+	}
+}
+
+static char *abs_path(const char *path)
+{
+	static char buf[PATH_MAX];
+	int len;
+
+	if(*path == '/' || !getcwd(buf, sizeof buf)) {
+		return (char*)path;
+	}
+	len = strlen(buf);
+	snprintf(buf + len, sizeof buf - len, "%s%s", len && buf[len - 1] == '/' ? "" : "/", path);
+	return buf;
+}
+
+static struct cache_entry *cache_find(const char *path)
+{
+	int i;
+
+	for(i=0; i<CACHE_MAX_ENTRIES; i++) {
+		if(cache[i].path && strcmp(cache[i].path, path) == 0) {
+			return cache + i;
+		}
+	}
+	return 0;
+}
+
+/* evicts least recently used entries until there is a free slot, and room for
+ * size more bytes in the cache
+ */
+static struct cache_entry *cache_slot(int size)
+{
+	int i;
+	struct cache_entry *ent, *lru;
+
+	for(;;) {
+		ent = lru = 0;
+		for(i=0; i<CACHE_MAX_ENTRIES; i++) {
+			if(!cache[i].path) {
+				if(!ent) ent = cache + i;
+			} else if(!lru || cache[i].last_use < lru->last_use) {
+				lru = cache + i;
+			}
+		}
+		if(ent && cache_bytes + size <= CACHE_MAX_BYTES) {
+			return ent;
+		}
+		if(!lru) return 0;
+
+		cache_drop(lru);
+	}
+}
+
+static void cache_drop(struct cache_entry *ent)
+{
+	cache_bytes -= ent->size;
+	free(ent->path);
+	free(ent->data);
+	ent->path = 0;
+	ent->data = 0;
+}
+
 #define ORIG_IRQ_OFFS	8
 #define KBIRQ	1
 #define KBINTR	(KBIRQ + ORIG_IRQ_OFFS)
+#define TMINTR	ORIG_IRQ_OFFS
 
 extern int run_com_entry;
 extern int rm_keyb_intr;
@@ -56,20 +293,59 @@ struct vector {
 	uint16_t offs, seg;
 } __attribute__((packed));
 
+extern int rm_timer_intr;
+extern struct vector rm_timer_orig;
+extern volatile uint32_t rm_timer_ticks;
+extern uint32_t rm_timer_limit;
+extern volatile unsigned char rm_timer_expired;
+extern volatile uint32_t rm_stat_retraces;
+extern volatile uint32_t rm_stat_modechg;
+extern volatile uint32_t rm_stat_key;
+extern unsigned char rm_stat_vr;
+extern unsigned char rm_stat_vrsamp;
+extern volatile unsigned char rm_stat_mode;
+
 int run_com_binary(void)
 {
-	int intr;
-	struct vector *ivt = 0;
+	return run_com_binary_limit(0);
+}
+
+int run_com_binary_limit(unsigned long msec)
+{
+	int i, intr;
+	struct vector *ivt = lowmem_ptr(0);
 	struct int86regs regs = {0};
 
+	/* calibrates the CPU speed on first use, do it before touching the PIC */
+	speedgov_start(speedgov_lookup(com_name[0] ? com_name : 0, com_mem_base + 256, com_size));
+
+	rm_timer_ticks = 0;
+	rm_timer_expired = 0;
+	rm_stat_retraces = 0;
+	rm_stat_modechg = 0;
+	rm_stat_key = 0;
+	rm_stat_vr = 0;
+	rm_stat_vrsamp = com_sample_retraces;
+	rm_stat_mode = *(volatile unsigned char*)lowmem_ptr(0x449);
+	rm_timer_limit = msec ? MSEC_TO_TICKS(msec) : 0;
+	if(msec && !rm_timer_limit) {
+		rm_timer_limit = 1;
+	}
+
 	/* Restore original PIC mapping
 	 * otherwise the DOS int21h interrupt and keyboard IRQ1 would conflict
-	 * The pmode mapping is restored at the end of int86
+	 * The pmode mapping is restored at the end of int86_rm
 	 */
 	intr = get_intr_flag();
 	disable_intr();
 	prog_pic(8);
 
+	/* whatever the program does to the IVT and the video state in the BIOS
+	 * data area is undone when it returns, including our own handlers
+	 * installed below
+	 */
+	memcpy(lowmem_snap, lowmem_ptr(0), LOWMEM_SNAP_SIZE);
+
 	/* setup real mode interrupt handler for running COM files */
 	ivt[COMRUN_INT].seg = 0;
 	ivt[COMRUN_INT].offs = (uint32_t)&run_com_entry;
@@ -79,8 +355,82 @@ int run_com_binary(void)
 	ivt[0x21].offs = (uint32_t)&dos_int21h_entry;
 	ivt[0x29].seg = 0;
 	ivt[0x29].offs = (uint32_t)&dos_int29h_entry;
+	/* the PIT is still running at TICK_FREQ_HZ, count ticks for the time limit */
+	rm_timer_orig = ivt[TMINTR];
+	ivt[TMINTR].seg = 0;
+	ivt[TMINTR].offs = (uint32_t)&rm_timer_intr;
+
+	dos_begin_run();
+	int86_rm(COMRUN_INT, &regs);
 
-	int86(COMRUN_INT, &regs);
+	/* the PIC masks are restored by int86_rm, put back everything else */
+	disable_intr();
+	memcpy(lowmem_ptr(0), lowmem_snap, IVT_SIZE);
+	for(i=0; i<sizeof bda_restore / sizeof *bda_restore; i++) {
+		memcpy(lowmem_ptr(bda_restore[i].addr), lowmem_snap + bda_restore[i].addr,
+				bda_restore[i].size);
+	}
+	reset_timer_rate();
+	outb(inb(0x61) & 0xfc, 0x61);	/* PC speaker off */
 	set_intr_flag(intr);
+
+	speedgov_stop();
+	dos_end_run();
+	com_run_msec = TICKS_TO_MSEC(rm_timer_ticks);
+	com_timeout = rm_timer_expired;
+
+	com_stats.ticks = rm_timer_ticks;
+	com_stats.retraces = rm_stat_retraces;
+	com_stats.retraces_valid = rm_stat_vrsamp;
+	com_stats.mode_changes = rm_stat_modechg;
+	com_stats.last_mode = rm_stat_mode;
+	com_stats.key_msec = rm_stat_key ? (long)TICKS_TO_MSEC(rm_timer_ticks - (rm_stat_key - 1)) : -1;
+	print_stats(ser_printf);
 	return regs.eax;
 }
+
+void com_print_stats(void)
+{
+	print_stats(printf);
+}
+
+static void print_stats(int (*print)(const char*, ...))
+{
+	print("run stats: %lu ticks (%lu ms)%s\n", com_stats.ticks,
+			TICKS_TO_MSEC(com_stats.ticks), com_timeout ? ", time limit" : "");
+	if(com_stats.retraces_valid) {
+		print("  vertical retraces at tick time: %lu\n", com_stats.retraces);
+	}
+	print("  video mode changes: %d, last mode: %xh\n", com_stats.mode_changes,
+			com_stats.last_mode);
+	if(com_stats.key_msec >= 0) {
+		print("  first key press to return: %ld ms\n", com_stats.key_msec);
+	} else {
+		print("  no key pressed\n");
+	}
+}
+
+void com_save_screen(void)
+{
+	int i;
+
+	memcpy(text_snap, (void*)0xb8000, sizeof text_snap);
+	for(i=0; i<sizeof crtc_snap; i++) {
+		outb(crtc_snap_regs[i], CRTC_ADDR);
+		crtc_snap[i] = inb(CRTC_DATA);
+	}
+}
+
+void com_restore_screen(void)
+{
+	int i;
+
+	/* also resets the palette and the font */
+	set_vga_mode(3);
+
+	memcpy((void*)0xb8000, text_snap, sizeof text_snap);
+	for(i=0; i<sizeof crtc_snap; i++) {
+		outb(crtc_snap_regs[i], CRTC_ADDR);
+		outb(crtc_snap[i], CRTC_DATA);
+	}
+}
@@ -18,7 +18,64 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #ifndef COMLOADER_H_
 #define COMLOADER_H_
 
+/* run time of the last COM program in milliseconds, and whether it was
+ * stopped by the time limit of run_com_binary_limit
+ */
+unsigned long com_run_msec;
+int com_timeout;
+
+/* what the last COM program did, as seen by the real mode timer and keyboard
+ * handlers while it was running
+ */
+struct com_stats {
+	unsigned long ticks;
+	unsigned long retraces;	/* vertical retraces caught at tick time */
+	int retraces_valid;		/* retraces are only sampled with com_sample_retraces */
+	int mode_changes;		/* video mode changes in the BIOS data area */
+	int last_mode;
+	long key_msec;			/* first key press to return, -1 if no key */
+};
+struct com_stats com_stats;
+
+/* sample the vertical retrace at every tick for the run statistics. Off by
+ * default, polling the input status register resets the attribute controller
+ * flip-flop, which breaks programs that write to it around the timer.
+ */
+int com_sample_retraces;
+
+/* maximum size of a COM program, which has to fit below the VGA memory */
+int com_max_size(void);
+
 int load_com_binary(const char *path);
+/* copy an already loaded COM program into place. name is the file it came from,
+ * used for looking up its speed profile, and may be null.
+ */
+int load_com_image(const char *name, const void *data, int size);
+
+/* read a COM program into the in-memory LRU cache checked by load_com_binary.
+ * Meant to be called at idle time for the entry the user is likely to run next.
+ */
+int com_prefetch(const char *path);
+/* returns the cached contents of a file and its size, or null if it's not in
+ * the cache. The data belongs to the cache, copy it before the next prefetch.
+ */
+void *com_cache_lookup(const char *path, int *size);
+/* drops everything in the cache, call after remounting filesystems */
+void com_cache_flush(void);
+
 int run_com_binary(void);
+/* same as run_com_binary, but forces the program to exit after msec
+ * milliseconds, or never if msec is 0.
+ */
+int run_com_binary_limit(unsigned long msec);
+
+/* print the statistics of the last run */
+void com_print_stats(void);
+
+/* save the 80x25 text screen and cursor before running a COM program, and
+ * put them back afterwards, instead of redrawing everything
+ */
+void com_save_screen(void);
+void com_restore_screen(void);
 
 #endif	/* COMLOADER_H_ */
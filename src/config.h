@@ -30,6 +30,9 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 /* allocate 64k for stack */
 #define STACK_PAGES		16
 
+/* run BIOS calls in virtual 8086 mode instead of dropping to real mode */
+#define ENABLE_V86
+
 #undef ENABLE_GDB_STUB
 #define GDB_SERIAL_PORT	0
 
@@ -22,6 +22,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "serial.h"
 #include "asmops.h"
 #include "config.h"
+#include "fbcon.h"
 
 #define VIRT_ROWS	200
 
@@ -42,6 +43,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #define VMEM_CHAR(c, attr) \
 	(((uint16_t)(c) & 0xff) | ((uint16_t)(attr) << 8))
 
+static void text_putchar(int c);
 static void scroll(void);
 static void crtc_cursor(int x, int y);
 static void crtc_setstart(int y);
@@ -90,6 +92,11 @@ void con_show_cursor(int show)
 {
 #ifdef CON_TEXTMODE
 	unsigned char val = cy0 & 0x1f;
+
+	if(fbcon_on) {
+		fbcon_show_cursor(show);
+		return;
+	}
 	if(!show) {
 		val |= 0x20;
 	}
@@ -101,6 +108,10 @@ void con_show_cursor(int show)
 void con_cursor(int x, int y)
 {
 #ifdef CON_TEXTMODE
+	if(fbcon_on) {
+		fbcon_cursor(x, y);
+		return;
+	}
 	cursor_x = x;
 	cursor_y = y;
 	crtc_cursor(x, y);
@@ -147,6 +158,11 @@ unsigned char con_getattr(void)
 void con_clear(void)
 {
 #ifdef CON_TEXTMODE
+	if(fbcon_on) {
+		fbcon_clear(txattr);
+		return;
+	}
+
 	memset16(TEXT_ADDR, VMEM_CHAR(' ', txattr), NCOLS * NROWS);
 
 	start_line = 0;
@@ -169,43 +185,91 @@ void con_putchar(int c)
 {
 #ifdef CON_TEXTMODE
 	if(scr_on) {
-		switch(c) {
-		case '\n':
-			linefeed();
-		case '\r':
-			cursor_x = 0;
-			crtc_cursor(cursor_x, cursor_y);
-			break;
-
-		case '\t':
-			cursor_x = (cursor_x & 0x7) + 8;
-			if(cursor_x >= NCOLS) {
-				linefeed();
-				cursor_x = 0;
-			}
-			crtc_cursor(cursor_x, cursor_y);
-			break;
+		if(fbcon_on) {
+			char ch = c;
+			fbcon_write(&ch, 1, txattr);
+			fbcon_flush();
+		} else {
+			text_putchar(c);
+		}
+	}
+#endif
 
-		case '\b':
-			if(cursor_x > 0) cursor_x--;
-			con_putchar_scr(cursor_x, cursor_y, ' ');
-			crtc_cursor(cursor_x, cursor_y);
-			break;
+#ifdef CON_SERIAL
+	ser_putchar(c);
+#endif
+}
 
-		default:
-			con_putchar_scr(cursor_x, cursor_y, c);
+/* like a series of con_putchar calls, except that in graphics mode nothing is
+ * drawn until the next con_flush or con_putchar.
+ */
+void con_write(const char *buf, int sz)
+{
+	int i;
 
-			if(++cursor_x >= NCOLS) {
-				linefeed();
-				cursor_x = 0;
+#ifdef CON_TEXTMODE
+	if(scr_on) {
+		if(fbcon_on) {
+			fbcon_write(buf, sz, txattr);
+		} else {
+			for(i=0; i<sz; i++) {
+				text_putchar(buf[i]);
 			}
-			crtc_cursor(cursor_x, cursor_y);
 		}
 	}
 #endif
 
 #ifdef CON_SERIAL
-	ser_putchar(c);
+	for(i=0; i<sz; i++) {
+		ser_putchar(buf[i]);
+	}
+#endif
+}
+
+void con_flush(void)
+{
+#ifdef CON_TEXTMODE
+	if(scr_on && fbcon_on) {
+		fbcon_flush();
+	}
+#endif
+}
+
+static void text_putchar(int c)
+{
+#ifdef CON_TEXTMODE
+	switch(c) {
+	case '\n':
+		linefeed();
+	case '\r':
+		cursor_x = 0;
+		crtc_cursor(cursor_x, cursor_y);
+		break;
+
+	case '\t':
+		cursor_x = (cursor_x & 0x7) + 8;
+		if(cursor_x >= NCOLS) {
+			linefeed();
+			cursor_x = 0;
+		}
+		crtc_cursor(cursor_x, cursor_y);
+		break;
+
+	case '\b':
+		if(cursor_x > 0) cursor_x--;
+		con_putchar_scr(cursor_x, cursor_y, ' ');
+		crtc_cursor(cursor_x, cursor_y);
+		break;
+
+	default:
+		con_putchar_scr(cursor_x, cursor_y, c);
+
+		if(++cursor_x >= NCOLS) {
+			linefeed();
+			cursor_x = 0;
+		}
+		crtc_cursor(cursor_x, cursor_y);
+	}
 #endif
 }
 
@@ -213,6 +277,12 @@ void con_putchar_scr(int x, int y, int c)
 {
 #ifdef CON_TEXTMODE
 	uint16_t *ptr = (uint16_t*)TEXT_ADDR;
+
+	if(fbcon_on) {
+		fbcon_putchar_scr(x, y, c, txattr);
+		fbcon_flush();
+		return;
+	}
 	ptr[(y + start_line) * NCOLS + x] = VMEM_CHAR(c, txattr);
 #endif
 }
@@ -228,6 +298,14 @@ int con_printf(int x, int y, const char *fmt, ...)
 	vsnprintf(buf, 80, fmt, ap);
 	va_end(ap);
 
+	if(fbcon_on) {
+		while(*ptr) {
+			fbcon_putchar_scr(x++, y, *ptr++, txattr);
+		}
+		fbcon_flush();
+		return ptr - buf;
+	}
+
 	while(*ptr && x < 80) {
 		con_putchar_scr(x++, y, *ptr++);
 	}
@@ -80,6 +80,8 @@ void con_setattr(unsigned char attr);
 unsigned char con_getattr(void);
 void con_clear(void);
 void con_putchar(int c);
+void con_write(const char *buf, int sz);
+void con_flush(void);
 
 void con_putchar_scr(int x, int y, int c);
 int con_printf(int x, int y, const char *fmt, ...);
@@ -0,0 +1,64 @@
+/*
+256boss - bootable launcher for 256byte intros
+Copyright (C) 2018-2019  John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY, without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <string.h>
+#include "cpu.h"
+
+static const char *featname[] = {"fpu", "tsc", "mmx", "sse", "sse2"};
+static const unsigned int featbit[] = {
+	CPU_FEAT_FPU, CPU_FEAT_TSC, CPU_FEAT_MMX, CPU_FEAT_SSE, CPU_FEAT_SSE2
+};
+
+void init_cpu(void)
+{
+	int i;
+	unsigned int regs[4];
+	char vendor[13];
+
+	cpu_features = 0;
+	if(!cpuid_supported()) {
+		printf("CPU: no cpuid, assuming a 386/486\n");
+		return;
+	}
+
+	cpuid(0, regs);
+	memcpy(vendor, regs + 1, 4);
+	memcpy(vendor + 4, regs + 3, 4);
+	memcpy(vendor + 8, regs + 2, 4);
+	vendor[12] = 0;
+
+	if(regs[0] >= 1) {
+		cpuid(1, regs);
+		cpu_features = regs[3];
+	}
+
+	/* SSE instructions fault unless the OS declares it saves their state */
+	if(cpu_has(CPU_FEAT_SSE | CPU_FEAT_FXSR)) {
+		cpu_enable_sse();
+	} else {
+		cpu_features &= ~(CPU_FEAT_SSE | CPU_FEAT_SSE2);
+	}
+
+	printf("CPU: %s family %d, features:", vendor, (int)(regs[0] >> 8) & 0xf);
+	for(i=0; i<sizeof featbit / sizeof *featbit; i++) {
+		if(cpu_has(featbit[i])) {
+			printf(" %s", featname[i]);
+		}
+	}
+	putchar('\n');
+}
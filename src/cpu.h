@@ -0,0 +1,50 @@
+/*
+256boss - bootable launcher for 256byte intros
+Copyright (C) 2018-2019  John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY, without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef CPU_H_
+#define CPU_H_
+
+/* feature bits returned in edx by cpuid function 1 */
+#define CPU_FEAT_FPU	0x00000001
+#define CPU_FEAT_TSC	0x00000010
+#define CPU_FEAT_MSR	0x00000020
+#define CPU_FEAT_ACPI	0x00400000	/* thermal monitor and clock modulation */
+#define CPU_FEAT_MMX	0x00800000
+#define CPU_FEAT_FXSR	0x01000000
+#define CPU_FEAT_SSE	0x02000000
+#define CPU_FEAT_SSE2	0x04000000
+
+/* filled by init_cpu, zero if the CPU doesn't support cpuid. The SSE bits
+ * are only set if init_cpu managed to enable SSE instructions.
+ */
+unsigned int cpu_features;
+
+#define cpu_has(feat)	((cpu_features & (feat)) == (feat))
+
+void init_cpu(void);
+
+/* defined in cpu_asm.s */
+int cpuid_supported(void);
+void cpuid(unsigned int func, unsigned int *regs);	/* regs: eax, ebx, ecx, edx */
+void cpu_enable_sse(void);
+/* val[0] and val[1] are the low and high 32 bits of the MSR */
+void rdmsr(unsigned int msr, unsigned int *val);
+void wrmsr(unsigned int msr, const unsigned int *val);
+/* busy loop of count iterations, used as a unit of CPU speed (see speedgov.c) */
+void cpu_spin(unsigned long count);
+
+#endif	/* CPU_H_ */
@@ -0,0 +1,100 @@
+# 256boss - bootable launcher for 256byte intros
+# Copyright (C) 2018-2019  John Tsiombikas <nuclear@member.fsf.org>
+# 
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+# 
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY, without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	# cpuid and cr4 are not available on the i386 we build for by default
+	.arch i586
+
+	.text
+	# the ID flag (bit 21) in EFLAGS can only be toggled if cpuid is supported
+	.global cpuid_supported
+cpuid_supported:
+	pushf
+	pop %eax
+	mov %eax, %ecx
+	xor $0x200000, %eax
+	push %eax
+	popf
+	pushf
+	pop %eax
+	push %ecx
+	popf
+	xor %ecx, %eax
+	shr $21, %eax
+	and $1, %eax
+	ret
+
+	# void cpuid(unsigned int func, unsigned int *regs)
+	.global cpuid
+cpuid:
+	push %ebx
+	push %edi
+	mov 12(%esp), %eax
+	mov 16(%esp), %edi
+	xor %ecx, %ecx
+	cpuid
+	mov %eax, (%edi)
+	mov %ebx, 4(%edi)
+	mov %ecx, 8(%edi)
+	mov %edx, 12(%edi)
+	pop %edi
+	pop %ebx
+	ret
+
+	# clear CR0.EM, set CR0.MP, and set CR4.OSFXSR and CR4.OSXMMEXCPT
+	.global cpu_enable_sse
+cpu_enable_sse:
+	mov %cr0, %eax
+	and $~4, %eax
+	or $2, %eax
+	mov %eax, %cr0
+	mov %cr4, %eax
+	or $0x600, %eax
+	mov %eax, %cr4
+	ret
+
+	# void rdmsr(unsigned int msr, unsigned int *val)
+	.global rdmsr
+rdmsr:
+	push %edi
+	mov 8(%esp), %ecx
+	mov 12(%esp), %edi
+	rdmsr
+	mov %eax, (%edi)
+	mov %edx, 4(%edi)
+	pop %edi
+	ret
+
+	# void wrmsr(unsigned int msr, const unsigned int *val)
+	.global wrmsr
+wrmsr:
+	mov 4(%esp), %ecx
+	mov 8(%esp), %edx
+	mov (%edx), %eax
+	mov 4(%edx), %edx
+	wrmsr
+	ret
+
+	# void cpu_spin(unsigned long count)
+	# same loop as the stall in rm_timer_intr (lowcode.s), keep them in sync
+	.global cpu_spin
+cpu_spin:
+	mov 4(%esp), %ecx
+	test %ecx, %ecx
+	jz 1f
+	.p2align 4
+0:	dec %ecx
+	jnz 0b
+1:	ret
@@ -24,7 +24,18 @@ dos_int21h_entry:
 	jz getvect
 	cmp $0x25, %ah
 	jz setvect
-	iret
+	# file and memory services are handled by the kernel (dosserv.c)
+	cmp $0x3d, %ah
+	jb 0f
+	cmp $0x42, %ah
+	jbe pmcall
+	cmp $0x48, %ah
+	jb 0f
+	cmp $0x4a, %ah
+	jbe pmcall
+0:	iret
+
+pmcall:	jmp dos_pmcall
 
 exit:	ljmp $0,$run_com_return
 
@@ -62,6 +73,12 @@ getvect:
 	mov %ax, %bx
 	iret
 
+	# placeholder installed in the int 21h vector while the kernel serves a
+	# DOS call, in case a stray IRQ1 lands there in the pmode PIC mapping
+	.global dos_nop_intr
+dos_nop_intr:
+	iret
+
 	# print character in al
 	.global dos_int29h_entry
 dos_int29h_entry:
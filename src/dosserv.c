@@ -0,0 +1,431 @@
+/*
+256boss - bootable launcher for 256byte intros
+Copyright (C) 2018-2020  John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY, without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "dosserv.h"
+#include "comloader.h"
+#include "boot.h"
+#include "intr.h"
+#include "timer.h"
+#include "asmops.h"
+
+/* handles 0-4 are the standard devices */
+#define FIRST_HANDLE	5
+/* end of conventional memory, as a segment */
+#define MEM_TOP_SEG		0xa000
+/* real mode timer vector, with the BIOS PIC mapping restored during the run */
+#define TMINTR			8
+
+/* DOS error codes */
+#define ERR_FUNC	1
+#define ERR_NOFILE	2
+#define ERR_NOHANDLES	4
+#define ERR_ACCESS	5
+#define ERR_HANDLE	6
+#define ERR_NOMEM	8
+#define ERR_BLOCK	9
+
+#define AH(r)	(((r)->eax >> 8) & 0xff)
+#define AL(r)	((r)->eax & 0xff)
+#define BX(r)	((r)->ebx & 0xffff)
+#define CX(r)	((r)->ecx & 0xffff)
+#define DX(r)	((r)->edx & 0xffff)
+#define SET16(reg, val)	((reg) = ((reg) & 0xffff0000) | ((val) & 0xffff))
+#define LINADDR(seg, offs)	((void*)(((uint32_t)(seg) << 4) + (offs)))
+
+struct dos_file {
+	unsigned char *data;	/* whole file contents, null for unused slots */
+	long size, pos;
+};
+
+struct mem_block {
+	uint16_t seg, paras;	/* paras is 0 for unused slots */
+};
+
+struct vector {
+	uint16_t offs, seg;
+} __attribute__((packed));
+
+static int dos_open(struct int86regs *regs);
+static int dos_close(struct int86regs *regs);
+static int dos_read(struct int86regs *regs);
+static int dos_seek(struct int86regs *regs);
+static int dos_alloc(struct int86regs *regs);
+static int dos_free(struct int86regs *regs);
+static int dos_resize(struct int86regs *regs);
+static struct dos_file *get_file(int fd);
+static struct mem_block *find_block(uint16_t seg);
+static uint16_t free_space(uint16_t seg);
+
+extern int dos_nop_intr;
+extern volatile uint32_t rm_timer_ticks;
+extern struct vector rm_timer_orig;
+
+static struct dos_file files[DOS_MAX_FILES];
+static struct mem_block blocks[DOS_MAX_BLOCKS];
+
+static unsigned long ncalls[256];
+static unsigned long call_ticks;
+
+
+void dos_begin_run(void)
+{
+	memset(files, 0, sizeof files);
+	memset(ncalls, 0, sizeof ncalls);
+	call_ticks = 0;
+
+	/* like under DOS, the program starts out owning all conventional memory */
+	memset(blocks, 0, sizeof blocks);
+	blocks[0].seg = (uint32_t)com_mem_base >> 4;
+	blocks[0].paras = MEM_TOP_SEG - blocks[0].seg;
+}
+
+void dos_end_run(void)
+{
+	int i, total = 0, nleft = 0;
+
+	for(i=0; i<DOS_MAX_FILES; i++) {
+		if(files[i].data) {
+			free(files[i].data);
+			files[i].data = 0;
+			nleft++;
+		}
+	}
+
+	for(i=0; i<256; i++) {
+		total += ncalls[i];
+	}
+	if(!total) return;
+
+	ser_printf("DOS calls: %d in %lu ms\n", total, TICKS_TO_MSEC(call_ticks));
+	for(i=0; i<256; i++) {
+		if(ncalls[i]) {
+			ser_printf("  %02xh: %lu\n", i, ncalls[i]);
+		}
+	}
+	if(nleft) {
+		ser_printf("  %d files left open\n", nleft);
+	}
+}
+
+void dos_syscall(struct int86regs *regs)
+{
+	int func = AH(regs);
+	int err;
+	unsigned long start = nticks;
+	struct vector *ivt = lowmem_ptr(0);
+	struct vector rmvec = ivt[0x21];
+	struct vector rmtimer = ivt[TMINTR];
+
+	/* the pmode IRQ mapping overlaps our int 21h vector, BIOS calls dropping
+	 * back to real mode with interrupts enabled must not end up in there.
+	 * Timer ticks reflected by the v86 monitor during BIOS calls go straight to
+	 * the BIOS handler, not to rm_timer_intr, which would stall the call for
+	 * the speed governor, or jump out of it when the time limit expires.
+	 */
+	ivt[0x21].seg = 0;
+	ivt[0x21].offs = (uint32_t)&dos_nop_intr;
+	ivt[TMINTR] = rm_timer_orig;
+	enable_intr();
+
+	switch(func) {
+	case 0x3d:
+		err = dos_open(regs);
+		break;
+	case 0x3e:
+		err = dos_close(regs);
+		break;
+	case 0x3f:
+		err = dos_read(regs);
+		break;
+	case 0x42:
+		err = dos_seek(regs);
+		break;
+	case 0x48:
+		err = dos_alloc(regs);
+		break;
+	case 0x49:
+		err = dos_free(regs);
+		break;
+	case 0x4a:
+		err = dos_resize(regs);
+		break;
+	default:
+		err = ERR_FUNC;
+	}
+
+	if(err) {
+		SET16(regs->eax, err);
+		regs->flags |= FLAGS_CARRY;
+	} else {
+		regs->flags &= ~FLAGS_CARRY;
+	}
+
+	disable_intr();
+	ivt[0x21] = rmvec;
+	ivt[TMINTR] = rmtimer;
+
+	ncalls[func]++;
+	call_ticks += nticks - start;
+	/* the real mode timer handler didn't see these ticks, keep the time
+	 * limit of the run in step with the wall clock
+	 */
+	rm_timer_ticks += nticks - start;
+}
+
+/* AL: access mode, DS:DX: file name. Returns the handle in AX */
+static int dos_open(struct int86regs *regs)
+{
+	int i, sz;
+	char path[PATH_MAX], *dptr;
+	const char *name = LINADDR(regs->ds, DX(regs));
+	struct dos_file *fd = 0;
+	void *cached;
+	FILE *fp;
+
+	if(AL(regs) & 3) {
+		return ERR_ACCESS;	/* read-only */
+	}
+
+	for(i=0; i<DOS_MAX_FILES; i++) {
+		if(!files[i].data) {
+			fd = files + i;
+			break;
+		}
+	}
+	if(!fd) return ERR_NOHANDLES;
+
+	/* drop the drive letter and turn backslashes into slashes */
+	if(name[0] && name[1] == ':') {
+		name += 2;
+	}
+	dptr = path;
+	while(*name && dptr < path + sizeof path - 1) {
+		*dptr++ = *name == '\\' ? '/' : *name;
+		name++;
+	}
+	*dptr = 0;
+
+	/* read the whole file in now, so that reads while the program is running
+	 * never wait for the disk
+	 */
+	if((cached = com_cache_lookup(path, &sz))) {
+		if(!(fd->data = malloc(sz ? sz : 1))) {
+			return ERR_NOMEM;
+		}
+		memcpy(fd->data, cached, sz);
+	} else {
+		if(!(fp = fopen(path, "rb"))) {
+			return ERR_NOFILE;
+		}
+		sz = filesize(fp);
+		if(sz < 0 || !(fd->data = malloc(sz ? sz : 1))) {
+			fclose(fp);
+			return ERR_NOMEM;
+		}
+		if(fread(fd->data, 1, sz, fp) != sz) {
+			ser_printf("DOS open: failed to read: %s\n", path);
+			free(fd->data);
+			fd->data = 0;
+			fclose(fp);
+			return ERR_ACCESS;
+		}
+		fclose(fp);
+	}
+	fd->size = sz;
+	fd->pos = 0;
+
+	SET16(regs->eax, fd - files + FIRST_HANDLE);
+	return 0;
+}
+
+/* BX: handle */
+static int dos_close(struct int86regs *regs)
+{
+	struct dos_file *fd;
+
+	if(!(fd = get_file(BX(regs)))) {
+		return ERR_HANDLE;
+	}
+	free(fd->data);
+	fd->data = 0;
+	return 0;
+}
+
+/* BX: handle, CX: count, DS:DX: buffer. Returns the bytes read in AX */
+static int dos_read(struct int86regs *regs)
+{
+	long count = CX(regs);
+	struct dos_file *fd;
+
+	if(BX(regs) == 0) {
+		SET16(regs->eax, 0);	/* no console input, always at EOF */
+		return 0;
+	}
+	if(!(fd = get_file(BX(regs)))) {
+		return ERR_HANDLE;
+	}
+
+	if(fd->pos >= fd->size) {
+		count = 0;
+	} else if(count > fd->size - fd->pos) {
+		count = fd->size - fd->pos;
+	}
+	memcpy(LINADDR(regs->ds, DX(regs)), fd->data + fd->pos, count);
+	fd->pos += count;
+
+	SET16(regs->eax, count);
+	return 0;
+}
+
+/* BX: handle, AL: origin, CX:DX: offset. Returns the new position in DX:AX */
+static int dos_seek(struct int86regs *regs)
+{
+	long offs = (int32_t)((CX(regs) << 16) | DX(regs));
+	struct dos_file *fd;
+
+	if(!(fd = get_file(BX(regs)))) {
+		return ERR_HANDLE;
+	}
+
+	switch(AL(regs)) {
+	case 0:
+		break;
+	case 1:
+		offs += fd->pos;
+		break;
+	case 2:
+		offs += fd->size;
+		break;
+	default:
+		return ERR_FUNC;
+	}
+	if(offs < 0) {
+		return ERR_FUNC;
+	}
+	fd->pos = offs;
+
+	SET16(regs->eax, offs);
+	SET16(regs->edx, offs >> 16);
+	return 0;
+}
+
+/* BX: paragraphs. Returns the segment in AX, or the largest available block
+ * in BX on failure
+ */
+static int dos_alloc(struct int86regs *regs)
+{
+	int i;
+	uint16_t seg, space, largest = 0;
+	struct mem_block *slot = 0;
+
+	for(i=0; i<DOS_MAX_BLOCKS; i++) {
+		if(!blocks[i].paras) {
+			slot = blocks + i;
+			break;
+		}
+	}
+
+	/* first fit, right after the end of one of the allocated blocks */
+	for(i=0; i<DOS_MAX_BLOCKS; i++) {
+		if(!blocks[i].paras) continue;
+		seg = blocks[i].seg + blocks[i].paras;
+		if(seg >= MEM_TOP_SEG || find_block(seg)) continue;
+
+		space = free_space(seg);
+		if(slot && space >= BX(regs)) {
+			slot->seg = seg;
+			slot->paras = BX(regs) ? BX(regs) : 1;
+			SET16(regs->eax, seg);
+			return 0;
+		}
+		if(space > largest) largest = space;
+	}
+
+	SET16(regs->ebx, slot ? largest : 0);
+	return ERR_NOMEM;
+}
+
+/* ES: segment of the block */
+static int dos_free(struct int86regs *regs)
+{
+	struct mem_block *blk;
+
+	if(!(blk = find_block(regs->es))) {
+		return ERR_BLOCK;
+	}
+	blk->paras = 0;
+	return 0;
+}
+
+/* ES: segment of the block, BX: new size in paragraphs. Returns the maximum
+ * size in BX on failure
+ */
+static int dos_resize(struct int86regs *regs)
+{
+	uint16_t space;
+	struct mem_block *blk;
+
+	if(!(blk = find_block(regs->es))) {
+		return ERR_BLOCK;
+	}
+	space = free_space(blk->seg);
+	if(BX(regs) > space) {
+		SET16(regs->ebx, space);
+		return ERR_NOMEM;
+	}
+	blk->paras = BX(regs) ? BX(regs) : 1;
+	return 0;
+}
+
+static struct dos_file *get_file(int fd)
+{
+	fd -= FIRST_HANDLE;
+	if(fd < 0 || fd >= DOS_MAX_FILES || !files[fd].data) {
+		return 0;
+	}
+	return files + fd;
+}
+
+static struct mem_block *find_block(uint16_t seg)
+{
+	int i;
+
+	for(i=0; i<DOS_MAX_BLOCKS; i++) {
+		if(blocks[i].paras && blocks[i].seg == seg) {
+			return blocks + i;
+		}
+	}
+	return 0;
+}
+
+/* paragraphs from seg up to the next allocated block */
+static uint16_t free_space(uint16_t seg)
+{
+	int i;
+	uint16_t end = MEM_TOP_SEG;
+
+	for(i=0; i<DOS_MAX_BLOCKS; i++) {
+		if(blocks[i].paras && blocks[i].seg > seg && blocks[i].seg < end) {
+			end = blocks[i].seg;
+		}
+	}
+	return end - seg;
+}
@@ -0,0 +1,41 @@
+/*
+256boss - bootable launcher for 256byte intros
+Copyright (C) 2018-2020  John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY, without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef DOSSERV_H_
+#define DOSSERV_H_
+
+#include "int86.h"
+
+/* maximum number of files a COM program can have open at once */
+#define DOS_MAX_FILES	8
+/* maximum number of memory blocks, including the one of the program itself */
+#define DOS_MAX_BLOCKS	16
+
+/* called by run_com_binary before and after running a COM program, to set up
+ * the handle and memory block tables, and to close any files left open and
+ * print the DOS call statistics of the run
+ */
+void dos_begin_run(void);
+void dos_end_run(void);
+
+/* serves the DOS int 21h file and memory functions which need the kernel.
+ * Called in protected mode by the dos_pmcall trap (lowcode.s), with the
+ * registers of the caller, which are updated with the results.
+ */
+void dos_syscall(struct int86regs *regs);
+
+#endif	/* DOSSERV_H_ */
@@ -129,6 +129,12 @@ int dtx_get_glyphmap_ptsize(struct dtx_glyphmap *gmap);
 /* The following functions can be used even when the library is compiled without
  * freetype support.
  */
+/* Glyphmaps are loaded either from the textual PGM/PPM format with the glyph
+ * metrics in comments, or from the binary format written by dtx_save_glyphmap:
+ * a header, a glyph table, and the raw (optionally deflated) pixels. Binary
+ * glyphmaps are read in one go and their pixels are used in place, including
+ * the memory passed to dtx_load_glyphmap_mem, which has to outlive them.
+ */
 struct dtx_glyphmap *dtx_load_glyphmap(const char *fname);
 struct dtx_glyphmap *dtx_load_glyphmap_stream(FILE *fp);
 struct dtx_glyphmap *dtx_load_glyphmap_mem(void *ptr, int memsz);
@@ -151,7 +157,8 @@ enum dtx_option {
 
 	/* generic options */
 	DTX_PADDING = 128,    /* padding between glyphs in pixels (default: 8) */
-	DTX_SAVE_PPM,         /* let dtx_save_glyphmap* save PPM instead of PGM (0 or 1) (default: 0 (PGM)) */
+	DTX_SAVE_PPM,         /* save PPM instead of PGM, for the textual format which is no longer written */
+	DTX_SAVE_DEFLATE,     /* deflate the pixels of binary glyphmaps (0 or 1) (default: 0 (raw)) */
 
 	DTX_FORCE_32BIT_ENUM = 0x7fffffff	/* this is not a valid option */
 };
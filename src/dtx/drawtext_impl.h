@@ -36,6 +36,11 @@ struct dtx_glyphmap {
 	int xsz, ysz;
 	unsigned int xsz_shift;
 	unsigned char *pixels;
+	/* binary glyphmaps use their pixels in place: either in the buffer the
+	 * file was read into (pixbuf), or in the caller's memory (pixels_ext)
+	 */
+	void *pixbuf;
+	int pixels_ext;
 	unsigned int tex;
 	int tex_valid;
 	void *udata;
@@ -18,6 +18,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef NO_FREETYPE
 #define USE_FREETYPE
 #endif
+#ifndef NO_ZLIB
+#define USE_ZLIB
+#endif
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -27,10 +30,14 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <ctype.h>
 #include <float.h>
 #include <errno.h>
+#include <inttypes.h>
 #ifdef USE_FREETYPE
 #include <ft2build.h>
 #include FT_FREETYPE_H
 #endif
+#ifdef USE_ZLIB
+#include <zlib.h>
+#endif
 #include "drawtext.h"
 #include "drawtext_impl.h"
 
@@ -44,10 +51,37 @@ struct io {
 #define FTSZ_TO_PIXELS(x)	((x) / 64)
 #define MAX_IMG_SIZE		8192
 
+/* binary glyphmap format, in host byte order, followed by the glyph table
+ * (crange entries) and the pixels (pixsize bytes, raw or deflated).
+ */
+#define GMAP_MAGIC		"DTXG"
+#define GMAP_VERSION	1
+#define GMAP_DEFLATE	1
+
+struct gmap_header {
+	char magic[4];
+	uint32_t version, flags;
+	int32_t ptsize, xsz, ysz;
+	int32_t cstart, cend;
+	float line_advance, baseline;
+	uint32_t pixsize;
+	uint32_t reserved;
+};
+
+struct gmap_glyph {
+	int32_t code;
+	float x, y, width, height;
+	float orig_x, orig_y;
+	float advance;
+};
+
 static int opt_padding = 8;
 static int opt_save_ppm;
+static int opt_save_deflate;
 
 static struct dtx_glyphmap *load_glyphmap(struct io *io);
+static struct dtx_glyphmap *load_glyphmap_bin(unsigned char *buf, int size, int in_place);
+static void replace_pixels(struct dtx_glyphmap *gmap, unsigned char *pixels);
 static int parse_glyphline(const char *str, struct glyph *g);
 
 #ifdef USE_FREETYPE
@@ -432,7 +466,7 @@ struct dtx_glyphmap *dtx_create_glyphmap_range(struct dtx_font *fnt, int sz, int
 void dtx_free_glyphmap(struct dtx_glyphmap *gmap)
 {
 	if(gmap) {
-		free(gmap->pixels);
+		replace_pixels(gmap, 0);
 		free(gmap->glyphs);
 		free(gmap);
 	}
@@ -441,104 +475,88 @@ void dtx_free_glyphmap(struct dtx_glyphmap *gmap)
 #define CHECK_BOUNDS(gm, x, y) ((x) >= 0 && (x) < (gm)->xsz && (y) >= 0 && (y) < (gm)->ysz)
 #define GET_PIXEL(gm, x, y) ((gm)->pixels[((y) << (gm)->xsz_shift) + (x)])
 
-static int calc_distance(struct dtx_glyphmap *gmap, int x, int y, int max_dist)
+#define EDT_INF		INT_MAX
+
+/* 1D squared euclidean distance transform: d[q] = min over p of (q - p)^2 + f[p]
+ * computed as the lower envelope of the parabolas rooted at each sample, see
+ * Felzenszwalb & Huttenlocher, "Distance Transforms of Sampled Functions".
+ * Infinite samples (EDT_INF) are skipped. v and z are scratch arrays of n and
+ * n + 1 elements. f and d must not overlap.
+ */
+static void edt_1d(const int *f, int *d, int n, int *v, double *z)
 {
-	int i, j, startx, starty, endx, endy, px, py;
-	int bwidth, bheight;
-	int min_distsq = INT_MAX;
-	unsigned char cpix = GET_PIXEL(gmap, x, y);
-	int dist;
-
-	if(max_dist > 128) max_dist = 128;
-
-	startx = x >= max_dist ? x - max_dist : 0;
-	starty = y >= max_dist ? y - max_dist : 0;
-	endx = x + max_dist < gmap->xsz ? x + max_dist : gmap->xsz - 1;
-	endy = y + max_dist < gmap->ysz ? y + max_dist : gmap->ysz - 1;
-
-	/* try the cardinal directions first to find the search bounding box */
-	for(i=0; i<4; i++) {
-		int max_dist = x - startx;
-		for(j=0; j<max_dist; j++) {
-			if(GET_PIXEL(gmap, x - j, y) != cpix) {
-				startx = x - j;
-				break;
-			}
-		}
-		max_dist = endx + 1 - x;
-		for(j=0; j<max_dist; j++) {
-			if(GET_PIXEL(gmap, x + j, y) != cpix) {
-				endx = x + j;
-				break;
-			}
-		}
-		max_dist = y - starty;
-		for(j=0; j<max_dist; j++) {
-			if(GET_PIXEL(gmap, x, y - j) != cpix) {
-				starty = y - j;
-				break;
-			}
-		}
-		max_dist = endy + 1 - y;
-		for(j=0; j<max_dist; j++) {
-			if(GET_PIXEL(gmap, x, y + j) != cpix) {
-				endy = y + j;
-				break;
+	int q, k = -1;
+	double s = 0;
+
+	for(q=0; q<n; q++) {
+		if(f[q] == EDT_INF) continue;
+
+		if(k >= 0) {
+			for(;;) {
+				int p = v[k];
+				s = ((double)f[q] + (double)q * q - (double)f[p] - (double)p * p) / (2.0 * (q - p));
+				if(s > z[k]) break;
+				k--;	/* can't go below 0, z[0] is -infinity */
 			}
 		}
+		k++;
+		v[k] = q;
+		z[k] = k ? s : -DBL_MAX;
+		z[k + 1] = DBL_MAX;
 	}
 
-	/* find the minimum squared distance inside the bounding box */
-	bwidth = endx + 1 - startx;
-	bheight = endy + 1 - starty;
-
-	py = starty;
-	for(i=0; i<bheight; i++) {
-		px = startx;
-		for(j=0; j<bwidth; j++) {
-			if(GET_PIXEL(gmap, px, py) != cpix) {
-				int dx = px - x;
-				int dy = py - y;
-				int distsq = dx * dx + dy * dy;
-
-				if(distsq < min_distsq) {
-					min_distsq = distsq;
-				}
-			}
-			++px;
+	if(k < 0) {
+		for(q=0; q<n; q++) {
+			d[q] = EDT_INF;
 		}
-		++py;
+		return;
 	}
 
-	dist = (int)sqrt(min_distsq);
-	if(dist > 127) dist = 127;
-
-	return cpix ? dist + 128 : 127 - dist;
+	k = 0;
+	for(q=0; q<n; q++) {
+		while(z[k + 1] < q) k++;
+		d[q] = (q - v[k]) * (q - v[k]) + f[v[k]];
+	}
 }
 
-struct distcalc_data {
-	struct dtx_glyphmap *gmap;
-	int scanline;
-	unsigned char *pixels;
-};
-
-static void distcalc_func(void *cls)
+/* 2D squared distance transform of img in place, one pass per dimension */
+static void edt_2d(int *img, int xsz, int ysz, unsigned int xsz_shift, int *f, int *d,
+		int *v, double *z)
 {
-	int i;
-	struct distcalc_data *data = cls;
-	struct dtx_glyphmap *gmap = data->gmap;
+	int i, j;
+	int *row;
+
+	for(i=0; i<xsz; i++) {
+		for(j=0; j<ysz; j++) {
+			f[j] = img[(j << xsz_shift) + i];
+		}
+		edt_1d(f, d, ysz, v, z);
+		for(j=0; j<ysz; j++) {
+			img[(j << xsz_shift) + i] = d[j];
+		}
+	}
 
-	printf("scanline %d of %d\n", data->scanline + 1, gmap->ysz);
-	for(i=0; i<gmap->xsz; i++) {
-		*data->pixels++ = calc_distance(gmap, i, data->scanline, 64);
+	for(i=0; i<ysz; i++) {
+		row = img + (i << xsz_shift);
+		memcpy(f, row, xsz * sizeof *f);
+		edt_1d(f, row, xsz, v, z);
 	}
 }
 
+/* Each pixel of the distance field is the distance to the nearest pixel of the
+ * opposite value, clamped to 127, and offset by 128 inside the glyphs or
+ * subtracted from 127 outside. This takes two exact euclidean distance
+ * transforms, to the outside pixels and to the inside pixels, each linear in
+ * the number of pixels.
+ */
 int dtx_calc_glyphmap_distfield(struct dtx_glyphmap *gmap)
 {
-	int i, num_pixels = gmap->xsz * gmap->ysz;
+	int i, pass, dist, fval, num_pixels = gmap->xsz * gmap->ysz;
+	int maxsz = gmap->xsz > gmap->ysz ? gmap->xsz : gmap->ysz;
 	unsigned char *new_pixels;
 	unsigned char *dptr;
+	int *sqdist, *f, *d, *v;
+	double *z;
 
 	/* first quantize the glyphmap to 1bit */
 	dptr = gmap->pixels;
@@ -547,24 +565,41 @@ int dtx_calc_glyphmap_distfield(struct dtx_glyphmap *gmap)
 		*dptr++ = c < 128 ? 0 : 255;
 	}
 
-	if(!(new_pixels = malloc(num_pixels))) {
+	new_pixels = malloc(num_pixels);
+	sqdist = malloc(num_pixels * sizeof *sqdist);
+	f = malloc(maxsz * 3 * sizeof *f);
+	z = malloc((maxsz + 1) * sizeof *z);
+	if(!new_pixels || !sqdist || !f || !z) {
 		printf("%s: failed to allocate %dx%d pixel buffer\n", __func__, gmap->xsz, gmap->ysz);
+		free(new_pixels);
+		free(sqdist);
+		free(f);
+		free(z);
 		return -1;
 	}
-	dptr = new_pixels;
+	d = f + maxsz;
+	v = d + maxsz;
 
-	{
-		for(i=0; i<gmap->ysz; i++) {
-			struct distcalc_data d;
-			d.gmap = gmap;
-			d.scanline = i;
-			d.pixels = new_pixels + (i << gmap->xsz_shift);
-			distcalc_func(&d);
+	for(pass=0; pass<2; pass++) {
+		/* distance to the outside pixels for the inside ones, and vice versa */
+		fval = pass ? 255 : 0;
+		for(i=0; i<num_pixels; i++) {
+			sqdist[i] = gmap->pixels[i] == fval ? 0 : EDT_INF;
+		}
+		edt_2d(sqdist, gmap->xsz, gmap->ysz, gmap->xsz_shift, f, d, v, z);
+
+		for(i=0; i<num_pixels; i++) {
+			if(gmap->pixels[i] == fval) continue;
+
+			dist = sqdist[i] >= 127 * 127 ? 127 : (int)sqrt(sqdist[i]);
+			new_pixels[i] = fval ? 127 - dist : dist + 128;
 		}
 	}
 
-	free(gmap->pixels);
-	gmap->pixels = new_pixels;
+	free(sqdist);
+	free(f);
+	free(z);
+	replace_pixels(gmap, new_pixels);
 	return 0;
 }
 
@@ -676,8 +711,7 @@ int dtx_resize_glyphmap(struct dtx_glyphmap *gmap, int snum, int sdenom, int fil
 		}
 	}
 
-	free(gmap->pixels);
-	gmap->pixels = new_pixels;
+	replace_pixels(gmap, new_pixels);
 	gmap->xsz = nxsz;
 	gmap->ysz = nysz;
 	gmap->xsz_shift = find_pow2(nxsz);
@@ -770,6 +804,41 @@ static void *mem_readline(void *buf, int bsz, struct io *io)
 struct dtx_glyphmap *dtx_load_glyphmap_stream(FILE *fp)
 {
 	struct io io;
+	char magic[4];
+	long start, size;
+	unsigned char *buf;
+	struct dtx_glyphmap *gmap;
+
+	start = ftell(fp);
+	if(fread(magic, 1, 4, fp) == 4 && memcmp(magic, GMAP_MAGIC, 4) == 0) {
+		/* binary glyphmap, read the rest of the file in one go */
+		fseek(fp, 0, SEEK_END);
+		size = ftell(fp) - start;
+		fseek(fp, start, SEEK_SET);
+
+		if(!(buf = malloc(size))) {
+			fperror("failed to allocate glyphmap buffer");
+			return 0;
+		}
+		if(fread(buf, 1, size, fp) != size) {
+			printf("%s: unexpected end of file\n", __func__);
+			free(buf);
+			return 0;
+		}
+		if(!(gmap = load_glyphmap_bin(buf, size, 1))) {
+			free(buf);
+			return 0;
+		}
+		if(gmap->pixels_ext) {
+			gmap->pixbuf = buf;
+			gmap->pixels_ext = 0;
+		} else {
+			free(buf);	/* the pixels were inflated into their own buffer */
+		}
+		return gmap;
+	}
+	fseek(fp, start, SEEK_SET);
+
 	io.data = fp;
 	io.readchar = file_readchar;
 	io.readline = file_readline;
@@ -779,6 +848,11 @@ struct dtx_glyphmap *dtx_load_glyphmap_stream(FILE *fp)
 struct dtx_glyphmap *dtx_load_glyphmap_mem(void *ptr, int memsz)
 {
 	struct io io;
+
+	if(memsz >= 4 && memcmp(ptr, GMAP_MAGIC, 4) == 0) {
+		return load_glyphmap_bin(ptr, memsz, 1);
+	}
+
 	io.data = ptr;
 	io.size = memsz;
 	io.readchar = mem_readchar;
@@ -951,6 +1025,133 @@ err:
 	return 0;
 }
 
+/* with in_place, raw pixels are used directly from buf, and pixels_ext is set
+ * to let the caller decide who owns them
+ */
+static struct dtx_glyphmap *load_glyphmap_bin(unsigned char *buf, int size, int in_place)
+{
+	int i, num_pixels;
+	struct gmap_header hdr;
+	struct gmap_glyph gg;
+	struct glyph *g;
+	struct dtx_glyphmap *gmap;
+	unsigned char *ptr, *pixptr;
+#ifdef USE_ZLIB
+	uLongf zsize;
+#endif
+
+	if(size < sizeof hdr) {
+		printf("%s: invalid glyphmap (truncated header)\n", __func__);
+		return 0;
+	}
+	memcpy(&hdr, buf, sizeof hdr);
+	if(hdr.version != GMAP_VERSION) {
+		printf("%s: unsupported glyphmap version: %lu\n", __func__, (unsigned long)hdr.version);
+		return 0;
+	}
+
+	num_pixels = hdr.xsz * hdr.ysz;
+	if(hdr.xsz <= 0 || hdr.ysz <= 0 || hdr.xsz > MAX_IMG_SIZE || hdr.ysz > MAX_IMG_SIZE ||
+			hdr.cend <= hdr.cstart) {
+		printf("%s: invalid glyphmap header\n", __func__);
+		return 0;
+	}
+	pixptr = buf + sizeof hdr + (hdr.cend - hdr.cstart) * sizeof gg;
+	if(pixptr + hdr.pixsize > buf + size) {
+		printf("%s: invalid glyphmap (truncated)\n", __func__);
+		return 0;
+	}
+
+	if(!(gmap = calloc(1, sizeof *gmap))) {
+		fperror("failed to allocate glyphmap");
+		return 0;
+	}
+	gmap->ptsize = hdr.ptsize;
+	gmap->xsz = hdr.xsz;
+	gmap->ysz = hdr.ysz;
+	gmap->xsz_shift = find_pow2(gmap->xsz);
+	gmap->cstart = hdr.cstart;
+	gmap->cend = hdr.cend;
+	gmap->crange = hdr.cend - hdr.cstart;
+	gmap->line_advance = hdr.line_advance;
+	gmap->baseline = hdr.baseline;
+
+	if(!(gmap->glyphs = calloc(gmap->crange, sizeof *gmap->glyphs))) {
+		fperror("failed to allocate glyph info");
+		goto err;
+	}
+	ptr = buf + sizeof hdr;
+	g = gmap->glyphs;
+	for(i=0; i<gmap->crange; i++) {
+		memcpy(&gg, ptr, sizeof gg);
+		ptr += sizeof gg;
+
+		g->code = gg.code;
+		g->x = gg.x;
+		g->y = gg.y;
+		g->width = gg.width;
+		g->height = gg.height;
+		g->orig_x = gg.orig_x;
+		g->orig_y = gg.orig_y;
+		g->advance = gg.advance;
+		g->nx = g->x / gmap->xsz;
+		g->ny = g->y / gmap->ysz;
+		g->nwidth = g->width / gmap->xsz;
+		g->nheight = g->height / gmap->ysz;
+		g++;
+	}
+
+	if(hdr.flags & GMAP_DEFLATE) {
+#ifdef USE_ZLIB
+		if(!(gmap->pixels = malloc(num_pixels))) {
+			fperror("failed to allocate pixels");
+			goto err;
+		}
+		zsize = num_pixels;
+		if(uncompress(gmap->pixels, &zsize, pixptr, hdr.pixsize) != Z_OK || zsize != num_pixels) {
+			printf("%s: failed to inflate glyphmap pixels\n", __func__);
+			goto err;
+		}
+#else
+		printf("%s: deflated glyphmap, but compiled without zlib support!\n", __func__);
+		goto err;
+#endif
+	} else {
+		if(hdr.pixsize != num_pixels) {
+			printf("%s: invalid glyphmap (pixel data size)\n", __func__);
+			goto err;
+		}
+		if(in_place) {
+			gmap->pixels = pixptr;
+			gmap->pixels_ext = 1;
+		} else {
+			if(!(gmap->pixels = malloc(num_pixels))) {
+				fperror("failed to allocate pixels");
+				goto err;
+			}
+			memcpy(gmap->pixels, pixptr, num_pixels);
+		}
+	}
+	return gmap;
+
+err:
+	dtx_free_glyphmap(gmap);
+	return 0;
+}
+
+/* frees the current pixels, unless they belong to someone else */
+static void replace_pixels(struct dtx_glyphmap *gmap, unsigned char *pixels)
+{
+	if(gmap->pixbuf) {
+		free(gmap->pixbuf);
+		gmap->pixbuf = 0;
+	} else if(!gmap->pixels_ext) {
+		free(gmap->pixels);
+	}
+	gmap->pixels_ext = 0;
+	gmap->pixels = pixels;
+}
+
 int dtx_save_glyphmap(const char *fname, const struct dtx_glyphmap *gmap)
 {
 	FILE *fp;
@@ -967,31 +1168,74 @@ int dtx_save_glyphmap(const char *fname, const struct dtx_glyphmap *gmap)
 
 int dtx_save_glyphmap_stream(FILE *fp, const struct dtx_glyphmap *gmap)
 {
-	/*
-	int i, num_pixels;
+	int i, num_pixels = gmap->xsz * gmap->ysz;
+	struct gmap_header hdr;
+	struct gmap_glyph gg;
 	struct glyph *g = gmap->glyphs;
+	unsigned char *pixels = gmap->pixels;
+	unsigned char *zbuf = 0;
+#ifdef USE_ZLIB
+	uLongf zsize;
+#endif
 
-	fprintf(fp, "P%d\n%d %d\n", opt_save_ppm ? 6 : 5, gmap->xsz, gmap->ysz);
-	fprintf(fp, "# size: %d\n", gmap->ptsize);
-	fprintf(fp, "# advance: %g\n", gmap->line_advance);
-	for(i=0; i<gmap->crange; i++) {
-		fprintf(fp, "# %d: %gx%g+%g+%g o:%g,%g adv:%g\n", g->code + gmap->cstart,
-				g->width, g->height, g->x, g->y, g->orig_x, g->orig_y, g->advance);
-		g++;
+	memset(&hdr, 0, sizeof hdr);
+	memcpy(hdr.magic, GMAP_MAGIC, 4);
+	hdr.version = GMAP_VERSION;
+	hdr.ptsize = gmap->ptsize;
+	hdr.xsz = gmap->xsz;
+	hdr.ysz = gmap->ysz;
+	hdr.cstart = gmap->cstart;
+	hdr.cend = gmap->cend;
+	hdr.line_advance = gmap->line_advance;
+	hdr.baseline = gmap->baseline;
+	hdr.pixsize = num_pixels;
+
+	if(opt_save_deflate) {
+#ifdef USE_ZLIB
+		zsize = compressBound(num_pixels);
+		if(!(zbuf = malloc(zsize))) {
+			fperror("failed to allocate compression buffer");
+			return -1;
+		}
+		if(compress2(zbuf, &zsize, gmap->pixels, num_pixels, Z_BEST_COMPRESSION) != Z_OK) {
+			printf("%s: failed to deflate glyphmap pixels\n", __func__);
+			free(zbuf);
+			return -1;
+		}
+		hdr.flags |= GMAP_DEFLATE;
+		hdr.pixsize = zsize;
+		pixels = zbuf;
+#else
+		printf("%s: ignoring DTX_SAVE_DEFLATE: not compiled with zlib support!\n", __func__);
+#endif
 	}
-	fprintf(fp, "255\n");
 
-	num_pixels = gmap->xsz * gmap->ysz;
-	for(i=0; i<num_pixels; i++) {
-		int c = gmap->pixels[i];
-		fputc(c, fp);
-		if(opt_save_ppm) {
-			fputc(c, fp);
-			fputc(c, fp);
+	if(fwrite(&hdr, sizeof hdr, 1, fp) != 1) {
+		goto err;
+	}
+	for(i=0; i<gmap->crange; i++) {
+		gg.code = g->code;
+		gg.x = g->x;
+		gg.y = g->y;
+		gg.width = g->width;
+		gg.height = g->height;
+		gg.orig_x = g->orig_x;
+		gg.orig_y = g->orig_y;
+		gg.advance = g->advance;
+		if(fwrite(&gg, sizeof gg, 1, fp) != 1) {
+			goto err;
 		}
+		g++;
+	}
+	if(fwrite(pixels, 1, hdr.pixsize, fp) != hdr.pixsize) {
+		goto err;
 	}
+	free(zbuf);
 	return 0;
-	*/
+
+err:
+	printf("%s: failed to write glyphmap\n", __func__);
+	free(zbuf);
 	return -1;
 }
 
@@ -1013,6 +1257,10 @@ void dtx_set(enum dtx_option opt, int val)
 		opt_save_ppm = val;
 		break;
 
+	case DTX_SAVE_DEFLATE:
+		opt_save_deflate = val;
+		break;
+
 	default:
 		dtx_gl_setopt(opt, val);
 		dtx_rast_setopt(opt, val);
@@ -1030,6 +1278,9 @@ int dtx_get(enum dtx_option opt)
 	case DTX_SAVE_PPM:
 		return opt_save_ppm;
 
+	case DTX_SAVE_DEFLATE:
+		return opt_save_deflate;
+
 	default:
 		break;
 	}
@@ -0,0 +1,510 @@
+/*
+256boss - bootable launcher for 256byte intros
+Copyright (C) 2018-2020  John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY, without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "fbcon.h"
+#include "video.h"
+#include "int86.h"
+
+#define REALPTR(s, o)	(void*)(((uint32_t)(s) << 4) + (uint32_t)(o))
+
+#define FONT_W		8
+#define FONT_H		16
+
+#define MAX_COLS	256
+#define GCACHE_SLOTS	8
+
+#define CELL(c, attr) \
+	(((uint16_t)(c) & 0xff) | ((uint16_t)(attr) << 8))
+
+/* pre-rendered glyphs for one color pair */
+struct glyph_cache {
+	int attr;				/* -1 if the slot is free */
+	unsigned long used;		/* for least recently used replacement */
+	uint32_t valid[256 / 32];
+	unsigned char *pixels;	/* 256 glyphs of FONT_H scanlines */
+};
+
+static struct glyph_cache *lookup_cache(int attr);
+static void render_glyph(struct glyph_cache *gc, int c);
+static void mark(int x, int y, int len);
+static void linefeed(void);
+static void scroll(void);
+static void draw_span(int row, int x0, int x1);
+static void draw_cursor(void);
+static void erase_cursor(void);
+
+static const unsigned char cga_rgb[16][3] = {
+	{0, 0, 0}, {0, 0, 0xaa}, {0, 0xaa, 0}, {0, 0xaa, 0xaa},
+	{0xaa, 0, 0}, {0xaa, 0, 0xaa}, {0xaa, 0x55, 0}, {0xaa, 0xaa, 0xaa},
+	{0x55, 0x55, 0x55}, {0x55, 0x55, 0xff}, {0x55, 0xff, 0x55}, {0x55, 0xff, 0xff},
+	{0xff, 0x55, 0x55}, {0xff, 0x55, 0xff}, {0xff, 0xff, 0x55}, {0xff, 0xff, 0xff}
+};
+
+static unsigned char font[256 * FONT_H];
+static struct video_mode vm;
+static unsigned char *fb;
+static int bytespp, glyph_pitch, glyph_size;
+static uint32_t colors[16];
+
+static int cols, rows;
+static int vrows;				/* text rows which fit in video memory */
+static int start_row, shown_row;	/* virtual framebuffer row at the top */
+static int can_pan;
+
+static uint16_t *tbuf;			/* what's on screen, cols x rows cells */
+static short *dirty_start, *dirty_end;	/* per row range of changed cells */
+
+static int cx, cy;
+static int cur_show = 1, cur_drawn, cur_drawn_x, cur_drawn_y;
+static unsigned char cur_attr = 0x07;
+
+static struct glyph_cache gcache[GCACHE_SLOTS];
+static struct glyph_cache *gc_last;
+static unsigned long gc_clock;
+
+
+int fbcon_parse_mode(const char *str, int *xsz, int *ysz, int *bpp)
+{
+	char *endp;
+
+	*ysz = *bpp = 0;
+	*xsz = strtol(str, &endp, 10);
+	if(*endp == 'x') *ysz = strtol(endp + 1, &endp, 10);
+	if(*endp == 'x') *bpp = strtol(endp + 1, &endp, 10);
+	if(*endp || *xsz <= 0 || *ysz <= 0 || *bpp < 0) {
+		return -1;
+	}
+	return 0;
+}
+
+int fbcon_init(int xsz, int ysz, int bpp)
+{
+	int i, idx, r, g, b;
+	struct int86regs regs;
+	unsigned char pal[16 * 3];
+
+	fbcon_shutdown();
+
+	/* grab the 8x16 font from the video BIOS, while still in text mode */
+	memset(&regs, 0, sizeof regs);
+	regs.eax = 0x1130;
+	regs.ebx = 0x0600;
+	int86(0x10, &regs);
+	if((regs.ecx & 0xffff) != FONT_H) {
+		printf("fbcon: failed to get the 8x16 BIOS font\n");
+		return -1;
+	}
+	memcpy(font, REALPTR(regs.es, regs.ebp & 0xffff), sizeof font);
+
+	if((idx = find_video_mode_idx(xsz, ysz, bpp)) == -1) {
+		printf("fbcon: no suitable video mode for %dx%d\n", xsz, ysz);
+		return -1;
+	}
+	video_mode_info(idx, &vm);
+	if(vm.bpp < 8) {
+		printf("fbcon: %dbpp modes not supported\n", vm.bpp);
+		return -1;
+	}
+
+	bytespp = (vm.bpp + 7) >> 3;
+	glyph_pitch = FONT_W * bytespp;
+	glyph_size = glyph_pitch * FONT_H;
+	cols = vm.width / FONT_W;
+	if(cols > MAX_COLS) cols = MAX_COLS;
+	rows = vm.height / FONT_H;
+
+	if(!(tbuf = malloc(cols * rows * sizeof *tbuf)) ||
+			!(dirty_start = malloc(rows * 2 * sizeof *dirty_start))) {
+		goto err_nomem;
+	}
+	dirty_end = dirty_start + rows;
+	for(i=0; i<GCACHE_SLOTS; i++) {
+		gcache[i].attr = -1;
+		gcache[i].used = 0;
+		if(!(gcache[i].pixels = malloc(256 * glyph_size))) {
+			goto err_nomem;
+		}
+	}
+	gc_last = 0;
+	gc_clock = 0;
+
+	if(!(fb = set_video_mode(vm.mode))) {
+		printf("fbcon: failed to set video mode %xh\n", vm.mode);
+		goto err;
+	}
+
+	/* scroll by panning down the rest of video memory, if the BIOS lets us */
+	vrows = (unsigned long)get_video_mem_size() * 1024 / vm.pitch / FONT_H;
+	can_pan = vrows > rows && video_pan((vrows - rows) * FONT_H) == 0 && video_pan(0) == 0;
+	if(!can_pan) vrows = rows;
+	shown_row = 0;
+
+	for(i=0; i<16; i++) {
+		r = cga_rgb[i][0];
+		g = cga_rgb[i][1];
+		b = cga_rgb[i][2];
+		if(vm.bpp == 8) {
+			colors[i] = i;
+		} else {
+			colors[i] = ((uint32_t)(r >> (8 - vm.rbits)) << vm.rshift) |
+				((uint32_t)(g >> (8 - vm.gbits)) << vm.gshift) |
+				((uint32_t)(b >> (8 - vm.bbits)) << vm.bshift);
+		}
+		pal[i * 3] = r;
+		pal[i * 3 + 1] = g;
+		pal[i * 3 + 2] = b;
+	}
+	if(vm.bpp == 8) {
+		set_palette(0, 16, pal, 0);
+	}
+
+	fbcon_on = 1;
+	cur_drawn = 0;
+	fbcon_clear(cur_attr);
+	return 0;
+
+err_nomem:
+	printf("fbcon: failed to allocate console buffers\n");
+err:
+	fbcon_on = 1;	/* to free everything */
+	fbcon_shutdown();
+	return -1;
+}
+
+void fbcon_shutdown(void)
+{
+	int i;
+
+	if(!fbcon_on) return;
+	fbcon_on = 0;
+
+	for(i=0; i<GCACHE_SLOTS; i++) {
+		free(gcache[i].pixels);
+		gcache[i].pixels = 0;
+	}
+	free(tbuf);
+	free(dirty_start);
+	tbuf = 0;
+	dirty_start = dirty_end = 0;
+}
+
+void fbcon_size(int *cols_ret, int *rows_ret)
+{
+	*cols_ret = cols;
+	*rows_ret = rows;
+}
+
+void fbcon_write(const char *buf, int sz, unsigned char attr)
+{
+	int c;
+
+	erase_cursor();
+	cur_attr = attr;
+
+	while(sz-- > 0) {
+		c = (unsigned char)*buf++;
+		switch(c) {
+		case '\n':
+			linefeed();
+		case '\r':
+			cx = 0;
+			break;
+
+		case '\t':
+			cx = (cx & ~7) + 8;
+			if(cx >= cols) {
+				linefeed();
+				cx = 0;
+			}
+			break;
+
+		case '\b':
+			if(cx > 0) cx--;
+			tbuf[cy * cols + cx] = CELL(' ', attr);
+			mark(cx, cy, 1);
+			break;
+
+		default:
+			tbuf[cy * cols + cx] = CELL(c, attr);
+			mark(cx, cy, 1);
+			if(++cx >= cols) {
+				linefeed();
+				cx = 0;
+			}
+		}
+	}
+}
+
+void fbcon_putchar_scr(int x, int y, int c, unsigned char attr)
+{
+	if(x < 0 || x >= cols || y < 0 || y >= rows) {
+		return;
+	}
+	tbuf[y * cols + x] = CELL(c, attr);
+	mark(x, y, 1);
+}
+
+/* draws everything changed since the last flush, then pans and draws the
+ * cursor.
+ */
+void fbcon_flush(void)
+{
+	int i;
+
+	if(!fbcon_on) return;
+
+	for(i=0; i<rows; i++) {
+		if(dirty_start[i] < dirty_end[i]) {
+			draw_span(i, dirty_start[i], dirty_end[i]);
+			dirty_start[i] = cols;
+			dirty_end[i] = 0;
+		}
+	}
+
+	if(start_row != shown_row) {
+		video_pan(start_row * FONT_H);
+		shown_row = start_row;
+	}
+
+	if(cur_show) {
+		draw_cursor();
+	}
+}
+
+void fbcon_clear(unsigned char attr)
+{
+	erase_cursor();
+	cur_attr = attr;
+	memset16(tbuf, CELL(' ', attr), cols * rows);
+	start_row = 0;
+	cx = cy = 0;
+	mark(0, -1, 0);
+	fbcon_flush();
+}
+
+void fbcon_cursor(int x, int y)
+{
+	erase_cursor();
+	cx = x < 0 ? 0 : (x >= cols ? cols - 1 : x);
+	cy = y < 0 ? 0 : (y >= rows ? rows - 1 : y);
+	fbcon_flush();
+}
+
+void fbcon_show_cursor(int show)
+{
+	erase_cursor();
+	cur_show = show;
+	fbcon_flush();
+}
+
+static struct glyph_cache *lookup_cache(int attr)
+{
+	int i;
+	struct glyph_cache *gc;
+
+	if(gc_last && gc_last->attr == attr) {
+		return gc_last;
+	}
+
+	gc = gcache;
+	for(i=0; i<GCACHE_SLOTS; i++) {
+		if(gcache[i].attr == attr) {
+			gc = gcache + i;
+			goto done;
+		}
+		if(gcache[i].used < gc->used) {
+			gc = gcache + i;
+		}
+	}
+
+	/* not cached, replace the least recently used */
+	gc->attr = attr;
+	memset(gc->valid, 0, sizeof gc->valid);
+done:
+	gc->used = ++gc_clock;
+	gc_last = gc;
+	return gc;
+}
+
+static void render_glyph(struct glyph_cache *gc, int c)
+{
+	int i, j;
+	unsigned char bits, *fptr, *dptr;
+	uint32_t col, fg = colors[gc->attr & 0xf], bg = colors[(gc->attr >> 4) & 0xf];
+
+	fptr = font + c * FONT_H;
+	dptr = gc->pixels + c * glyph_size;
+
+	for(i=0; i<FONT_H; i++) {
+		bits = *fptr++;
+		for(j=0; j<FONT_W; j++) {
+			col = bits & 0x80 ? fg : bg;
+			bits <<= 1;
+
+			switch(bytespp) {
+			case 1:
+				*dptr++ = col;
+				break;
+			case 2:
+				*(uint16_t*)dptr = col;
+				dptr += 2;
+				break;
+			case 3:
+				dptr[0] = col;
+				dptr[1] = col >> 8;
+				dptr[2] = col >> 16;
+				dptr += 3;
+				break;
+			default:
+				*(uint32_t*)dptr = col;
+				dptr += 4;
+			}
+		}
+	}
+	gc->valid[c >> 5] |= 1 << (c & 0x1f);
+}
+
+/* marks len cells of row y as changed, y < 0 marks everything */
+static void mark(int x, int y, int len)
+{
+	int i;
+
+	if(y < 0) {
+		for(i=0; i<rows; i++) {
+			dirty_start[i] = 0;
+			dirty_end[i] = cols;
+		}
+		return;
+	}
+	if(x < dirty_start[y]) dirty_start[y] = x;
+	if(x + len > dirty_end[y]) dirty_end[y] = x + len;
+}
+
+static void linefeed(void)
+{
+	if(++cy >= rows) {
+		scroll();
+		cy = rows - 1;
+	}
+}
+
+static void scroll(void)
+{
+	memmove(tbuf, tbuf + cols, (rows - 1) * cols * sizeof *tbuf);
+	memset16(tbuf + (rows - 1) * cols, CELL(' ', cur_attr), cols);
+
+	if(can_pan && start_row + rows < vrows) {
+		/* the rest is already in video memory, one row further up */
+		start_row++;
+		memmove(dirty_start, dirty_start + 1, (rows - 1) * sizeof *dirty_start);
+		memmove(dirty_end, dirty_end + 1, (rows - 1) * sizeof *dirty_end);
+		dirty_start[rows - 1] = 0;
+		dirty_end[rows - 1] = cols;
+	} else {
+		/* no panning, or reached the end of video memory: redraw it all from
+		 * the text buffer, at the top.
+		 */
+		start_row = 0;
+		mark(0, -1, 0);
+	}
+}
+
+/* Draws cells [x0, x1) of a row, a scanline at a time across all of them, so
+ * that video memory is written sequentially.
+ */
+static void draw_span(int row, int x0, int x1)
+{
+	int i, j, k, n, nwords, c, attr;
+	unsigned char *gptr[MAX_COLS];
+	unsigned char *dest;
+	uint32_t *sptr, *dptr;
+	uint16_t *cell = tbuf + row * cols + x0;
+	struct glyph_cache *gc;
+
+	n = x1 - x0;
+	for(i=0; i<n; i++) {
+		c = cell[i] & 0xff;
+		attr = cell[i] >> 8;
+		gc = lookup_cache(attr);
+		if(!(gc->valid[c >> 5] & (1 << (c & 0x1f)))) {
+			render_glyph(gc, c);
+		}
+		gptr[i] = gc->pixels + c * glyph_size;
+	}
+
+	nwords = glyph_pitch >> 2;
+	dest = fb + (start_row + row) * FONT_H * vm.pitch + x0 * glyph_pitch;
+	for(i=0; i<FONT_H; i++) {
+		dptr = (uint32_t*)dest;
+		for(j=0; j<n; j++) {
+			sptr = (uint32_t*)(gptr[j] + i * glyph_pitch);
+			for(k=0; k<nwords; k++) {
+				*dptr++ = *sptr++;
+			}
+		}
+		dest += vm.pitch;
+	}
+}
+
+/* underline cursor in the foreground color of the cell under it */
+static void draw_cursor(void)
+{
+	int i, j, attr;
+	unsigned char *dest;
+	uint32_t col;
+
+	attr = tbuf[cy * cols + cx] >> 8;
+	col = colors[attr & 0xf];
+
+	dest = fb + ((start_row + cy) * FONT_H + FONT_H - 2) * vm.pitch + cx * glyph_pitch;
+	for(i=0; i<2; i++) {
+		for(j=0; j<FONT_W; j++) {
+			switch(bytespp) {
+			case 1:
+				dest[j] = col;
+				break;
+			case 2:
+				((uint16_t*)dest)[j] = col;
+				break;
+			case 3:
+				dest[j * 3] = col;
+				dest[j * 3 + 1] = col >> 8;
+				dest[j * 3 + 2] = col >> 16;
+				break;
+			default:
+				((uint32_t*)dest)[j] = col;
+			}
+		}
+		dest += vm.pitch;
+	}
+
+	cur_drawn = 1;
+	cur_drawn_x = cx;
+	cur_drawn_y = cy;
+}
+
+static void erase_cursor(void)
+{
+	if(cur_drawn) {
+		mark(cur_drawn_x, cur_drawn_y, 1);
+		cur_drawn = 0;
+	}
+}
@@ -0,0 +1,52 @@
+/*
+256boss - bootable launcher for 256byte intros
+Copyright (C) 2018-2020  John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY, without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef FBCON_H_
+#define FBCON_H_
+
+/* Graphics mode console on the VBE linear framebuffer, using the 8x16 VGA
+ * BIOS font. Characters are rendered from a cache of pre-drawn glyphs per
+ * color pair, and scrolling pans the display down a virtual framebuffer
+ * which extends into the rest of video memory, or redraws the screen from a
+ * shadow text buffer if panning isn't available.
+ *
+ * contty.c forwards everything here while it's active. Output is batched:
+ * fbcon_write only updates the text buffer, and fbcon_flush draws the
+ * changed characters, pans, and moves the cursor.
+ */
+
+int fbcon_on;
+
+/* sets the closest video mode to xsz x ysz (bpp 0: any), -1 on failure */
+int fbcon_init(int xsz, int ysz, int bpp);
+/* parses a WxH[xBPP] mode string for fbcon_init, bpp is 0 if missing */
+int fbcon_parse_mode(const char *str, int *xsz, int *ysz, int *bpp);
+/* called by video.c before any mode change */
+void fbcon_shutdown(void);
+
+void fbcon_size(int *cols, int *rows);
+
+void fbcon_write(const char *buf, int sz, unsigned char attr);
+void fbcon_putchar_scr(int x, int y, int c, unsigned char attr);
+void fbcon_flush(void);
+
+void fbcon_clear(unsigned char attr);
+void fbcon_cursor(int x, int y);
+void fbcon_get_cursor(int *x, int *y);
+void fbcon_show_cursor(int show);
+
+#endif	/* FBCON_H_ */
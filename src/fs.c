@@ -23,6 +23,8 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "fs.h"
 #include "mtab.h"
 #include "panic.h"
+#include "timer.h"
+#include "comloader.h"
 
 struct filesys *fsfat_create(int dev, uint64_t start, uint64_t size);
 struct filesys *fsmem_create(int dev, uint64_t start, uint64_t size);
@@ -44,6 +46,8 @@ struct filesys *fs_mount(int dev, uint64_t start, uint64_t size, struct fs_node
 
 	for(i=0; i<NUM_FSTYPES; i++) {
 		if((fs = createfs[i](dev, start, size))) {
+			/* cached COM programs may come from whatever was mounted before */
+			com_cache_flush();
 			if(!parent) {
 				rootfs = fs;
 
@@ -60,6 +64,25 @@ struct filesys *fs_mount(int dev, uint64_t start, uint64_t size, struct fs_node
 	return 0;
 }
 
+int fs_mount_deferred(struct filesys *fs)
+{
+	unsigned long start;
+
+	if(!fs->deferred) {
+		return 0;
+	}
+
+	start = nticks;
+	if(fs->fsop->mount(fs) == -1) {
+		printf("deferred mount of %s failed\n", fs->name ? fs->name : "filesystem");
+		return -1;
+	}
+	printf("deferred mount of %s: read %d sectors in %ld ms\n", fs->name ? fs->name : "filesystem",
+			fs->deferred, TICKS_TO_MSEC(nticks - start));
+	fs->deferred = 0;
+	return 0;
+}
+
 static char cwdpath[1024];
 static char *cwdpath_end = cwdpath;
 
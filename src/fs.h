@@ -52,6 +52,10 @@ struct fs_dirent;
 
 struct fs_operations {
 	void (*destroy)(struct filesys *fs);
+	/* completes a deferred mount (see fs_mount_deferred), null if the
+	 * filesystem never defers anything
+	 */
+	int (*mount)(struct filesys *fs);
 
 	struct fs_node *(*open)(struct filesys *fs, const char *path, unsigned int flags);
 	void (*close)(struct fs_node *node);
@@ -74,6 +78,12 @@ struct filesys {
 	char *name;
 	struct fs_operations *fsop;
 	void *data;
+
+	/* create only probes the filesystem, leaving the expensive part of the
+	 * mount (reading the FAT, root directory, etc) for the first access.
+	 * This is the number of sectors left to read, or 0 when fully mounted.
+	 */
+	int deferred;
 };
 
 struct fs_node {
@@ -95,6 +105,8 @@ struct filesys *rootfs;
 struct fs_node *cwdnode;	/* current working directory node */
 
 struct filesys *fs_mount(int dev, uint64_t start, uint64_t size, struct fs_node *parent);
+/* called when first crossing a mount point, to complete a deferred mount */
+int fs_mount_deferred(struct filesys *fs);
 
 int fs_chdir(const char *path);
 char *fs_getcwd(void);
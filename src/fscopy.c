@@ -0,0 +1,293 @@
+/*
+256boss - bootable launcher for 256byte intros
+Copyright (C) 2018-2020  John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY, without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <dirent.h>
+#include "fscopy.h"
+#include "fs.h"
+#include "timer.h"
+#include "util.h"
+#include "comloader.h"
+
+struct filesys *fsmem_create(int dev, uint64_t start, uint64_t size);
+
+struct copy_stats {
+	unsigned long total_bytes, copied_bytes;
+	int nfiles, ndirs;
+	int percent;
+
+	/* first COM file found, to compare launch latencies before and after */
+	char sample[PATH_MAX];
+	long sample_size;
+	unsigned long sample_msec;
+};
+
+static int count_tree(char *path, int len, struct copy_stats *st);
+static int copy_tree(struct filesys *ramfs, char *path, int len, int mntlen, struct copy_stats *st);
+static int copy_file(struct filesys *ramfs, const char *src, const char *dst, struct copy_stats *st);
+static unsigned long list_dir_msec(const char *path);
+static unsigned long read_file_msec(const char *path);
+
+
+int fs_copy_to_ram(const char *mntpath)
+{
+	int len;
+	unsigned long start, msec, dir_msec;
+	char *name, path[PATH_MAX];
+	struct fs_node *node;
+	struct filesys *fs, *ramfs, *old;
+	struct copy_stats st;
+
+	if(!(node = fs_open(mntpath, 0))) {
+		printf("copy to RAM: failed to open %s\n", mntpath);
+		return -1;
+	}
+	fs = node->fs;
+	fs_close(node);
+
+	if(fs->type == FSTYPE_MEM) {
+		return 0;
+	}
+	if((len = strlen(mntpath)) >= sizeof path) {
+		return -1;
+	}
+	memcpy(path, mntpath, len + 1);
+	if(len > 1 && path[len - 1] == '/') {
+		path[--len] = 0;
+	}
+
+	memset(&st, 0, sizeof st);
+	st.percent = -1;
+	dir_msec = list_dir_msec(path);
+
+	start = nticks;
+	if(count_tree(path, len, &st) == -1) {
+		return -1;
+	}
+	printf("copy to RAM: %s: %d files in %d directories, %lu kb\n", path, st.nfiles,
+			st.ndirs, st.total_bytes >> 10);
+
+	st.nfiles = st.ndirs = 0;
+	ramfs = fsmem_create(DEV_MEMDISK, 0, 0);
+	if(copy_tree(ramfs, path, len, len, &st) == -1) {
+		printf("\ncopy to RAM: failed, keeping %s on disk\n", path);
+		ramfs->fsop->destroy(ramfs);
+		return -1;
+	}
+	msec = TICKS_TO_MSEC(nticks - start);
+	printf("\ncopy to RAM: copied %lu kb in %lu ms (%lu kb/s)\n", st.copied_bytes >> 10, msec,
+			msec ? (st.copied_bytes >> 10) * 1000 / msec : 0);
+
+	/* swap the filesystem structures, so that the mount point, the mount table,
+	 * and everything else pointing to fs now refers to the RAM copy
+	 */
+	if(!(old = malloc(sizeof *old)) || !(name = malloc(strlen(fs->name ? fs->name : "") + 1))) {
+		free(old);
+		ramfs->fsop->destroy(ramfs);
+		return -1;
+	}
+	strcpy(name, fs->name ? fs->name : "");
+	*old = *fs;
+	*fs = *ramfs;
+	fs->name = name;
+	free(ramfs);
+	old->fsop->destroy(old);
+	com_cache_flush();
+
+	printf("copy to RAM: listing %s: %lu ms before, %lu ms after\n", path, dir_msec,
+			list_dir_msec(path));
+	if(*st.sample) {
+		printf("copy to RAM: reading %s (%ld bytes): %lu ms before, %lu ms after\n",
+				st.sample, st.sample_size, st.sample_msec, read_file_msec(st.sample));
+	}
+	return 0;
+}
+
+static int skip_entry(const char *name)
+{
+	return strcmp(name, ".") == 0 || strcmp(name, "..") == 0;
+}
+
+static int count_tree(char *path, int len, struct copy_stats *st)
+{
+	DIR *dir;
+	struct dirent *dent;
+	int nlen;
+
+	if(!(dir = opendir(path))) {
+		printf("copy to RAM: failed to open directory: %s\n", path);
+		return -1;
+	}
+	st->ndirs++;
+
+	while((dent = readdir(dir))) {
+		if(skip_entry(dent->d_name)) continue;
+
+		if(dent->d_type == DT_DIR) {
+			if((nlen = len + strlen(dent->d_name) + 1) >= PATH_MAX) {
+				continue;
+			}
+			sprintf(path + len, "/%s", dent->d_name);
+			count_tree(path, nlen, st);
+			path[len] = 0;
+		} else {
+			st->total_bytes += dent->d_fsize;
+			st->nfiles++;
+		}
+	}
+	closedir(dir);
+	return 0;
+}
+
+static int copy_tree(struct filesys *ramfs, char *path, int len, int mntlen, struct copy_stats *st)
+{
+	DIR *dir;
+	struct dirent *dent;
+	struct fs_node *node;
+	int nlen, res = 0;
+
+	if(!(dir = opendir(path))) {
+		return -1;
+	}
+
+	while((dent = readdir(dir))) {
+		if(skip_entry(dent->d_name)) continue;
+
+		if((nlen = len + strlen(dent->d_name) + 1) >= PATH_MAX) {
+			printf("\ncopy to RAM: skipping, path too long: %s/%s\n", path, dent->d_name);
+			continue;
+		}
+		sprintf(path + len, "/%s", dent->d_name);
+
+		if(dent->d_type == DT_DIR) {
+			if(!(node = ramfs->fsop->open(ramfs, path + mntlen, FSO_CREATE | FSO_DIR))) {
+				res = -1;
+				break;
+			}
+			ramfs->fsop->close(node);
+			st->ndirs++;
+
+			res = copy_tree(ramfs, path, nlen, mntlen, st);
+		} else {
+			res = copy_file(ramfs, path, path + mntlen, st);
+		}
+		path[len] = 0;
+		if(res == -1) break;
+	}
+
+	closedir(dir);
+	return res;
+}
+
+/* each file is read in one go, which the FAT driver turns into one large
+ * sequential read for each run of consecutive clusters
+ */
+static int copy_file(struct filesys *ramfs, const char *src, const char *dst, struct copy_stats *st)
+{
+	FILE *fp;
+	long sz;
+	void *buf = 0;
+	unsigned long start = nticks;
+	struct fs_node *node;
+	int percent;
+
+	if(!(fp = fopen(src, "rb"))) {
+		printf("\ncopy to RAM: failed to open: %s\n", src);
+		return -1;
+	}
+	if((sz = filesize(fp)) > 0) {
+		if(!(buf = malloc(sz))) {
+			printf("\ncopy to RAM: not enough memory for %s (%ld bytes)\n", src, sz);
+			fclose(fp);
+			return -1;
+		}
+		if(fread(buf, 1, sz, fp) != sz) {
+			printf("\ncopy to RAM: failed to read: %s\n", src);
+			free(buf);
+			fclose(fp);
+			return -1;
+		}
+	}
+	fclose(fp);
+
+	if(!*st->sample && has_suffix(src, ".com")) {
+		strcpy(st->sample, src);
+		st->sample_size = sz;
+		st->sample_msec = TICKS_TO_MSEC(nticks - start);
+	}
+
+	if(!(node = ramfs->fsop->open(ramfs, dst, FSO_CREATE))) {
+		free(buf);
+		return -1;
+	}
+	if(sz > 0 && ramfs->fsop->write(node, buf, sz) != sz) {
+		printf("\ncopy to RAM: not enough memory for %s (%ld bytes)\n", src, sz);
+		ramfs->fsop->close(node);
+		free(buf);
+		return -1;
+	}
+	ramfs->fsop->close(node);
+	free(buf);
+
+	st->nfiles++;
+	st->copied_bytes += sz;
+
+	if(st->total_bytes < 0x1000000) {
+		percent = st->total_bytes ? st->copied_bytes * 100 / st->total_bytes : 100;
+	} else {
+		percent = st->copied_bytes / (st->total_bytes / 100);
+	}
+	if(percent > 100) percent = 100;
+	if(percent != st->percent) {
+		printf("\rcopy to RAM: %3d%% (%d files)", percent, st->nfiles);
+		st->percent = percent;
+	}
+	return 0;
+}
+
+static unsigned long list_dir_msec(const char *path)
+{
+	DIR *dir;
+	unsigned long start = nticks;
+
+	if((dir = opendir(path))) {
+		while(readdir(dir));
+		closedir(dir);
+	}
+	return TICKS_TO_MSEC(nticks - start);
+}
+
+static unsigned long read_file_msec(const char *path)
+{
+	FILE *fp;
+	long sz;
+	void *buf;
+	unsigned long start = nticks;
+
+	if((fp = fopen(path, "rb"))) {
+		sz = filesize(fp);
+		if(sz > 0 && (buf = malloc(sz))) {
+			fread(buf, 1, sz, fp);
+			free(buf);
+		}
+		fclose(fp);
+	}
+	return TICKS_TO_MSEC(nticks - start);
+}
@@ -0,0 +1,28 @@
+/*
+256boss - bootable launcher for 256byte intros
+Copyright (C) 2018-2020  John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY, without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef FSCOPY_H_
+#define FSCOPY_H_
+
+/* Copies the contents of the filesystem mounted at mntpath into a new memory
+ * filesystem, and swaps it in place of the original, so that the same paths
+ * are served from RAM from then on. Must be called with no files or
+ * directories open on the filesystem being copied.
+ */
+int fs_copy_to_ram(const char *mntpath);
+
+#endif	/* FSCOPY_H_ */
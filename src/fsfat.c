@@ -58,6 +58,7 @@ struct fatfs {
 	int fat_size;
 	uint32_t fat_sect;
 	uint32_t root_sect;
+	uint32_t root_clust;	/* FAT32 only */
 	int root_size;
 	uint32_t first_data_sect;
 	uint32_t num_data_sect;
@@ -164,6 +165,7 @@ struct fat_file {
 
 
 static void destroy(struct filesys *fs);
+static int mount(struct filesys *fs);
 
 static struct fs_node *open(struct filesys *fs, const char *path, unsigned int flags);
 static void close(struct fs_node *node);
@@ -186,6 +188,7 @@ static void free_file(struct fat_file *file);
 
 static int read_sectors(int dev, uint64_t sidx, int count, void *sect);
 static int read_cluster(struct fatfs *fatfs, uint32_t addr, void *clust);
+static int read_clusters(struct fatfs *fatfs, uint32_t addr, int count, void *buf);
 static int dent_filename(struct fat_dirent *dent, struct fat_dirent *prev, char *buf);
 static struct fs_dirent *find_entry(struct fat_dir *dir, const char *name);
 
@@ -198,6 +201,7 @@ static void clean_trailws(char *s);
 
 static struct fs_operations fs_fat_ops = {
 	destroy,
+	mount,
 	open, close,
 
 	fsize,
@@ -212,18 +216,20 @@ static struct fs_operations fs_fat_ops = {
 static unsigned char sectbuf[512];
 static int max_sect_once;
 
+/* only reads the boot sector to identify the filesystem. Reading the FAT and
+ * root directory is deferred until the first access (see mount)
+ */
 struct filesys *fsfat_create(int dev, uint64_t start, uint64_t size)
 {
-	int num_read;
-	char *endp, *ptr;
+	char *endp;
 	struct filesys *fs;
 	struct fatfs *fatfs;
-	struct fat_dir *rootdir;
 	struct bparam *bpb;
 	struct bparam_ext16 *bpb16;
 	struct bparam_ext32 *bpb32;
 
-	max_sect_once = ((unsigned char*)0xa0000 - low_mem_buffer) / 512;
+	/* the bounce buffer also holds the disk address packet of LBA reads */
+	max_sect_once = (com_mem_base - low_mem_buffer) / 512 - 1;
 	/* some BIOS implementations have a maximum limit of 127 sectors */
 	if(max_sect_once > 127) max_sect_once = 127;
 
@@ -275,6 +281,7 @@ struct filesys *fsfat_create(int dev, uint64_t start, uint64_t size)
 	case FAT32:
 	case EXFAT:
 		fatfs->root_sect = bpb32->root_clust / fatfs->cluster_size;
+		fatfs->root_clust = bpb32->root_clust;
 		fatfs->root_size = 0;
 		memcpy(fatfs->label, bpb32->label, sizeof bpb32->label);
 		break;
@@ -288,6 +295,39 @@ struct filesys *fsfat_create(int dev, uint64_t start, uint64_t size)
 		*endp-- = 0;
 	}
 
+	/* assume cluster_size is a power of two */
+	fatfs->clust_mask = (fatfs->cluster_size * 512) - 1;
+	fatfs->clust_shift = 0;
+	while((1 << fatfs->clust_shift) < (fatfs->cluster_size * 512)) {
+		fatfs->clust_shift++;
+	}
+
+	/* fill generic fs structure */
+	if(!(fs = malloc(sizeof *fs))) {
+		panic("FAT: create failed to allocate memory for the filesystem structure\n");
+	}
+	fs->type = FSTYPE_FAT;
+	fs->name = fatfs->label;
+	fs->fsop = &fs_fat_ops;
+	fs->data = fatfs;
+	fs->deferred = fatfs->fat_size + fatfs->root_size;
+
+	printf("found %s filesystem dev: %x, start: %lld\n", typestr[fatfs->type], fatfs->dev, start);
+	if(fatfs->label[0]) {
+		printf("  volume label: %s\n", fatfs->label);
+	}
+
+	return fs;
+}
+
+/* read the FAT and root directory on first access */
+static int mount(struct filesys *fs)
+{
+	int num_read;
+	char *ptr;
+	struct fatfs *fatfs = fs->data;
+	struct fat_dir *rootdir;
+
 	/* read the FAT */
 	if(!(fatfs->fat = malloc(fatfs->fat_size * 512))) {
 		panic("FAT: failed to allocate memory for the FAT (%lu bytes)\n", (unsigned long)fatfs->fat_size * 512);
@@ -298,7 +338,7 @@ struct filesys *fsfat_create(int dev, uint64_t start, uint64_t size)
 		int count = fatfs->fat_size - num_read;
 		if(count > max_sect_once) count = max_sect_once;
 
-		read_sectors(dev, fatfs->start_sect + fatfs->fat_sect + num_read, count, ptr);
+		read_sectors(fatfs->dev, fatfs->start_sect + fatfs->fat_sect + num_read, count, ptr);
 		ptr += count * 512;
 		num_read += count;
 	}
@@ -307,8 +347,8 @@ struct filesys *fsfat_create(int dev, uint64_t start, uint64_t size)
 	if(fatfs->type == FAT32) {
 		struct fat_dirent ent;
 		ent.attr = ATTR_DIR;
-		ent.first_cluster_low = bpb32->root_clust;
-		ent.first_cluster_high = bpb32->root_clust >> 16;
+		ent.first_cluster_low = fatfs->root_clust;
+		ent.first_cluster_high = fatfs->root_clust >> 16;
 		if(!(rootdir = load_dir(fatfs, &ent))) {
 			panic("FAT: failed to load FAT32 root directory\n");
 		}
@@ -330,7 +370,7 @@ struct filesys *fsfat_create(int dev, uint64_t start, uint64_t size)
 			int count = fatfs->root_size - num_read;
 			if(count > max_sect_once) count = max_sect_once;
 
-			read_sectors(dev, fatfs->start_sect + fatfs->root_sect + num_read, count, ptr);
+			read_sectors(fatfs->dev, fatfs->start_sect + fatfs->root_sect + num_read, count, ptr);
 			ptr += count * 512;
 			num_read += count;
 		}
@@ -340,34 +380,28 @@ struct filesys *fsfat_create(int dev, uint64_t start, uint64_t size)
 	rootdir->ref = 1;
 	fatfs->rootdir = rootdir;
 
-	/* assume cluster_size is a power of two */
-	fatfs->clust_mask = (fatfs->cluster_size * 512) - 1;
-	fatfs->clust_shift = 0;
-	while((1 << fatfs->clust_shift) < (fatfs->cluster_size * 512)) {
-		fatfs->clust_shift++;
-	}
-
-	/* fill generic fs structure */
-	if(!(fs = malloc(sizeof *fs))) {
-		panic("FAT: create failed to allocate memory for the filesystem structure\n");
-	}
-	fs->type = FSTYPE_FAT;
-	fs->name = fatfs->label;
-	fs->fsop = &fs_fat_ops;
-	fs->data = fatfs;
-
-
-	printf("opened %s filesystem dev: %x, start: %lld\n", typestr[fatfs->type], fatfs->dev, start);
-	if(fatfs->label[0]) {
-		printf("  volume label: %s\n", fatfs->label);
-	}
-
-	return fs;
+	printf("opened %s filesystem dev: %x, start: %lld\n", typestr[fatfs->type], fatfs->dev,
+			fatfs->start_sect);
+	return 0;
 }
 
 static void destroy(struct filesys *fs)
 {
+	int i;
 	struct fatfs *fatfs = fs->data;
+	struct fat_dir *root = fatfs->rootdir;
+
+	if(root) {
+		if(root->fsent) {
+			for(i=0; i<root->fsent_size; i++) {
+				free(root->fsent[i].name);
+			}
+			free(root->fsent);
+		}
+		free(root->ent);
+		free(root);
+	}
+	free(fatfs->fat);
 	free(fatfs);
 	free(fs);
 }
@@ -553,7 +587,8 @@ static int read(struct fs_node *node, void *buf, int sz)
 	struct fat_file *file;
 	char *bufptr = buf;
 	int num_read = 0;
-	int offs, len, buf_left, rd_left;
+	int offs, len, buf_left, rd_left, clust_bytes, nclust;
+	int32_t next;
 	unsigned int cur_clust_idx, new_clust_idx;
 
 	if(!node || !buf || sz < 0 || node->type != FSNODE_FILE) {
@@ -568,8 +603,41 @@ static int read(struct fs_node *node, void *buf, int sz)
 	}
 
 	cur_clust_idx = file->cur_pos >> fatfs->clust_shift;
+	clust_bytes = fatfs->cluster_size * 512;
 
 	while(num_read < sz) {
+		/* whole clusters go straight to the destination buffer, with runs of
+		 * consecutive clusters merged into large sequential reads
+		 */
+		offs = file->cur_pos & fatfs->clust_mask;
+		rd_left = sz - num_read;
+		if(rd_left > file->ent.size_bytes - file->cur_pos) {
+			rd_left = file->ent.size_bytes - file->cur_pos;
+		}
+		if(!offs && rd_left >= clust_bytes) {
+			nclust = 1;
+			next = next_cluster(fatfs, file->cur_clust);
+			while(next == file->cur_clust + nclust && (nclust + 1) * clust_bytes <= rd_left) {
+				nclust++;
+				next = next_cluster(fatfs, next);
+			}
+			if(read_clusters(fatfs, file->cur_clust, nclust, bufptr) == -1) {
+				break;
+			}
+			len = nclust * clust_bytes;
+			num_read += len;
+			bufptr += len;
+
+			file->cur_pos += len;
+			file->buf_valid = 0;
+			if(file->cur_pos >= file->ent.size_bytes || (file->cur_clust = next) < 0) {
+				file->cur_clust = -1;
+				break;	/* reached EOF */
+			}
+			cur_clust_idx = file->cur_pos >> fatfs->clust_shift;
+			continue;
+		}
+
 		if(!file->buf_valid) {
 			read_cluster(fatfs, file->cur_clust, file->clustbuf);
 			file->buf_valid = 1;
@@ -803,6 +871,25 @@ static int read_cluster(struct fatfs *fatfs, uint32_t addr, void *clust)
 	return 0;
 }
 
+/* reads count consecutive clusters, max_sect_once sectors at a time */
+static int read_clusters(struct fatfs *fatfs, uint32_t addr, int count, void *buf)
+{
+	char *ptr = buf;
+	int nsect = count * fatfs->cluster_size;
+	uint64_t saddr = (uint64_t)(addr - 2) * fatfs->cluster_size + fatfs->first_data_sect + fatfs->start_sect;
+
+	while(nsect > 0) {
+		int n = nsect > max_sect_once ? max_sect_once : nsect;
+		if(read_sectors(fatfs->dev, saddr, n, ptr) == -1) {
+			return -1;
+		}
+		ptr += n * 512;
+		saddr += n;
+		nsect -= n;
+	}
+	return 0;
+}
+
 static int dent_filename(struct fat_dirent *dent, struct fat_dirent *prev, char *buf)
 {
 	int len = 0;
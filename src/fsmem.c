@@ -93,6 +93,7 @@ static void add_child(struct memfs_node *dir, struct memfs_node *n);
 
 static struct fs_operations fs_mem_ops = {
 	destroy,
+	0,
 	open, close,
 
 	fsize,
@@ -128,6 +129,7 @@ struct filesys *fsmem_create(int dev, uint64_t start, uint64_t size)
 	fs->name = 0;
 	fs->fsop = &fs_mem_ops;
 	fs->data = memfs;
+	fs->deferred = 0;
 
 	return fs;
 }
@@ -144,6 +146,11 @@ static struct fs_node *open_mount(struct filesys *fs, const char *path, unsigned
 {
 	char *newpath;
 
+	if(fs_mount_deferred(fs) == -1) {
+		errno = EIO;
+		return 0;
+	}
+
 	newpath = alloca(strlen(path) + 2);
 	newpath[0] = '/';
 	strcpy(newpath + 1, path);
@@ -259,8 +266,21 @@ static struct fs_node *create_fsnode(struct filesys *fs, struct memfs_node *n)
 
 static void close(struct fs_node *node)
 {
+	struct memfs_node *n;
+
 	if(!node) return;
 
+	if(node->type == FSNODE_DIR) {
+		n = (struct memfs_node*)((struct odir*)node->data)->dir;
+	} else {
+		n = (struct memfs_node*)((struct ofile*)node->data)->file;
+	}
+	if(n->fsnode == node) {
+		/* mount points keep the node that holds the mount, see NODE_IS_MNTPT */
+		if(node->mnt) return;
+		n->fsnode = 0;
+	}
+
 	free(node->data);	/* free the copy of memfs_node allocated by create_fsnode */
 	free(node);
 }
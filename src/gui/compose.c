@@ -0,0 +1,213 @@
+/*
+256boss - bootable launcher for 256byte intros
+Copyright (C) 2018-2019  John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY, without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <string.h>
+#include "compose.h"
+
+/* merge two rects if their bounding box is at most this much larger than
+ * the two areas combined, copying a few extra pixels is cheaper than doing
+ * lots of small copies.
+ */
+#define MERGE_SLACK		1024
+
+#define AREA(r)	((long)(r)->width * (long)(r)->height)
+
+struct rectlist {
+	struct gui_rect rect[GUI_MAX_DIRTY];
+	int num;
+};
+
+static int clip_rect(struct gui_rect *r);
+static void bound_rect(struct gui_rect *res, struct gui_rect *a, struct gui_rect *b);
+static void add_rect(struct rectlist *rl, struct gui_rect *r);
+static void copy_rect(struct gui_image *fb, void *dest, struct gui_rect *r);
+
+/* damage of the current frame, followed by the last GUI_MAX_AGE-1 frames */
+static struct rectlist hist[GUI_MAX_AGE];
+static int scr_width, scr_height;
+static struct gui_comp_stats stats;
+
+void gui_comp_init(int width, int height)
+{
+	memset(hist, 0, sizeof hist);
+	memset(&stats, 0, sizeof stats);
+	scr_width = width;
+	scr_height = height;
+
+	gui_dirty(0, 0, width, height);
+}
+
+void gui_dirty(int x, int y, int w, int h)
+{
+	struct gui_rect r;
+
+	r.x = x;
+	r.y = y;
+	r.width = w;
+	r.height = h;
+	if(clip_rect(&r) == -1) {
+		return;
+	}
+	add_rect(hist, &r);
+}
+
+int gui_comp_pending(void)
+{
+	return hist[0].num;
+}
+
+void gui_compose(struct gui_gfx *g, gui_redraw_func redraw, void *dest, int age)
+{
+	int i, j;
+	struct gui_rect *r;
+	struct rectlist push;
+
+	stats.last_drawn = stats.last_pushed = 0;
+
+	r = hist[0].rect;
+	for(i=0; i<hist[0].num; i++) {
+		g->clip = *r;
+		redraw(g);
+		stats.last_drawn += AREA(r);
+		r++;
+	}
+	g->clip.x = g->clip.y = 0;
+	g->clip.width = g->fb.width;
+	g->clip.height = g->fb.height;
+
+	if(dest && dest != g->fb.pixels) {
+		if(age <= 0 || age > GUI_MAX_AGE) {
+			push.num = 1;
+			push.rect[0] = g->clip;
+		} else {
+			push = hist[0];
+			for(i=1; i<age; i++) {
+				for(j=0; j<hist[i].num; j++) {
+					add_rect(&push, hist[i].rect + j);
+				}
+			}
+		}
+
+		r = push.rect;
+		for(i=0; i<push.num; i++) {
+			copy_rect(&g->fb, dest, r);
+			stats.last_pushed += AREA(r);
+			r++;
+		}
+	}
+
+	stats.frames++;
+	stats.pixels_drawn += stats.last_drawn;
+	stats.pixels_pushed += stats.last_pushed;
+
+	memmove(hist + 1, hist, (GUI_MAX_AGE - 1) * sizeof *hist);
+	hist[0].num = 0;
+}
+
+struct gui_comp_stats *gui_comp_stats(void)
+{
+	return &stats;
+}
+
+static int clip_rect(struct gui_rect *r)
+{
+	if(r->x < 0) {
+		r->width += r->x;
+		r->x = 0;
+	}
+	if(r->y < 0) {
+		r->height += r->y;
+		r->y = 0;
+	}
+	if(r->x + r->width > scr_width) r->width = scr_width - r->x;
+	if(r->y + r->height > scr_height) r->height = scr_height - r->y;
+
+	return r->width > 0 && r->height > 0 ? 0 : -1;
+}
+
+static void bound_rect(struct gui_rect *res, struct gui_rect *a, struct gui_rect *b)
+{
+	int x1 = a->x + a->width;
+	int y1 = a->y + a->height;
+
+	if(b->x + b->width > x1) x1 = b->x + b->width;
+	if(b->y + b->height > y1) y1 = b->y + b->height;
+
+	res->x = a->x < b->x ? a->x : b->x;
+	res->y = a->y < b->y ? a->y : b->y;
+	res->width = x1 - res->x;
+	res->height = y1 - res->y;
+}
+
+static void add_rect(struct rectlist *rl, struct gui_rect *r)
+{
+	int i, best;
+	long cost, best_cost;
+	struct gui_rect u, nr = *r;
+
+	/* merge with any rect close enough, and retry with the result, which
+	 * might now be close enough to others.
+	 */
+again:
+	for(i=0; i<rl->num; i++) {
+		bound_rect(&u, rl->rect + i, &nr);
+		if(AREA(&u) <= AREA(rl->rect + i) + AREA(&nr) + MERGE_SLACK) {
+			nr = u;
+			rl->rect[i] = rl->rect[--rl->num];
+			goto again;
+		}
+	}
+
+	if(rl->num >= GUI_MAX_DIRTY) {
+		/* out of slots, merge with the one which grows the least */
+		best = 0;
+		best_cost = 0;
+		for(i=0; i<rl->num; i++) {
+			bound_rect(&u, rl->rect + i, &nr);
+			cost = AREA(&u) - AREA(rl->rect + i);
+			if(i == 0 || cost < best_cost) {
+				best = i;
+				best_cost = cost;
+			}
+		}
+		bound_rect(&u, rl->rect + best, &nr);
+		nr = u;
+		rl->rect[best] = rl->rect[--rl->num];
+		goto again;
+	}
+
+	rl->rect[rl->num++] = nr;
+}
+
+static void copy_rect(struct gui_image *fb, void *dest, struct gui_rect *r)
+{
+	int i, bytespp, offs, rowsz;
+	unsigned char *sptr, *dptr;
+
+	bytespp = (fb->bpp + 7) >> 3;
+	offs = r->y * fb->pitch + r->x * bytespp;
+	rowsz = r->width * bytespp;
+
+	sptr = (unsigned char*)fb->pixels + offs;
+	dptr = (unsigned char*)dest + offs;
+
+	for(i=0; i<r->height; i++) {
+		gui_copy_span(dptr, sptr, rowsz);
+		sptr += fb->pitch;
+		dptr += fb->pitch;
+	}
+}
@@ -0,0 +1,53 @@
+/*
+256boss - bootable launcher for 256byte intros
+Copyright (C) 2018-2019  John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY, without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef GUI_COMPOSE_H_
+#define GUI_COMPOSE_H_
+
+#include "gfx.h"
+
+#define GUI_MAX_DIRTY	32
+#define GUI_MAX_AGE		3	/* enough for triple buffering */
+
+struct gui_comp_stats {
+	unsigned long frames;
+	unsigned long pixels_drawn, pixels_pushed;	/* totals */
+	unsigned long last_drawn, last_pushed;		/* during the last frame */
+};
+
+/* redraws the whole scene. It's called once for each dirty rectangle with the
+ * clip rect set to it, so anything outside it is discarded by the draw funcs.
+ */
+typedef void (*gui_redraw_func)(struct gui_gfx *g);
+
+/* resets the damage history, and marks the whole screen dirty */
+void gui_comp_init(int width, int height);
+
+void gui_dirty(int x, int y, int w, int h);
+/* non-zero if anything was marked dirty since the last gui_compose */
+int gui_comp_pending(void);
+
+/* Redraws the dirty parts of the current frame into the framebuffer of g,
+ * then copies them to dest, which has the same size and pitch. dest is a
+ * video memory page which was last updated age frames ago, so the damage of
+ * the previous age-1 frames is copied too (age <= 0: copy everything).
+ */
+void gui_compose(struct gui_gfx *g, gui_redraw_func redraw, void *dest, int age);
+
+struct gui_comp_stats *gui_comp_stats(void);
+
+#endif	/* GUI_COMPOSE_H_ */
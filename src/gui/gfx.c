@@ -38,6 +38,29 @@ void gui_framebuffer(void *pix, int w, int h, int pitch)
 	gfx->fb.width = w;
 	gfx->fb.height = h;
 	gfx->fb.pitch = pitch;
+
+	gfx->clip.x = gfx->clip.y = 0;
+	gfx->clip.width = w;
+	gfx->clip.height = h;
+}
+
+void gui_clip(int x, int y, int w, int h)
+{
+	if(x < 0) {
+		w += x;
+		x = 0;
+	}
+	if(y < 0) {
+		h += y;
+		y = 0;
+	}
+	if(x + w > gfx->fb.width) w = gfx->fb.width - x;
+	if(y + h > gfx->fb.height) h = gfx->fb.height - y;
+
+	gfx->clip.x = x;
+	gfx->clip.y = y;
+	gfx->clip.width = w > 0 ? w : 0;
+	gfx->clip.height = h > 0 ? h : 0;
 }
 
 static unsigned int mask_bits(int n)
@@ -45,20 +68,23 @@ static unsigned int mask_bits(int n)
 	int i;
 	unsigned int mask = 0;
 	for(i=0; i<n; i++) {
-		mask |= 1 << n;
+		mask |= 1 << i;
 	}
 	return mask;
 }
 
-void gui_pixelformat(int bpp, int rbits, int gbits, int bbits)
+void gui_pixelformat(int bpp, int rbits, int gbits, int bbits, int rshift, int gshift, int bshift)
 {
 	assert(rbits + gbits + bbits <= bpp);
-	gfx->fb.rshift = 0;
-	gfx->fb.rmask = mask_bits(rbits);
-	gfx->fb.gshift = rbits;
-	gfx->fb.gmask = mask_bits(gbits) << rbits;
-	gfx->fb.bshift = rbits + gbits;
-	gfx->fb.bmask = mask_bits(bbits) << (rbits + gbits);
+	gfx->fb.bpp = bpp;
+	gfx->fb.rshift = rshift;
+	gfx->fb.rmask = mask_bits(rbits) << rshift;
+	gfx->fb.gshift = gshift;
+	gfx->fb.gmask = mask_bits(gbits) << gshift;
+	gfx->fb.bshift = bshift;
+	gfx->fb.bmask = mask_bits(bbits) << bshift;
+
+	gui_simd(-1);
 
 	switch(bpp) {
 	case 8:
@@ -29,6 +29,10 @@ struct gui_image {
 	unsigned int bshift, bmask;
 };
 
+struct gui_rect {
+	int x, y, width, height;
+};
+
 struct gui_gfx;
 
 struct gui_draw {
@@ -46,12 +50,37 @@ struct gui_gfx {
 	struct gui_draw draw;
 
 	uint32_t color;
+	struct gui_rect clip;	/* drawing is restricted to this part of fb */
 };
 
 void gui_setgfx(struct gui_gfx *g);
 struct gui_gfx *gui_getgfx(void);
 
+enum {
+	GUI_SIMD_NONE,
+	GUI_SIMD_MMX,
+	GUI_SIMD_SSE2
+};
+
 void gui_framebuffer(void *pix, int w, int h, int pitch);
-void gui_pixelformat(int bpp, int rbits, int gbits, int bbits);
+void gui_pixelformat(int bpp, int rbits, int gbits, int bbits, int rshift, int gshift, int bshift);
+
+/* limits the draw functions to the given instruction set extensions (-1 keeps
+ * the current limit) and returns the ones actually used, depending on the CPU.
+ * The draw functions are selected again by gui_pixelformat.
+ */
+int gui_simd(int level);
+
+/* memcpy using the vector copy loop selected by gui_simd */
+void gui_copy_span(void *dest, const void *src, int nbytes);
+
+/* blits an 8bpp image with colors from cmap (0xrrggbb entries), or a 32bpp
+ * image with the channel masks and shifts in img, converting to the pixel
+ * format of the framebuffer.
+ */
+void gui_blit_conv(struct gui_gfx *g, int x, int y, struct gui_image *img, const uint32_t *cmap);
+
+/* gui_framebuffer resets the clip rect to the whole framebuffer */
+void gui_clip(int x, int y, int w, int h);
 
 #endif	/* GUI_GFX_H_ */
@@ -17,6 +17,28 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 #include <string.h>
 #include "gfxdraw.h"
+#include "cpu.h"
+
+/* gfxdraw_asm.s: store nblk 48-byte blocks of pat, which holds a whole number
+ * of pixels of any size, and copy nblk 64-byte blocks. dest must be aligned
+ * to 8 (mmx) or 16 (sse2) bytes.
+ */
+void fill_mmx(void *dest, const void *pat, int nblk);
+void fill_sse2(void *dest, const void *pat, int nblk);
+void copy_mmx(void *dest, const void *src, int nblk);
+void copy_sse2(void *dest, const void *src, int nblk);
+
+#define FILL_BLKSZ	48
+#define COPY_BLKSZ	64
+
+static void fill_rect(struct gui_gfx *g, int x, int y, int w, int h, int bytespp);
+static void make_pattern(unsigned char *pat, uint32_t color, int bytespp);
+static void fill_span(unsigned char *dest, const unsigned char *pat, int bytespp, int count);
+static void blit_rows(struct gui_gfx *g, int x, int y, struct gui_image *img, int bytespp);
+static int top_bit(uint32_t mask);
+static void chan_shifts(uint32_t dmask, int sbits, int *lsh, int *rsh);
+static void draw_line(struct gui_gfx *g, int x0, int y0, int x1, int y1,
+		void (*putpix)(struct gui_gfx*, int, int));
 
 static void clear8(struct gui_gfx *g);
 static void clear16(struct gui_gfx *g);
@@ -93,79 +115,78 @@ struct gui_draw draw_rgb32 = {
 	blit32
 };
 
-static void clear8(struct gui_gfx *g)
+static int simd_level = GUI_SIMD_SSE2;	/* upper limit, see gui_simd */
+static int simd_align;
+static void (*fill_blocks)(void *dest, const void *pat, int nblk);
+static void (*copy_blocks)(void *dest, const void *src, int nblk);
+
+int gui_simd(int level)
 {
-	int i;
-	unsigned char *pptr = g->fb.pixels;
+	if(level >= 0) {
+		simd_level = level;
+	}
 
-	for(i=0; i<g->fb.height; i++) {
-		memset(pptr, g->fb.width, g->color);
-		pptr += g->fb.pitch;
+	if(simd_level >= GUI_SIMD_SSE2 && cpu_has(CPU_FEAT_SSE2)) {
+		fill_blocks = fill_sse2;
+		copy_blocks = copy_sse2;
+		simd_align = 16;
+		return GUI_SIMD_SSE2;
+	}
+	if(simd_level >= GUI_SIMD_MMX && cpu_has(CPU_FEAT_MMX)) {
+		fill_blocks = fill_mmx;
+		copy_blocks = copy_mmx;
+		simd_align = 8;
+		return GUI_SIMD_MMX;
 	}
+	fill_blocks = 0;
+	copy_blocks = 0;
+	return GUI_SIMD_NONE;
 }
 
-static void clear16(struct gui_gfx *g)
+static void clear8(struct gui_gfx *g)
 {
-	int i;
-	uint16_t *pptr = g->fb.pixels;
+	rect8(g, 0, 0, g->fb.width, g->fb.height);
+}
 
-	for(i=0; i<g->fb.height; i++) {
-		memset16(pptr, g->fb.width, g->color);
-		pptr += g->fb.pitch / 2;
-	}
+static void clear16(struct gui_gfx *g)
+{
+	rect16(g, 0, 0, g->fb.width, g->fb.height);
 }
 
 static void clear24(struct gui_gfx *g)
 {
-	int i, j;
-	unsigned char cr, cg, cb;
-	unsigned char *pptr = g->fb.pixels;
-
-	cr = g->color;
-	cg = g->color >> 8;
-	cb = g->color >> 16;
-
-	for(i=0; i<g->fb.height; i++) {
-		unsigned char *p = pptr;
-		for(j=0; j<g->fb.width; j++) {
-			*p++ = cr;
-			*p++ = cg;
-			*p++ = cb;
-		}
-		pptr += g->fb.pitch;
-	}
+	rect24(g, 0, 0, g->fb.width, g->fb.height);
 }
 
 static void clear32(struct gui_gfx *g)
 {
-	int i, j;
-	unsigned char *pptr = g->fb.pixels;
-
-	for(i=0; i<g->fb.height; i++) {
-		unsigned char *p = pptr;
-		for(j=0; j<g->fb.width; j++) {
-			*p++ = g->color;
-		}
-		pptr += g->fb.pitch / 4;
-	}
+	rect32(g, 0, 0, g->fb.width, g->fb.height);
 }
 
 
+/* true if x,y is inside the clip rect */
+#define INCLIP(g, x, y) \
+	((x) >= (g)->clip.x && (y) >= (g)->clip.y && \
+	 (x) < (g)->clip.x + (g)->clip.width && (y) < (g)->clip.y + (g)->clip.height)
+
 static void putpixel8(struct gui_gfx *g, int x, int y)
 {
 	unsigned char *p = g->fb.pixels;
+	if(!INCLIP(g, x, y)) return;
 	p[y * g->fb.pitch + x] = g->color;
 }
 
 static void putpixel16(struct gui_gfx *g, int x, int y)
 {
 	uint16_t *p = g->fb.pixels;
+	if(!INCLIP(g, x, y)) return;
 	p[y * g->fb.pitch / 2 + x] = g->color;
 }
 
 static void putpixel24(struct gui_gfx *g, int x, int y)
 {
 	unsigned char *p = (unsigned char*)g->fb.pixels + y * g->fb.pitch + x * 3;
+	if(!INCLIP(g, x, y)) return;
 	p[0] = g->color;
 	p[1] = g->color >> 8;
 	p[2] = g->color >> 16;
@@ -174,25 +195,27 @@ static void putpixel24(struct gui_gfx *g, int x, int y)
 static void putpixel32(struct gui_gfx *g, int x, int y)
 {
 	uint32_t *p = g->fb.pixels;
+	if(!INCLIP(g, x, y)) return;
 	p[y * g->fb.pitch / 4 + x] = g->color;
 }
 
 #define BOUNDRECT(g, x, y, w, h) \
 	do { \
-		if((x) < 0) { \
-			(w) += (x); \
-			(x) = 0; \
+		if((x) < (g)->clip.x) { \
+			(w) -= (g)->clip.x - (x); \
+			(x) = (g)->clip.x; \
 		} \
-		if((y) < 0) { \
-			(h) += (y); \
-			(y) = 0; \
+		if((y) < (g)->clip.y) { \
+			(h) -= (g)->clip.y - (y); \
+			(y) = (g)->clip.y; \
 		} \
-		if((x) + (w) > (g)->fb.width) { \
-			(w) = (g)->fb.width - (x); \
+		if((x) + (w) > (g)->clip.x + (g)->clip.width) { \
+			(w) = (g)->clip.x + (g)->clip.width - (x); \
 		} \
-		if((y) + (h) > (g)->fb.height) { \
-			(h) = (g)->fb.height - (y); \
+		if((y) + (h) > (g)->clip.y + (g)->clip.height) { \
+			(h) = (g)->clip.y + (g)->clip.height - (y); \
 		} \
+		if((w) <= 0 || (h) <= 0) return; \
 	} while(0)
 
 static void rect8(struct gui_gfx *g, int x, int y, int w, int h)
@@ -204,7 +227,7 @@ static void rect8(struct gui_gfx *g, int x, int y, int w, int h)
 
 	pptr = (unsigned char*)g->fb.pixels + y * g->fb.pitch + x;
 	for(i=0; i<h; i++) {
-		memset(pptr, w, g->color);
+		memset(pptr, g->color, w);
 		pptr += g->fb.pitch;
 	}
 }
@@ -216,9 +239,14 @@ static void rect16(struct gui_gfx *g, int x, int y, int w, int h)
 
 	BOUNDRECT(g, x, y, w, h);
 
+	if(fill_blocks && w * 2 >= FILL_BLKSZ) {
+		fill_rect(g, x, y, w, h, 2);
+		return;
+	}
+
 	pptr = (uint16_t*)g->fb.pixels + y * g->fb.pitch / 2 + x;
 	for(i=0; i<h; i++) {
-		memset16(pptr, w, g->color);
+		memset16(pptr, g->color, w);
 		pptr += g->fb.pitch / 2;
 	}
 }
@@ -231,6 +259,11 @@ static void rect24(struct gui_gfx *g, int x, int y, int w, int h)
 
 	BOUNDRECT(g, x, y, w, h);
 
+	if(fill_blocks && w * 3 >= FILL_BLKSZ) {
+		fill_rect(g, x, y, w, h, 3);
+		return;
+	}
+
 	cr = g->color;
 	cg = g->color >> 8;
 	cb = g->color >> 16;
@@ -254,6 +287,11 @@ static void rect32(struct gui_gfx *g, int x, int y, int w, int h)
 
 	BOUNDRECT(g, x, y, w, h);
 
+	if(fill_blocks && w * 4 >= FILL_BLKSZ) {
+		fill_rect(g, x, y, w, h, 4);
+		return;
+	}
+
 	pptr = (uint32_t*)g->fb.pixels + y * g->fb.pitch / 4 + x;
 	for(i=0; i<h; i++) {
 		for(j=0; j<w; j++) {
@@ -263,70 +301,324 @@ static void rect32(struct gui_gfx *g, int x, int y, int w, int h)
 	}
 }
 
+/* vector fill of an already clipped rect */
+static void fill_rect(struct gui_gfx *g, int x, int y, int w, int h, int bytespp)
+{
+	int i;
+	unsigned char pat[FILL_BLKSZ];
+	unsigned char *pptr;
+
+	make_pattern(pat, g->color, bytespp);
+
+	pptr = (unsigned char*)g->fb.pixels + y * g->fb.pitch + x * bytespp;
+	for(i=0; i<h; i++) {
+		fill_span(pptr, pat, bytespp, w);
+		pptr += g->fb.pitch;
+	}
+}
+
+static void make_pattern(unsigned char *pat, uint32_t color, int bytespp)
+{
+	int i, j;
+
+	for(i=0; i<FILL_BLKSZ; i+=bytespp) {
+		for(j=0; j<bytespp; j++) {
+			*pat++ = color >> (j << 3);
+		}
+	}
+}
+
+static void fill_span(unsigned char *dest, const unsigned char *pat, int bytespp, int count)
+{
+	int i, nblk;
+
+	/* plain stores up to the alignment of the vector code. Any pixel size
+	 * gets there within 16 pixels, unless the buffer itself is misaligned.
+	 */
+	for(i=0; i<16 && count > 0 && ((uint32_t)dest & (simd_align - 1)); i++) {
+		memcpy(dest, pat, bytespp);
+		dest += bytespp;
+		count--;
+	}
+
+	if(!((uint32_t)dest & (simd_align - 1))) {
+		nblk = count * bytespp / FILL_BLKSZ;
+		fill_blocks(dest, pat, nblk);
+		dest += nblk * FILL_BLKSZ;
+		count -= nblk * (FILL_BLKSZ / bytespp);
+	}
+
+	while(count-- > 0) {
+		memcpy(dest, pat, bytespp);
+		dest += bytespp;
+	}
+}
+
+void gui_copy_span(void *dptr, const void *sptr, int nbytes)
+{
+	int nalign, nblk;
+	unsigned char *dest = dptr;
+	const unsigned char *src = sptr;
+
+	if(!copy_blocks || nbytes < COPY_BLKSZ) {
+		memcpy(dest, src, nbytes);
+		return;
+	}
+
+	nalign = -(uint32_t)dest & (simd_align - 1);
+	memcpy(dest, src, nalign);
+	dest += nalign;
+	src += nalign;
+	nbytes -= nalign;
+
+	nblk = nbytes / COPY_BLKSZ;
+	copy_blocks(dest, src, nblk);
+	nblk *= COPY_BLKSZ;
+	memcpy(dest + nblk, src + nblk, nbytes - nblk);
+}
+
 
 static void hline8(struct gui_gfx *g, int x, int y, int len)
 {
+	rect8(g, x, y, len, 1);
 }
 
 static void hline16(struct gui_gfx *g, int x, int y, int len)
 {
+	rect16(g, x, y, len, 1);
 }
 
 static void hline24(struct gui_gfx *g, int x, int y, int len)
 {
+	rect24(g, x, y, len, 1);
 }
 
 static void hline32(struct gui_gfx *g, int x, int y, int len)
 {
+	rect32(g, x, y, len, 1);
 }
 
 
 static void vline8(struct gui_gfx *g, int x, int y, int len)
 {
+	rect8(g, x, y, 1, len);
 }
 
 static void vline16(struct gui_gfx *g, int x, int y, int len)
 {
+	rect16(g, x, y, 1, len);
 }
 
 static void vline24(struct gui_gfx *g, int x, int y, int len)
 {
+	rect24(g, x, y, 1, len);
 }
 
 static void vline32(struct gui_gfx *g, int x, int y, int len)
 {
+	rect32(g, x, y, 1, len);
 }
 
 
 static void line8(struct gui_gfx *g, int x0, int y0, int x1, int y1)
 {
+	draw_line(g, x0, y0, x1, y1, putpixel8);
 }
 
 static void line16(struct gui_gfx *g, int x0, int y0, int x1, int y1)
 {
+	draw_line(g, x0, y0, x1, y1, putpixel16);
 }
 
 static void line24(struct gui_gfx *g, int x0, int y0, int x1, int y1)
 {
+	draw_line(g, x0, y0, x1, y1, putpixel24);
 }
 
 static void line32(struct gui_gfx *g, int x0, int y0, int x1, int y1)
 {
+	draw_line(g, x0, y0, x1, y1, putpixel32);
+}
+
+/* bresenham, clipped per pixel by putpix. Lines entirely on one side of the
+ * clip rect are skipped.
+ */
+static void draw_line(struct gui_gfx *g, int x0, int y0, int x1, int y1,
+		void (*putpix)(struct gui_gfx*, int, int))
+{
+	int dx, dy, sx, sy, err, e2;
+	int cx1 = g->clip.x + g->clip.width;
+	int cy1 = g->clip.y + g->clip.height;
+
+	if((x0 < g->clip.x && x1 < g->clip.x) || (x0 >= cx1 && x1 >= cx1) ||
+			(y0 < g->clip.y && y1 < g->clip.y) || (y0 >= cy1 && y1 >= cy1)) {
+		return;
+	}
+
+	dx = x1 > x0 ? x1 - x0 : x0 - x1;
+	dy = y1 > y0 ? y0 - y1 : y1 - y0;
+	sx = x0 < x1 ? 1 : -1;
+	sy = y0 < y1 ? 1 : -1;
+	err = dx + dy;
+
+	for(;;) {
+		putpix(g, x0, y0);
+		if(x0 == x1 && y0 == y1) break;
+		e2 = err * 2;
+		if(e2 >= dy) {
+			err += dy;
+			x0 += sx;
+		}
+		if(e2 <= dx) {
+			err += dx;
+			y0 += sy;
+		}
+	}
 }
 
 
 static void blit8(struct gui_gfx *g, int x, int y, struct gui_image *img)
 {
+	blit_rows(g, x, y, img, 1);
 }
 
 static void blit16(struct gui_gfx *g, int x, int y, struct gui_image *img)
 {
+	blit_rows(g, x, y, img, 2);
 }
 
 static void blit24(struct gui_gfx *g, int x, int y, struct gui_image *img)
 {
+	blit_rows(g, x, y, img, 3);
 }
 
 static void blit32(struct gui_gfx *g, int x, int y, struct gui_image *img)
 {
+	blit_rows(g, x, y, img, 4);
+}
+
+#define BOUNDBLIT(g, x, y, w, h, sx, sy) \
+	do { \
+		int x0 = x, y0 = y; \
+		BOUNDRECT(g, x, y, w, h); \
+		(sx) = (x) - x0; \
+		(sy) = (y) - y0; \
+	} while(0)
+
+/* blit of an image in the same pixel format as the framebuffer */
+static void blit_rows(struct gui_gfx *g, int x, int y, struct gui_image *img, int bytespp)
+{
+	int i, sx, sy, w = img->width, h = img->height;
+	unsigned char *sptr, *dptr;
+
+	BOUNDBLIT(g, x, y, w, h, sx, sy);
+
+	sptr = (unsigned char*)img->pixels + sy * img->pitch + sx * bytespp;
+	dptr = (unsigned char*)g->fb.pixels + y * g->fb.pitch + x * bytespp;
+	for(i=0; i<h; i++) {
+		gui_copy_span(dptr, sptr, w * bytespp);
+		sptr += img->pitch;
+		dptr += g->fb.pitch;
+	}
+}
+
+void gui_blit_conv(struct gui_gfx *g, int x, int y, struct gui_image *img, const uint32_t *cmap)
+{
+	int i, j, sx, sy, bytespp, w = img->width, h = img->height;
+	int rl, rr, gl, gr, bl, br;
+	unsigned char *sptr, *dptr, *dp;
+	uint32_t *src32, pix, lut[256];
+	struct gui_image *fb = &g->fb;
+
+	if(g->fb.bpp == 8) {
+		if(img->bpp == 8) {
+			blit_rows(g, x, y, img, 1);
+		}
+		return;	/* no RGB to palette index conversion */
+	}
+	if(img->bpp != 8 && img->bpp != 32) {
+		return;
+	}
+
+	BOUNDBLIT(g, x, y, w, h, sx, sy);
+
+	bytespp = (g->fb.bpp + 7) >> 3;
+
+	/* palette entries have 8 bits per channel, RGB images whatever their
+	 * masks say.
+	 */
+	if(img->bpp == 8) {
+		chan_shifts(fb->rmask, 8, &rl, &rr);
+		chan_shifts(fb->gmask, 8, &gl, &gr);
+		chan_shifts(fb->bmask, 8, &bl, &br);
+	} else {
+		chan_shifts(fb->rmask, top_bit(img->rmask >> img->rshift), &rl, &rr);
+		chan_shifts(fb->gmask, top_bit(img->gmask >> img->gshift), &gl, &gr);
+		chan_shifts(fb->bmask, top_bit(img->bmask >> img->bshift), &bl, &br);
+	}
+#define PACK_RGB(r, g, b) \
+	(((((uint32_t)(r) << rl) >> rr) & fb->rmask) | \
+	 ((((uint32_t)(g) << gl) >> gr) & fb->gmask) | \
+	 ((((uint32_t)(b) << bl) >> br) & fb->bmask))
+
+	if(img->bpp == 8) {
+		for(i=0; i<256; i++) {
+			lut[i] = PACK_RGB((cmap[i] >> 16) & 0xff, (cmap[i] >> 8) & 0xff, cmap[i] & 0xff);
+		}
+	}
+
+	sptr = (unsigned char*)img->pixels + sy * img->pitch + sx * (img->bpp >> 3);
+	dptr = (unsigned char*)g->fb.pixels + y * g->fb.pitch + x * bytespp;
+
+	for(i=0; i<h; i++) {
+		dp = dptr;
+		src32 = (uint32_t*)sptr;
+		for(j=0; j<w; j++) {
+			if(img->bpp == 8) {
+				pix = lut[sptr[j]];
+			} else {
+				pix = src32[j];
+				pix = PACK_RGB((pix & img->rmask) >> img->rshift,
+						(pix & img->gmask) >> img->gshift, (pix & img->bmask) >> img->bshift);
+			}
+
+			switch(bytespp) {
+			case 4:
+				*(uint32_t*)dp = pix;
+				break;
+			case 3:
+				dp[2] = pix >> 16;
+				/* fallthrough */
+			case 2:
+				*(uint16_t*)dp = pix;
+			}
+			dp += bytespp;
+		}
+		sptr += img->pitch;
+		dptr += g->fb.pitch;
+	}
+#undef PACK_RGB
+}
+
+/* shifts converting an sbits wide channel value to the dmask channel: left to
+ * move its top bit to bit 31, then right to the top of dmask. Zero widths and
+ * empty masks get zero shifts, their channel comes out as 0 anyway.
+ */
+static void chan_shifts(uint32_t dmask, int sbits, int *lsh, int *rsh)
+{
+	int dtop = top_bit(dmask);
+
+	*lsh = sbits > 0 ? 32 - sbits : 0;
+	*rsh = dtop > 0 ? 32 - dtop : 0;
+}
+
+/* number of bits up to and including the highest set bit */
+static int top_bit(uint32_t mask)
+{
+	int n = 0;
+	while(mask) {
+		mask >>= 1;
+		n++;
+	}
+	return n;
 }
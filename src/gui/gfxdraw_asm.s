@@ -0,0 +1,134 @@
+# 256boss - bootable launcher for 256byte intros
+# Copyright (C) 2018-2019  John Tsiombikas <nuclear@member.fsf.org>
+# 
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+# 
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY, without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	# vector fill and copy loops for gfxdraw.c, which only calls them after
+	# checking the cpuid feature bits.
+	.arch pentium4
+
+	.text
+	# void fill_mmx(void *dest, const void *pat, int nblk)
+	# stores nblk copies of the 48-byte pattern, dest must be 8-byte aligned
+	.global fill_mmx
+fill_mmx:
+	push %edi
+	mov 8(%esp), %edi
+	mov 12(%esp), %eax
+	mov 16(%esp), %ecx
+	movq (%eax), %mm0
+	movq 8(%eax), %mm1
+	movq 16(%eax), %mm2
+	movq 24(%eax), %mm3
+	movq 32(%eax), %mm4
+	movq 40(%eax), %mm5
+	test %ecx, %ecx
+	jz 1f
+0:	movq %mm0, (%edi)
+	movq %mm1, 8(%edi)
+	movq %mm2, 16(%edi)
+	movq %mm3, 24(%edi)
+	movq %mm4, 32(%edi)
+	movq %mm5, 40(%edi)
+	add $48, %edi
+	dec %ecx
+	jnz 0b
+1:	emms
+	pop %edi
+	ret
+
+	# void fill_sse2(void *dest, const void *pat, int nblk)
+	# same as fill_mmx, dest must be 16-byte aligned
+	.global fill_sse2
+fill_sse2:
+	push %edi
+	mov 8(%esp), %edi
+	mov 12(%esp), %eax
+	mov 16(%esp), %ecx
+	movdqu (%eax), %xmm0
+	movdqu 16(%eax), %xmm1
+	movdqu 32(%eax), %xmm2
+	test %ecx, %ecx
+	jz 1f
+0:	movdqa %xmm0, (%edi)
+	movdqa %xmm1, 16(%edi)
+	movdqa %xmm2, 32(%edi)
+	add $48, %edi
+	dec %ecx
+	jnz 0b
+1:	pop %edi
+	ret
+
+	# void copy_mmx(void *dest, const void *src, int nblk)
+	# copies nblk 64-byte blocks, dest must be 8-byte aligned
+	.global copy_mmx
+copy_mmx:
+	push %esi
+	push %edi
+	mov 12(%esp), %edi
+	mov 16(%esp), %esi
+	mov 20(%esp), %ecx
+	test %ecx, %ecx
+	jz 1f
+0:	movq (%esi), %mm0
+	movq 8(%esi), %mm1
+	movq 16(%esi), %mm2
+	movq 24(%esi), %mm3
+	movq 32(%esi), %mm4
+	movq 40(%esi), %mm5
+	movq 48(%esi), %mm6
+	movq 56(%esi), %mm7
+	movq %mm0, (%edi)
+	movq %mm1, 8(%edi)
+	movq %mm2, 16(%edi)
+	movq %mm3, 24(%edi)
+	movq %mm4, 32(%edi)
+	movq %mm5, 40(%edi)
+	movq %mm6, 48(%edi)
+	movq %mm7, 56(%edi)
+	add $64, %esi
+	add $64, %edi
+	dec %ecx
+	jnz 0b
+1:	emms
+	pop %edi
+	pop %esi
+	ret
+
+	# void copy_sse2(void *dest, const void *src, int nblk)
+	# same as copy_mmx, dest must be 16-byte aligned, src can be unaligned
+	.global copy_sse2
+copy_sse2:
+	push %esi
+	push %edi
+	mov 12(%esp), %edi
+	mov 16(%esp), %esi
+	mov 20(%esp), %ecx
+	test %ecx, %ecx
+	jz 1f
+0:	movdqu (%esi), %xmm0
+	movdqu 16(%esi), %xmm1
+	movdqu 32(%esi), %xmm2
+	movdqu 48(%esi), %xmm3
+	movdqa %xmm0, (%edi)
+	movdqa %xmm1, 16(%edi)
+	movdqa %xmm2, 32(%edi)
+	movdqa %xmm3, 48(%edi)
+	add $64, %esi
+	add $64, %edi
+	dec %ecx
+	jnz 0b
+1:	pop %edi
+	pop %esi
+	ret
@@ -29,13 +29,15 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "ui/fsview.h"
 
 #include "widget.h"
+#include "compose.h"
 
 static int video_init(void);
 static void draw(void);
-static int modecmp(const void *a, const void *b);
+static void redraw(struct gui_gfx *g);
 
 static struct video_mode vmode;
-static void *fbptr;
+static void *fbptr, *backbuf;
+static void *shadow;	/* everything is drawn in RAM, and dirty rects pushed to fbptr */
 
 static struct gui_gfx ggfx;
 static struct gui_widget win;
@@ -46,9 +48,20 @@ int gfxui(void)
 		return -1;
 	}
 
+	if(!(shadow = malloc(vmode.height * vmode.pitch))) {
+		printf("failed to allocate back buffer\n");
+		goto end;
+	}
+	/* push into an offscreen video memory page and flip if there's room */
+	if(!(backbuf = video_page(1))) {
+		backbuf = fbptr;
+	}
+
 	gui_setgfx(&ggfx);
-	gui_framebuffer(fbptr, vmode.width, vmode.height, vmode.width * vmode.bpp / 8);
-	gui_pixelformat(vmode.bpp, vmode.rbits, vmode.gbits, vmode.bbits);
+	gui_framebuffer(shadow, vmode.width, vmode.height, vmode.pitch);
+	gui_pixelformat(vmode.bpp, vmode.rbits, vmode.gbits, vmode.bbits, vmode.rshift,
+			vmode.gshift, vmode.bshift);
+	gui_comp_init(vmode.width, vmode.height);
 
 	gui_window(&win, 10, 10, 100, 100, "testwin", 0);
 
@@ -83,13 +96,22 @@ end:
 	set_vga_mode(3);
 	con_clear();
 	con_show_cursor(1);
+
+	if(shadow) {
+		struct gui_comp_stats *st = gui_comp_stats();
+		printf("gui: %lu frames, %lu pixels drawn, %lu pixels pushed (%lu per frame)\n",
+				st->frames, st->pixels_drawn, st->pixels_pushed,
+				st->frames ? st->pixels_pushed / st->frames : 0);
+		free(shadow);
+		shadow = 0;
+	}
 	return 0;
 }
 
 static int video_init(void)
 {
 	struct vbe_edid edid;
-	struct video_mode vinf, *vmodes;
+	struct video_mode vinf;
 	int i, xres, yres, nmodes, mode_idx = -1;
 	const char *vendor;
 	struct cfglist *cfg;
@@ -116,35 +138,26 @@ static int video_init(void)
 		mode_idx = find_video_mode_idx(xres, yres, 0);
 	}
 
-	nmodes = video_mode_count();
-	if(!(vmodes = malloc(nmodes * sizeof *vmodes))) {
-		printf("failed to allocate video modes array (%d modes)\n", nmodes);
-		return -1;
-	}
-
-	for(i=0; i<nmodes; i++) {
-		video_mode_info(i, &vinf);
-		vmodes[i] = vinf;
-	}
-
 	if(mode_idx >= 0) {
-		if(!(fbptr = set_video_mode(vmodes[mode_idx].mode))) {
+		video_mode_info(mode_idx, &vinf);
+		if(!(fbptr = set_video_mode(vinf.mode))) {
 			printf("failed to set video mode: %x (%dx%d %dbpp)\n", mode_idx,
-					vmodes[mode_idx].width, vmodes[mode_idx].height, vmodes[mode_idx].bpp);
+					vinf.width, vinf.height, vinf.bpp);
 			mode_idx = -1;
 		} else {
-			vmode = vmodes[mode_idx];
+			vmode = vinf;
 			printf("video mode: %x (%dx%d %dbpp)\n", vmode.mode, vmode.width,
 					vmode.height, vmode.bpp);
 		}
 	}
 
 	if(mode_idx == -1) {
-		qsort(vmodes, nmodes, sizeof *vmodes, modecmp);
-
+		/* the mode table is sorted largest first, try them in order */
+		nmodes = video_mode_count();
 		for(i=0; i<nmodes; i++) {
-			if((fbptr = set_video_mode(vmodes[i].mode))) {
-				vmode = vmodes[i];
+			video_mode_info(i, &vinf);
+			if((fbptr = set_video_mode(vinf.mode))) {
+				vmode = vinf;
 				printf("video mode: %x (%dx%d %dbpp)\n", vmode.mode, vmode.width,
 						vmode.height, vmode.bpp);
 				break;
@@ -155,28 +168,37 @@ static int video_init(void)
 			return -1;
 		}
 	}
-	free(vmodes);
 
 	return 0;
 }
 
 static void draw(void)
 {
-	wait_vsync();
-	memset(fbptr, 0x80, vmode.width * vmode.height * vmode.bpp / 8);
+	int npages;
+
+	if(!gui_comp_pending()) {
+		return;	/* nothing changed */
+	}
 
-	win.draw(&ggfx, &win);
+	if((npages = video_page_count()) < 2) {
+		wait_vsync();
+		gui_compose(&ggfx, redraw, fbptr, 1);
+	} else {
+		/* the back page was last updated npages frames ago */
+		gui_compose(&ggfx, redraw, backbuf, npages);
+		backbuf = page_flip(1);
+
+		if(video_page_count() < 2) {
+			/* flipping failed, from now on we push to the front page */
+			gui_dirty(0, 0, vmode.width, vmode.height);
+		}
+	}
 }
 
-static int modecmp(const void *a, const void *b)
+static void redraw(struct gui_gfx *g)
 {
-	const struct video_mode *ma = a;
-	const struct video_mode *mb = b;
-	unsigned long aval = ma->width | (ma->height << 16);
-	unsigned long bval = mb->width | (mb->height << 16);
+	g->color = 0x808080;
+	g->draw.rect(g, 0, 0, g->fb.width, g->fb.height);
 
-	if(aval != bval) {
-		return bval - aval;
-	}
-	return mb->bpp - ma->bpp;
+	win.draw(g, &win);
 }
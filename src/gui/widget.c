@@ -17,6 +17,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 #include <string.h>
 #include "widget.h"
+#include "compose.h"
 
 static void draw_window(struct gui_gfx *g, struct gui_widget *w);
 
@@ -35,9 +36,16 @@ int gui_window(struct gui_widget *w, int x, int y, int width, int height, const
 	w->height = height;
 
 	w->draw = draw_window;
+
+	gui_invalidate(w);
 	return 0;
 }
 
+void gui_invalidate(struct gui_widget *w)
+{
+	gui_dirty(w->x, w->y, w->width, w->height);
+}
+
 static void draw_window(struct gui_gfx *g, struct gui_widget *w)
 {
 	g->color = 0xff0000;
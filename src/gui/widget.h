@@ -51,6 +51,9 @@ struct gui_widget {
 	gui_draw_func draw;
 };
 
+/* marks the area covered by the widget for redrawing */
+void gui_invalidate(struct gui_widget *w);
+
 int gui_window(struct gui_widget *w, int x, int y, int width, int height, const char *name, struct gui_widget *parent);
 
 #endif	/* WIDGET_H_ */
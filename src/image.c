@@ -22,6 +22,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <assert.h>
 #include <png.h>
 #include "image.h"
+#include "imgcache.h"
 
 int alloc_image(struct image *img, int x, int y, int bpp)
 {
@@ -52,15 +53,105 @@ int alloc_image(struct image *img, int x, int y, int bpp)
 
 int load_image(struct image *img, const char *fname)
 {
-	int i;
+	struct img_loader ld;
+
+	if(load_image_begin(&ld, img, fname) == -1) {
+		return -1;
+	}
+	if(load_image_rows(&ld, ld.nrows) == -1) {
+		free(img->pixels);
+		img->pixels = 0;
+		return -1;
+	}
+	return 0;
+}
+
+int load_image_cache(struct image *img, const char *fname, const char *srcname, int col_offs)
+{
+	FILE *fp;
+	long size, pixsz, cmapsz;
+	unsigned char *buf;
+	struct imgcache_header hdr;
+
+	img->pixels = 0;
+
+	if(!(fp = fopen(fname, "rb"))) {
+		return -1;
+	}
+	size = filesize(fp);
+	if(size < (long)sizeof hdr || !(buf = malloc(size))) {
+		fclose(fp);
+		return -1;
+	}
+	if(fread(buf, 1, size, fp) != size) {
+		printf("load_image_cache: %s: read failed\n", fname);
+		goto err;
+	}
+	fclose(fp);
+	fp = 0;
+
+	memcpy(&hdr, buf, sizeof hdr);
+	cmapsz = hdr.cmap_ncolors * sizeof *img->cmap;
+	pixsz = (long)hdr.height * hdr.pitch;
+	if(memcmp(hdr.magic, IMGCACHE_MAGIC, 4) != 0 || hdr.cmap_ncolors > 256 ||
+			sizeof hdr + cmapsz + pixsz > size) {
+		printf("load_image_cache: %s: invalid image cache\n", fname);
+		goto err;
+	}
+	if(hdr.col_offs != col_offs) {
+		printf("load_image_cache: %s: color offset %d, expected %d\n", fname,
+				hdr.col_offs, col_offs);
+		goto err;
+	}
+
+	/* stale if the PNG next to it has changed since it was generated. The
+	 * Makefile regenerates the cache whenever the PNG changes, so this only
+	 * catches a PNG replaced on the boot media, with a size check and a
+	 * 4 byte read instead of reading the whole PNG.
+	 */
+	if(srcname && (fp = fopen(srcname, "rb"))) {
+		unsigned char stamp[IMGCACHE_STAMP_SIZE];
+		long srcsz = filesize(fp);
+		if(srcsz != hdr.src_size || srcsz < 16 ||
+				fseek(fp, IMGCACHE_STAMP_OFFS(srcsz), SEEK_SET) == -1 ||
+				fread(stamp, 1, sizeof stamp, fp) != sizeof stamp ||
+				memcmp(stamp, hdr.src_stamp, sizeof stamp) != 0) {
+			printf("load_image_cache: %s: stale, %s has changed\n", fname, srcname);
+			goto err;
+		}
+		fclose(fp);
+	}
+
+	img->width = hdr.width;
+	img->height = hdr.height;
+	img->bpp = hdr.bpp;
+	img->nchan = hdr.nchan;
+	img->scansz = img->pitch = hdr.pitch;
+	img->cmap_ncolors = hdr.cmap_ncolors;
+	memcpy(img->cmap, buf + sizeof hdr, cmapsz);
+
+	/* keep the pixels in the buffer the file was read into */
+	memmove(buf, buf + sizeof hdr + cmapsz, pixsz);
+	img->pixels = buf;
+	return 0;
+
+err:
+	if(fp) fclose(fp);
+	free(buf);
+	return -1;
+}
+
+int load_image_begin(struct img_loader *ld, struct image *img, const char *fname)
+{
 	FILE *fp;
 	png_struct *png;
 	png_info *info;
-	int chan_bits, color_type;
+	int chan_bits, color_type, npass;
 	png_uint_32 xsz, ysz;
 	png_color *palette;
-	unsigned char **scanline;
-	unsigned char *dptr;
+
+	memset(ld, 0, sizeof *ld);
+	img->pixels = 0;
 
 	if(!(fp = fopen(fname, "rb"))) {
 		printf("failed to open: %s: %s\n", fname, strerror(errno));
@@ -83,7 +174,8 @@ int load_image(struct image *img, const char *fname)
 	}
 
 	png_init_io(png, fp);
-	png_read_png(png, info, 0, 0);
+	png_read_info(png, info);
+	npass = png_set_interlace_handling(png);
 
 	png_get_IHDR(png, info, &xsz, &ysz, &chan_bits, &color_type, 0, 0, 0);
 	img->width = xsz;
@@ -104,19 +196,60 @@ int load_image(struct image *img, const char *fname)
 		png_destroy_read_struct(&png, &info, 0);
 		return -1;
 	}
-	dptr = img->pixels;
+	/* interlaced passes refine rows in place, start from a known state */
+	if(npass > 1) {
+		memset(img->pixels, 0, ysz * img->scansz);
+	}
+
+	ld->img = img;
+	ld->fp = fp;
+	ld->png = png;
+	ld->info = info;
+	ld->nrows = ysz * npass;
+	return 0;
+}
+
+/* decodes up to count more rows. returns 1 when the image is complete, 0 if
+ * there are rows left, and -1 on failure. Both 1 and -1 release the decoder,
+ * but on failure the partially decoded pixels are left for the caller to free.
+ */
+int load_image_rows(struct img_loader *ld, int count)
+{
+	png_struct *png = ld->png;
+	struct image *img = ld->img;
 
-	scanline = (unsigned char**)png_get_rows(png, info);
-	for(i=0; i<ysz; i++) {
-		memcpy(dptr, scanline[i], img->scansz);
-		dptr += img->pitch;
+	if(!png) return -1;
+
+	if(setjmp(png_jmpbuf(png))) {
+		load_image_end(ld);
+		return -1;
 	}
 
-	fclose(fp);
-	png_destroy_read_struct(&png, &info, 0);
+	while(count-- > 0 && ld->row < ld->nrows) {
+		png_read_row(png, img->pixels + (ld->row % img->height) * img->pitch, 0);
+		ld->row++;
+	}
+
+	if(ld->row >= ld->nrows) {
+		load_image_end(ld);
+		return 1;
+	}
 	return 0;
 }
 
+void load_image_end(struct img_loader *ld)
+{
+	png_struct *png = ld->png;
+	png_info *info = ld->info;
+
+	if(png) {
+		fclose(ld->fp);
+		png_destroy_read_struct(&png, &info, 0);
+		ld->png = ld->info = 0;
+		ld->fp = 0;
+	}
+}
+
 /*
 int save_image(struct image *img, const char *fname)
 {
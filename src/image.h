@@ -32,8 +32,28 @@ struct image {
 	unsigned char *pixels;
 };
 
+/* state of an incremental image load, see load_image_begin */
+struct img_loader {
+	struct image *img;
+	void *fp, *png, *info;
+	int row, nrows;
+};
+
 int alloc_image(struct image *img, int x, int y, int bpp);
 int load_image(struct image *img, const char *fname);
+/* loads an image pre-decoded by tools/imgcache (see imgcache.h) in one read.
+ * Fails if col_offs doesn't match the offset it was generated with, or if
+ * srcname (the PNG, may be null) exists and doesn't match the one it came from.
+ */
+int load_image_cache(struct image *img, const char *fname, const char *srcname, int col_offs);
+/* load_image split into steps, to interleave decoding with other work.
+ * load_image_begin reads the header and allocates img->pixels, then each
+ * load_image_rows call decodes up to count rows (1: done, 0: more, -1: error).
+ * load_image_end aborts an unfinished load, leaving img->pixels to the caller.
+ */
+int load_image_begin(struct img_loader *ld, struct image *img, const char *fname);
+int load_image_rows(struct img_loader *ld, int count);
+void load_image_end(struct img_loader *ld);
 int save_image(struct image *img, const char *fname);
 
 int cmp_image(struct image *a, struct image *b);
@@ -0,0 +1,45 @@
+/*
+256boss - bootable launcher for 256byte intros
+Copyright (C) 2018-2020  John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY, without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef IMGCACHE_H_
+#define IMGCACHE_H_
+
+#include <inttypes.h>
+
+/* the stamp is the CRC of the last chunk before IEND, as stored in the PNG:
+ * a 4 byte read from the end of the file, that changes with the image data.
+ */
+#define IMGCACHE_STAMP_SIZE		4
+#define IMGCACHE_STAMP_OFFS(sz)	((sz) - 16)
+
+/* Pre-decoded image file written by tools/imgcache, to skip PNG decoding at
+ * boot: the header, followed by cmap_ncolors RGB palette entries and height *
+ * pitch bytes of pixels. All fields are little-endian.
+ */
+struct imgcache_header {
+	char magic[4];			/* IMGCACHE_MAGIC */
+	uint16_t width, height, pitch;
+	uint8_t bpp, nchan;
+	uint16_t cmap_ncolors;
+	uint16_t col_offs;		/* already added to the pixel values */
+	uint32_t src_size;		/* size of the PNG it came from */
+	unsigned char src_stamp[IMGCACHE_STAMP_SIZE];
+} __attribute__((packed));
+
+#define IMGCACHE_MAGIC	"RIMG"
+
+#endif	/* IMGCACHE_H_ */
@@ -40,6 +40,11 @@ struct int86regs {
 #define FLAGS_GIOPL(x)	(((x) >> 12) & 3)
 #define FLAGS_NTASK		0x4000
 
+/* runs the BIOS call in virtual 8086 mode if possible (see v86.c), falling
+ * back to int86_rm otherwise.
+ */
 void int86(int inum, struct int86regs *regs);
+/* drops back to real mode to call the interrupt handler (lowcode.s) */
+void int86_rm(int inum, struct int86regs *regs);
 
 #endif	/* INT86_H_ */
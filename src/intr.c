@@ -22,6 +22,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "segm.h"
 #include "asmops.h"
 #include "panic.h"
+#include "v86.h"
 
 #define SYSCALL_INT		0x80
 
@@ -137,6 +138,18 @@ void dispatch_intr(struct intr_frame frm)
 
 	if(intr_func[frm.inum]) {
 		intr_func[frm.inum](frm.inum);
+
+		if(frm.inum == IRQ_TO_INTR(0) && (frm.eflags & EFLAGS_VM) &&
+				v86_timer_tick(&frm)) {
+			eoi_pending = 0;
+		}
+	} else if(frm.eflags & EFLAGS_VM) {
+		/* interrupted a BIOS call running in virtual 8086 mode, let the
+		 * monitor emulate the faulting instruction or reflect the IRQ to the
+		 * real mode handler, which will send its own EOI.
+		 */
+		eoi_pending = 0;
+		v86_intr(&frm);
 	} else {
 		if(frm.inum < 32) {
 			panic("unhandled exception %d, error code: %d\n", frm.inum, frm.err);
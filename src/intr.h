@@ -41,18 +41,15 @@ struct registers {
 struct intr_frame {
 	/* registers pushed by pusha in intr_entry_* */
 	struct registers regs;
-	/* data segment selectors */
-	/* XXX removed: not needed unless we do dpl3 transitions
+	/* data segment selectors (null when interrupting virtual 8086 code) */
 	uint32_t ds, es, fs, gs;
-	*/
 	/* interrupt number and error code pushed in intr_entry_* */
 	uint32_t inum, err;
 	/* pushed by CPU during interrupt entry */
 	uint32_t eip, cs, eflags;
-	/* pushed by CPU during interrupt entry from user space */
-	/* XXX removed: again, not doing user space currently
-	uint32_t esp, ss;
-	*/
+	/* when interrupting virtual 8086 code, the CPU also pushes esp, ss, es,
+	 * ds, fs, and gs after eflags. See struct v86_segm in v86.c
+	 */
 } __attribute__ ((packed));
 
 
@@ -20,9 +20,12 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <ctype.h>
 #include <assert.h>
 #include <unistd.h>
+#include <dirent.h>
 #include "config.h"
 #include "segm.h"
 #include "intr.h"
+#include "v86.h"
+#include "cpu.h"
 #include "mem.h"
 #include "keyb.h"
 #include "psaux.h"
@@ -36,8 +39,12 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "floppy.h"
 #include "part.h"
 #include "fs.h"
+#include "fscopy.h"
+#include "cfgfile.h"
+#include "datapath.h"
 #include "kbregs.h"
 #include "shell.h"
+#include "fbcon.h"
 #include "ui/fsview.h"
 #include "tui/textui.h"
 
@@ -49,12 +56,15 @@ void set_debug_traps(void);
 void splash_screen(void);
 
 static void mount_boot_fs(void);
+static void copy_boot_fs_to_ram(void);
+static void start_fbcon(void);
 static void print_intr_state(void);
 
 void kmain(void)
 {
 	init_segm();
 	init_intr();
+	init_v86();
 
 #ifdef ENABLE_GDB_STUB
 	if(ser_open(GDB_SERIAL_PORT, 9600, SER_8N1) >= 0) {
@@ -69,6 +79,8 @@ void kmain(void)
 
 	init_mem();
 
+	init_cpu();
+
 	/*init_pci();*/
 
 	/* initialize the timer */
@@ -82,13 +94,18 @@ void kmain(void)
 	bdev_init();
 
 	mount_boot_fs();
-
-	fsv_init(&fsview);
+	start_fbcon();
+	copy_boot_fs_to_ram();
 
 #ifdef AUTOSTART_GUI
 	if(!kb_isdown(KB_F8)) {
+		/* scans the root directory for fsview while the animation runs */
 		splash_screen();
+	} else {
+		fsv_init(&fsview);
 	}
+#else
+	fsv_init(&fsview);
 #endif
 
 	/* debug shell. we end up here if we hold down F8 during startup */
@@ -146,7 +163,8 @@ static int sane_fsname(const char *name)
 
 static void mount_boot_fs(void)
 {
-	int i, npart;
+	int i, npart, nmounted = 0, deferred = 0;
+	unsigned long start;
 	struct partition ptab[32];
 	char name[64];
 	struct filesys *fs;
@@ -160,6 +178,7 @@ static void mount_boot_fs(void)
 
 	print_partition_table(ptab, npart);
 
+	start = nticks;
 	for(i=0; i<npart; i++) {
 		sprintf(name, "/partition%d", i + 1);
 		mkdir(name, 0777);
@@ -172,12 +191,79 @@ static void mount_boot_fs(void)
 				fs_rename(fsn, fs->name);
 			}
 			fs_close(fsn);
+			nmounted++;
+			deferred += fs->deferred;
 
 		} else {
 			fs_close(fsn);
 			rmdir(name);
 		}
 	}
+
+	printf("probed %d filesystems in %ld ms, deferred reading %d sectors (%d kb) until first access\n",
+			nmounted, TICKS_TO_MSEC(nticks - start), deferred, deferred / 2);
+}
+
+/* with F7 held down during boot, or copytoram = 1 in the config file, all
+ * mounted partitions are copied to RAM, so the boot medium can be removed
+ */
+static void copy_boot_fs_to_ram(void)
+{
+	int copy;
+	DIR *dir;
+	struct dirent *dent;
+	struct cfglist *cfg;
+	char path[sizeof dent->d_name + 1];
+
+	if(!(copy = kb_isdown(KB_F7))) {
+		if(init_datapath() != -1 && (cfg = load_cfglist(datafile("256boss.cfg")))) {
+			copy = cfg_getint(cfg, "copytoram", 0);
+			free_cfglist(cfg);
+		}
+	}
+	if(!copy || !(dir = opendir("/"))) {
+		return;
+	}
+
+	while((dent = readdir(dir))) {
+		if(dent->d_type != DT_DIR || dent->d_name[0] == '.') {
+			continue;
+		}
+		sprintf(path, "/%s", dent->d_name);
+		fs_copy_to_ram(path);
+	}
+	closedir(dir);
+}
+
+/* with F6 held down during boot, or fbcon = WxH[xBPP] in the config file, the
+ * console switches to the graphics mode framebuffer console as soon as the
+ * config file is readable. The splash screen replaces it with its own video
+ * mode, so this is mostly useful together with F8.
+ */
+static void start_fbcon(void)
+{
+	int xsz = 1024, ysz = 768, bpp = 0;
+	const char *mode = 0;
+	struct cfglist *cfg = 0;
+
+	if(!kb_isdown(KB_F6)) {
+		if(init_datapath() == -1 || !(cfg = load_cfglist(datafile("256boss.cfg"))) ||
+				!(mode = cfg_getstr(cfg, "fbcon", 0))) {
+			free_cfglist(cfg);
+			return;
+		}
+		if(fbcon_parse_mode(mode, &xsz, &ysz, &bpp) == -1) {
+			printf("invalid fbcon mode in the config file: %s\n", mode);
+			free_cfglist(cfg);
+			return;
+		}
+		free_cfglist(cfg);
+	}
+
+	if(fbcon_init(xsz, ysz, bpp) == -1) {
+		set_vga_mode(3);
+		printf("failed to start the graphics console\n");
+	}
 }
 
 static void print_intr_state(void)
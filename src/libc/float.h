@@ -20,5 +20,7 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #define FLT_MIN	__FLT_MIN__
 #define FLT_MAX	__FLT_MAX__
+#define DBL_MIN	__DBL_MIN__
+#define DBL_MAX	__DBL_MAX__
 
 #endif	/* FLOAT_H_ */
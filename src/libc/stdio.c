@@ -45,9 +45,7 @@ int putchar(int c)
 
 int puts(const char *s)
 {
-	while(*s) {
-		putchar(*s++);
-	}
+	con_write(s, strlen(s));
 	putchar('\n');
 	return 0;
 }
@@ -336,6 +334,9 @@ static int intern_printf(int out, char *buf, size_t sz, const char *fmt, va_list
 		}
 	}
 
+	if(out == OUT_DEF) {
+		con_flush();
+	}
 	return cnum;
 }
 
@@ -366,9 +367,7 @@ static void bwrite(int out, char *buf, size_t buf_sz, char *str, int sz)
 	} else {
 		switch(out) {
 		case OUT_DEF:
-			for(i=0; i<sz; i++) {
-				putchar(*str++);
-			}
+			con_write(str, sz);
 			break;
 
 		case OUT_SER:
@@ -18,6 +18,7 @@
 
 	.code32
 	.align 4
+int86_state:
 	# place to save the protected mode IDTR pseudo-descriptor
 	# with sidt, so that it can be restored before returning
 	.short 0
@@ -38,10 +39,11 @@ saved_flags: .word 0
 saved_if: .byte 0
 saved_pic1_mask: .byte 0
 saved_pic2_mask: .byte 0
+int86_state_end:
 
 	# drop back to unreal mode to call 16bit interrupt
-	.global int86
-int86:
+	.global int86_rm
+int86_rm:
 	push %ebp
 	mov %esp, %ebp
 	pushal
@@ -194,12 +196,12 @@ int_op:	int $0
 
 
 	# interrupt handler called from int86 to start execution of a COM file
-	# already loaded in the low memory buffer at offset 256
+	# already loaded at offset 256 of com_mem_base
 	.code16
 	.global run_com_entry
 run_com_entry:
-	mov $low_mem_buffer, %dx
-	shr $4, %dx
+	mov $com_mem_base, %edx
+	shr $4, %edx
 
 	# modify the ljmp instruction to jump to the correct CS
 	mov $ljmpop, %bx
@@ -256,6 +258,17 @@ rm_keyb_intr:
 	cli
 	in $0x60, %al
 	mov %al, %bl
+	# remember when the first key was pressed, for the run statistics
+	test $0x80, %bl
+	jnz 1f
+	cmpl $0, %cs:rm_stat_key
+	jnz 1f
+	push %eax
+	mov %cs:rm_timer_ticks, %eax
+	inc %eax
+	mov %eax, %cs:rm_stat_key
+	pop %eax
+1:
 	# send EOI and jump to the return code if ESC was pressed
 	mov $0x20, %al
 	outb %al, $0x20
@@ -263,3 +276,217 @@ rm_keyb_intr:
 	jnz 0f
 	ljmp $0,$run_com_return
 0:	iret
+
+	# timer interrupt handler installed while a COM file runs. Chains to the
+	# previous handler (which sends the EOI), counts ticks, and jumps to the
+	# return code if the time limit (in ticks, 0 for none) expires
+	.global rm_timer_intr
+rm_timer_intr:
+	pushf
+	lcall *%cs:rm_timer_orig
+	incl %cs:rm_timer_ticks
+	# CPU speed governor: burn part of every tick in a busy loop, the same
+	# one as cpu_spin (cpu_asm.s), rm_timer_stall iterations long
+	push %ecx
+	mov %cs:rm_timer_stall, %ecx
+	test %ecx, %ecx
+	jz 1f
+	.p2align 4
+2:	dec %ecx
+	jnz 2b
+1:	pop %ecx
+	# run statistics: count vertical retraces caught at tick time, and video
+	# mode changes seen in the BIOS data area. Reading 3DAh resets the
+	# attribute controller flip-flop under the program's feet, so retraces are
+	# only sampled when asked for (rm_stat_vrsamp)
+	push %eax
+	push %dx
+	cmpb $0, %cs:rm_stat_vrsamp
+	jz 1f
+	mov $0x3da, %dx
+	in %dx, %al
+	and $8, %al
+	cmp %cs:rm_stat_vr, %al
+	mov %al, %cs:rm_stat_vr
+	jz 1f
+	test %al, %al
+	jz 1f
+	incl %cs:rm_stat_retraces
+1:	mov %cs:0x449, %al
+	cmp %cs:rm_stat_mode, %al
+	jz 1f
+	mov %al, %cs:rm_stat_mode
+	incl %cs:rm_stat_modechg
+1:	pop %dx
+
+	mov %cs:rm_timer_limit, %eax
+	test %eax, %eax
+	jz 0f
+	cmp %cs:rm_timer_ticks, %eax
+	ja 0f
+	pop %eax
+	cli
+	movb $1, %cs:rm_timer_expired
+	ljmp $0,$run_com_return
+0:	pop %eax
+	iret
+
+	.global rm_timer_orig
+rm_timer_orig: .long 0
+	.global rm_timer_ticks
+rm_timer_ticks: .long 0
+	.global rm_timer_limit
+rm_timer_limit: .long 0
+	.global rm_timer_stall
+rm_timer_stall: .long 0
+	.global rm_timer_expired
+rm_timer_expired: .byte 0
+
+	.global rm_stat_retraces
+rm_stat_retraces: .long 0
+	.global rm_stat_modechg
+rm_stat_modechg: .long 0
+	# rm_timer_ticks + 1 at the first key press, 0 if there was none
+	.global rm_stat_key
+rm_stat_key: .long 0
+	.global rm_stat_vr
+rm_stat_vr: .byte 0
+	.global rm_stat_vrsamp
+rm_stat_vrsamp: .byte 0
+	.global rm_stat_mode
+rm_stat_mode: .byte 0
+
+	# DOS services which need the kernel (see dosserv.c) end up here from
+	# dos_int21h_entry. Save the caller's registers, switch back to protected
+	# mode to call dos_syscall, then return to real mode and to the caller,
+	# with the carry flag in the interrupt frame set on error.
+	.set DOS_RMSTACK_SAVE, 16
+	.global dos_pmcall
+dos_pmcall:
+	cli
+	mov %ss, %cs:dos_ss
+	mov %esp, %cs:dos_esp
+	push %cs
+	pop %ss
+	# fill the int86regs structure at dos_regs with push/pusha
+	mov $dos_regs_end, %esp
+	push %gs
+	push %fs
+	push %ds
+	push %es
+	pushfw
+	pushal
+	# keep the real mode PIC masks, pmode interrupts are about to change them
+	in $0x21, %al
+	mov %al, %cs:dos_pic1_mask
+	in $0xa1, %al
+	mov %al, %cs:dos_pic2_mask
+
+	# enable protection
+	mov %cr0, %eax
+	or $1, %ax
+	mov %eax, %cr0
+	# long jump to load code selector for 32bit code (1)
+	ljmp $0x8,$0f
+0:
+	.code32
+	mov $0x10, %ax
+	mov %ax, %ds
+	mov %ax, %es
+	mov %ax, %ss
+	mov %ax, %fs
+	mov %ax, %gs
+	nop
+	cld
+
+	# continue on the kernel stack, below the int86_rm frame of the COM run
+	mov saved_esp, %esp
+
+	# BIOS calls made while serving the request drop back to real mode with
+	# int86_rm, which overwrites its saved state, and the stack at 0x7be0
+	# which holds the interrupt frame of the COM run. Keep copies of both.
+	mov $int86_state, %esi
+	mov $dos_state, %edi
+	mov $int86_state_end - int86_state, %ecx
+	rep movsb
+	mov $0x7be0 - DOS_RMSTACK_SAVE, %esi
+	mov $DOS_RMSTACK_SAVE, %ecx
+	rep movsb
+
+	lidt (saved_idtr)
+	call init_pic
+	movzbl saved_pic1_mask, %eax
+	push %eax
+	pushl $0
+	call set_pic_mask
+	add $8, %esp
+	movzbl saved_pic2_mask, %eax
+	push %eax
+	pushl $1
+	call set_pic_mask
+	add $8, %esp
+
+	pushl $dos_regs
+	call dos_syscall
+	add $4, %esp
+
+	cli
+	mov $dos_state, %esi
+	mov $int86_state, %edi
+	mov $int86_state_end - int86_state, %ecx
+	rep movsb
+	mov $0x7be0 - DOS_RMSTACK_SAVE, %edi
+	mov $DOS_RMSTACK_SAVE, %ecx
+	rep movsb
+
+	# back to the real mode IVT and PIC mapping used by the COM program
+	lidt (rmidt)
+	pushl $8
+	call prog_pic
+	add $4, %esp
+	mov dos_pic1_mask, %al
+	out %al, $0x21
+	mov dos_pic2_mask, %al
+	out %al, $0xa1
+
+	# long jump to load code selector for 16bit code (6)
+	ljmp $0x30,$0f
+0:
+	.code16
+	# disable protection
+	mov %cr0, %eax
+	and $0xfffe, %ax
+	mov %eax, %cr0
+	ljmp $0,$0f
+0:	xor %ax, %ax
+	mov %ax, %ss
+	mov $dos_regs, %esp
+	popal
+	popfw
+	pop %es
+	pop %ds
+	pop %fs
+	pop %gs
+	mov %cs:dos_ss, %ss
+	mov %cs:dos_esp, %esp
+
+	# popfw left the carry flag of the result in place, pass it on through
+	# the flags of the interrupt frame
+	push %bp
+	mov %sp, %bp
+	jc 0f
+	andw $0xfffe, 6(%bp)
+	pop %bp
+	iret
+0:	orw $1, 6(%bp)
+	pop %bp
+	iret
+
+	.align 4
+dos_regs: .fill 42
+dos_regs_end:
+dos_esp: .long 0
+dos_ss: .short 0
+dos_pic1_mask: .byte 0
+dos_pic2_mask: .byte 0
+dos_state: .fill int86_state_end - int86_state + DOS_RMSTACK_SAVE
@@ -31,8 +31,16 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "comloader.h"
 #include "video.h"
 #include "tui/textui.h"
+#include "tui/playlist.h"
+#include "datapath.h"
 #include "power.h"
 #include "vbe.h"
+#include "v86.h"
+#include "speedgov.h"
+#include "timer.h"
+#include "gui/gfx.h"
+#include "splash/psys.h"
+#include "fbcon.h"
 
 static void print_prompt(void);
 
@@ -49,10 +57,17 @@ static int cmd_cat(int argc, char **argv);
 static int cmd_echo(int argc, char **argv);
 
 static int cmd_run(int argc, char **argv);
+static int cmd_playlist(int argc, char **argv);
 
 static int cmd_reboot(int argc, char **argv);
 static int cmd_memdbg(int argc, char **argv);
 static int cmd_vbe(int argc, char **argv);
+static int bench_flip(long msec);
+static int cmd_v86(int argc, char **argv);
+static int cmd_cpuspeed(int argc, char **argv);
+static int cmd_gfxbench(int argc, char **argv);
+static int cmd_psysbench(int argc, char **argv);
+static int cmd_fbcon(int argc, char **argv);
 
 #define INBUF_SIZE		256
 
@@ -114,9 +129,15 @@ static struct {
 	{"echo", cmd_echo},
 	{"clear", cmd_clear},
 	{"run", cmd_run},
+	{"playlist", cmd_playlist},
 	{"reboot", cmd_reboot},
 	{"memdbg", cmd_memdbg},
 	{"vbe", cmd_vbe},
+	{"v86", cmd_v86},
+	{"cpuspeed", cmd_cpuspeed},
+	{"gfxbench", cmd_gfxbench},
+	{"psysbench", cmd_psysbench},
+	{"fbcon", cmd_fbcon},
 	{"help", cmd_help},
 	{0, 0}
 };
@@ -402,6 +423,15 @@ static int cmd_echo(int argc, char **argv)
 
 static int cmd_run(int argc, char **argv)
 {
+	int res;
+
+	/* -vr also counts vertical retraces in the run statistics */
+	com_sample_retraces = argc > 1 && strcmp(argv[1], "-vr") == 0;
+	if(com_sample_retraces) {
+		argc--;
+		argv++;
+	}
+
 	if(argc < 2) {
 		printf("run what?\n");
 		return -1;
@@ -411,15 +441,30 @@ static int cmd_run(int argc, char **argv)
 		return -1;
 	}
 
-	if(run_com_binary() == -1) {
+	res = run_com_binary();
+	com_sample_retraces = 0;
+	if(res == -1) {
 		return -1;
 	}
 
 	set_vga_mode(3);
 	con_clear();
+	com_print_stats();
 	return 0;
 }
 
+static int cmd_playlist(int argc, char **argv)
+{
+	int res;
+
+	res = playlist_run(argc > 1 ? argv[1] : datafile(PLAYLIST_FILE));
+
+	set_vga_mode(3);
+	con_scr_enable();
+	con_clear();
+	return res;
+}
+
 static int cmd_reboot(int argc, char **argv)
 {
 	reboot();
@@ -439,6 +484,58 @@ static int cmd_memdbg(int argc, char **argv)
 	return 0;
 }
 
+/* flip pages in a 640x480 mode for msec milliseconds with vsync, and again
+ * without, drawing a small strip each frame so that flips are visible.
+ */
+static int bench_flip(long msec)
+{
+	int i, idx, npages, pmif;
+	long count[2];
+	unsigned long start, end;
+	struct video_mode vm;
+	void *fb;
+
+	if((idx = find_video_mode_idx(640, 480, 8)) == -1 &&
+			(idx = find_video_mode_idx(640, 480, 0)) == -1) {
+		return -1;
+	}
+	video_mode_info(idx, &vm);
+	if(!set_video_mode(vm.mode)) {
+		return -1;
+	}
+	con_scr_disable();
+
+	npages = video_page_count();
+	pmif = video_pmif_active();
+
+	for(i=0; i<2; i++) {
+		fb = video_page(npages > 1 ? 1 : 0);
+		count[i] = 0;
+
+		start = nticks;
+		while(nticks == start);
+		end = nticks + MSEC_TO_TICKS(msec);
+
+		while(nticks < end) {
+			memset(fb, count[i] & 0xff, vm.pitch * 16);
+			fb = page_flip(i == 0);
+			count[i]++;
+		}
+	}
+
+	con_scr_enable();
+	set_vga_mode(3);
+	con_clear();
+
+	printf("%dx%d %dbpp, %d pages, flipping with %s\n", vm.width, vm.height, vm.bpp,
+			npages, pmif ? "the protected mode interface" : "int86");
+	for(i=0; i<2; i++) {
+		printf("%s: %ld flips in %ld ms (%ld flips/sec)\n", i == 0 ? "vsync" : "no vsync",
+				count[i], msec, count[i] * 1000 / msec);
+	}
+	return 0;
+}
+
 static int cmd_vbe(int argc, char **argv)
 {
 	if(strcmp(argv[1], "edid") == 0) {
@@ -449,10 +546,262 @@ static int cmd_vbe(int argc, char **argv)
 		}
 		print_edid(&edid);
 
+	} else if(strcmp(argv[1], "flip") == 0) {
+		long msec = argc > 2 ? atoi(argv[2]) : 1000;
+
+		if(msec <= 0 || msec > 5000) {
+			printf("invalid benchmark duration: %s\n", argv[2]);
+			return -1;
+		}
+		return bench_flip(msec);
+
 	} else {
 		printf("usage: %s <subcmd>\n", argv[0]);
 		printf("Subcommands:\n");
 		printf(" edid: print monitor EDID information if available\n");
+		printf(" flip [msec]: measure the page flip rate with and without vsync\n");
+		printf(" help: print subcommand help\n");
+		if(strcmp(argv[1], "help") != 0) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+enum { GB_CLEAR, GB_RECT, GB_HLINE, GB_BLIT, GB_CONV8, GB_CONV32, GB_NUM_TESTS };
+static const char *gb_test_name[] = {"clear", "rect", "hline", "blit", "conv8", "conv32"};
+static const char *gb_simd_name[] = {"scalar", "mmx", "sse2"};
+
+#define GB_IMG_SIZE		128
+
+/* run one of the gfxdraw tests for msec milliseconds, returns pixels drawn */
+static unsigned long bench_gfx_test(struct gui_gfx *g, int test, struct gui_image *img,
+		struct gui_image *img8, struct gui_image *img32, uint32_t *cmap, long msec)
+{
+	int x = 0, y = 0;
+	unsigned long start, end, pixels = 0;
+
+	start = nticks;
+	while(nticks == start);
+	end = nticks + MSEC_TO_TICKS(msec);
+
+	while(nticks < end) {
+		/* move around, to hit all alignments */
+		x = (x + 97) % (g->fb.width - GB_IMG_SIZE);
+		y = (y + 61) % (g->fb.height - GB_IMG_SIZE);
+		g->color = pixels * 0x10101;
+
+		switch(test) {
+		case GB_CLEAR:
+			g->draw.clear(g);
+			pixels += g->fb.width * g->fb.height;
+			break;
+		case GB_RECT:
+			g->draw.rect(g, x, y, GB_IMG_SIZE, GB_IMG_SIZE);
+			pixels += GB_IMG_SIZE * GB_IMG_SIZE;
+			break;
+		case GB_HLINE:
+			g->draw.hline(g, x, y, g->fb.width - x);
+			pixels += g->fb.width - x;
+			break;
+		case GB_BLIT:
+			g->draw.blit(g, x, y, img);
+			pixels += GB_IMG_SIZE * GB_IMG_SIZE;
+			break;
+		case GB_CONV8:
+			gui_blit_conv(g, x, y, img8, cmap);
+			pixels += GB_IMG_SIZE * GB_IMG_SIZE;
+			break;
+		case GB_CONV32:
+			gui_blit_conv(g, x, y, img32, 0);
+			pixels += GB_IMG_SIZE * GB_IMG_SIZE;
+			break;
+		}
+	}
+	return pixels;
+}
+
+/* measure the gfxdraw kernels of every instruction set variant, in 640x480
+ * modes of each color depth, drawing to the LFB or a RAM buffer.
+ */
+static int cmd_gfxbench(int argc, char **argv)
+{
+	static const int bpp_list[] = {16, 24, 32};
+	int i, j, k, idx, use_ram = 0, nres = 0;
+	long msec = 200;
+	unsigned long mpix10;
+	struct video_mode vm;
+	struct gui_gfx gfx;
+	struct gui_image img, img8, img32;
+	uint32_t cmap[256];
+	void *fb, *rambuf = 0, *pixbuf = 0;
+	struct {
+		int bpp, simd;
+		unsigned long pixels[GB_NUM_TESTS];
+	} res[3 * 3];
+
+	for(i=1; i<argc; i++) {
+		if(strcmp(argv[i], "ram") == 0) {
+			use_ram = 1;
+		} else if((msec = atoi(argv[i])) <= 0 || msec > 2000) {
+			printf("usage: %s [msec] [ram]\n", argv[0]);
+			return -1;
+		}
+	}
+
+	memset(&img, 0, sizeof img);
+	img.width = img.height = GB_IMG_SIZE;
+	img8 = img32 = img;
+	img8.bpp = 8;
+	img8.pitch = GB_IMG_SIZE;
+	img32.bpp = 32;
+	img32.pitch = GB_IMG_SIZE * 4;
+	img32.rshift = 16;
+	img32.rmask = 0xff0000;
+	img32.gshift = 8;
+	img32.gmask = 0xff00;
+	img32.bmask = 0xff;
+
+	/* the same pixels serve as the source of all the blits */
+	if(!(pixbuf = malloc(GB_IMG_SIZE * GB_IMG_SIZE * 4)) ||
+			(use_ram && !(rambuf = malloc(640 * 480 * 4)))) {
+		printf("failed to allocate benchmark buffers\n");
+		free(pixbuf);
+		return -1;
+	}
+	for(i=0; i<GB_IMG_SIZE * GB_IMG_SIZE * 4; i++) {
+		((unsigned char*)pixbuf)[i] = i ^ (i >> 7);
+	}
+	img.pixels = img8.pixels = img32.pixels = pixbuf;
+	for(i=0; i<256; i++) {
+		cmap[i] = i * 0x10101;
+	}
+
+	gui_setgfx(&gfx);
+
+	for(i=0; i<sizeof bpp_list / sizeof *bpp_list; i++) {
+		if((idx = find_video_mode_idx(640, 480, bpp_list[i])) == -1) {
+			continue;
+		}
+		video_mode_info(idx, &vm);
+		if(vm.bpp != bpp_list[i] || !(fb = set_video_mode(vm.mode))) {
+			set_vga_mode(3);
+			continue;
+		}
+		con_scr_disable();
+
+		if(use_ram) {
+			fb = rambuf;
+			vm.pitch = vm.width * ((vm.bpp + 7) >> 3);
+		}
+		gui_framebuffer(fb, vm.width, vm.height, vm.pitch);
+		img.bpp = vm.bpp;
+		img.pitch = GB_IMG_SIZE * ((vm.bpp + 7) >> 3);
+
+		for(j=GUI_SIMD_NONE; j<=GUI_SIMD_SSE2; j++) {
+			if(gui_simd(j) != j) {
+				continue;	/* not supported by this CPU */
+			}
+			gui_pixelformat(vm.bpp, vm.rbits, vm.gbits, vm.bbits, vm.rshift, vm.gshift, vm.bshift);
+
+			res[nres].bpp = vm.bpp;
+			res[nres].simd = j;
+			for(k=0; k<GB_NUM_TESTS; k++) {
+				res[nres].pixels[k] = bench_gfx_test(&gfx, k, &img, &img8, &img32, cmap, msec);
+			}
+			nres++;
+		}
+
+		set_vga_mode(3);
+		con_scr_enable();
+	}
+	gui_simd(GUI_SIMD_SSE2);
+
+	con_clear();
+	free(pixbuf);
+	free(rambuf);
+
+	printf("Mpixels/s drawing to 640x480 %s, %ld ms per test\n", use_ram ? "RAM buffers" : "LFB modes", msec);
+	printf("           ");
+	for(k=0; k<GB_NUM_TESTS; k++) {
+		printf("%8s", gb_test_name[k]);
+	}
+	putchar('\n');
+	for(i=0; i<nres; i++) {
+		printf("%2dbpp %-6s", res[i].bpp, gb_simd_name[res[i].simd]);
+		for(k=0; k<GB_NUM_TESTS; k++) {
+			mpix10 = res[i].pixels[k] / (msec * 100);
+			printf("%6lu.%lu", mpix10 / 10, mpix10 % 10);
+		}
+		putchar('\n');
+	}
+	return nres ? 0 : -1;
+}
+
+static int call_int86_rm(int inum, struct int86regs *regs)
+{
+	int86_rm(inum, regs);
+	return 0;
+}
+
+/* count how many int86 round trips we can do in msec milliseconds, calling
+ * int 11h (get equipment list), which does next to nothing in the BIOS.
+ */
+static long bench_int86(int (*func)(int, struct int86regs*), long msec)
+{
+	long count = 0;
+	unsigned long start, end;
+	struct int86regs regs;
+
+	start = nticks;
+	while(nticks == start);
+	end = nticks + MSEC_TO_TICKS(msec);
+
+	while(nticks < end) {
+		memset(&regs, 0, sizeof regs);
+		if(func(0x11, &regs) == -1) {
+			return -1;
+		}
+		count++;
+	}
+	return count;
+}
+
+static int cmd_v86(int argc, char **argv)
+{
+	if(argc > 1 && strcmp(argv[1], "on") == 0) {
+		v86_enable(1);
+
+	} else if(argc > 1 && strcmp(argv[1], "off") == 0) {
+		v86_enable(0);
+
+	} else if(argc > 1 && strcmp(argv[1], "bench") == 0) {
+		long count, msec = argc > 2 ? atoi(argv[2]) : 1000;
+
+		if(msec <= 0 || msec > 2000) {
+			printf("invalid benchmark duration: %s\n", argv[2]);
+			return -1;
+		}
+
+		if((count = bench_int86(v86_int86, msec)) == -1) {
+			printf("v86: int 11h failed in virtual 8086 mode\n");
+		} else {
+			printf("v86: %ld calls in %ld ms (%ld ns/call)\n", count, msec,
+					count ? msec * 1000000 / count : 0);
+		}
+		count = bench_int86(call_int86_rm, msec);
+		printf("real mode: %ld calls in %ld ms (%ld ns/call)\n", count, msec,
+				count ? msec * 1000000 / count : 0);
+
+	} else if(argc <= 1) {
+		printf("BIOS calls run in %s mode\n", v86_enabled() ? "virtual 8086" : "real");
+
+	} else {
+		printf("usage: %s [subcmd]\n", argv[0]);
+		printf("Subcommands:\n");
+		printf(" on: run BIOS calls in virtual 8086 mode\n");
+		printf(" off: drop back to real mode for BIOS calls\n");
+		printf(" bench [msec]: compare BIOS call round trip times\n");
 		printf(" help: print subcommand help\n");
 		if(strcmp(argv[1], "help") != 0) {
 			return -1;
@@ -460,3 +809,120 @@ static int cmd_vbe(int argc, char **argv)
 	}
 	return 0;
 }
+
+/* calibrate the CPU speed, and with a target speed, check what the speed
+ * governor would do to a COM program, with the real mode duty cycling
+ * simulated by the measurement loop
+ */
+static int cmd_cpuspeed(int argc, char **argv)
+{
+	long speed, stall, full, eff;
+	char *endp;
+
+	full = speedgov_calibrate(1);
+	printf("full speed: %ld per ms\n", full);
+	if(argc <= 1) return 0;
+
+	speed = strtol(argv[1], &endp, 10);
+	if(endp == argv[1] || speed <= 0) {
+		printf("usage: %s [target speed]\n", argv[0]);
+		return -1;
+	}
+
+	stall = speedgov_start(speed);
+	eff = speedgov_measure(1000, stall);
+	speedgov_stop();
+
+	printf("target: %ld per ms, measured: %ld per ms (%ld%%)\n", speed, eff,
+			speed >= 100 ? eff / (speed / 100) : eff * 100 / speed);
+	return 0;
+}
+
+#define PB_FRAME_MSEC	14	/* simulated time step, about one frame at 70Hz */
+
+/* run the splash particle system at a few sizes, with a spawn rate that keeps
+ * it close to full, and estimate how many live particles fit in a frame.
+ */
+static int cmd_psysbench(int argc, char **argv)
+{
+	static const int sizes[] = {1024, 2048, 4096, 8192, 16384};
+	int i;
+	long msec = 1000, simt, nupd, live, usec;
+	unsigned long start, end;
+	struct emitter ps;
+
+	if(argc > 1 && ((msec = atoi(argv[1])) <= 0 || msec > 5000)) {
+		printf("usage: %s [msec]\n", argv[0]);
+		return -1;
+	}
+
+	printf("particle system updates, %ld ms per size\n", msec);
+	for(i=0; i<sizeof sizes / sizeof *sizes; i++) {
+		memset(&ps, 0, sizeof ps);
+		if(create_emitter(&ps, sizes[i]) == -1) {
+			printf("failed to allocate %d particles\n", sizes[i]);
+			return -1;
+		}
+		ps.plife = 1000;
+		ps.plife_range = 500;
+		ps.spawn_rate = SPAWN_PER_SEC((long)sizes[i], 0);
+		ps.damping = 1.0;
+		ps.grav_y = -20;
+		ps.x = 160;
+		ps.y = 115;
+		ps.x_range = ps.y_range = 5;
+		ps.pcol_start = 63;
+
+		/* run for a couple of lifetimes, to reach the steady state */
+		for(simt=1; simt<2000; simt+=PB_FRAME_MSEC) {
+			update_psys(&ps, simt);
+		}
+
+		nupd = live = 0;
+		start = nticks;
+		while(nticks == start);
+		end = nticks + MSEC_TO_TICKS(msec);
+
+		while(nticks < end) {
+			update_psys(&ps, simt);
+			simt += PB_FRAME_MSEC;
+			live += ps.pcount;
+			nupd++;
+		}
+		destroy_emitter(&ps);
+
+		live /= nupd;
+		usec = msec * 1000 / nupd;
+		printf("%5d max, %5ld live: %5ld us/update, ~%ld particles per 70Hz frame\n",
+				sizes[i], live, usec, usec ? live * 14286 / usec : 0);
+	}
+	return 0;
+}
+
+/* switch the console to a VBE graphics mode, or back to text mode */
+static int cmd_fbcon(int argc, char **argv)
+{
+	int xsz = 1024, ysz = 768, bpp = 0, cols, rows;
+
+	if(argc > 1 && strcmp(argv[1], "off") == 0) {
+		if(fbcon_on) {
+			set_vga_mode(3);
+			con_clear();
+		}
+		return 0;
+	}
+	if(argc > 1 && fbcon_parse_mode(argv[1], &xsz, &ysz, &bpp) == -1) {
+		printf("usage: %s [WxH[xBPP] | off]\n", argv[0]);
+		return -1;
+	}
+
+	if(fbcon_init(xsz, ysz, bpp) == -1) {
+		set_vga_mode(3);
+		con_clear();
+		printf("failed to start the graphics console\n");
+		return -1;
+	}
+	fbcon_size(&cols, &rows);
+	printf("graphics console: %dx%d characters\n", cols, rows);
+	return 0;
+}
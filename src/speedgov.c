@@ -0,0 +1,181 @@
+/*
+256boss - bootable launcher for 256byte intros
+Copyright (C) 2018-2020  John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY, without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "speedgov.h"
+#include "cfgfile.h"
+#include "datapath.h"
+#include "cpu.h"
+#include "intr.h"
+#include "timer.h"
+#include "zlib.h"
+
+/* IA32_CLOCK_MODULATION: duty cycle in bits 3:1, or 3:0 with the extended
+ * granularity of cpuid 6 eax bit 5, and enable in bit 4
+ */
+#define MSR_CLOCK_MOD	0x19a
+#define CLKMOD_ENABLE	0x10
+#define CLKMOD_MASK		0x1f
+#define CPUID6_ECMD		0x20
+
+#define CALIB_MSEC		200
+#define RECALIB_MSEC	48
+#define SPIN_CHUNK		256
+
+static void load_cfg(void);
+
+/* stall iterations per tick in rm_timer_intr (lowcode.s) */
+extern uint32_t rm_timer_stall;
+
+static long full_speed;
+static struct cfglist *cfg;
+static int cfg_loaded;
+static unsigned int clkmod_saved[2];
+static int clkmod_active;
+
+
+long speedgov_calibrate(int force)
+{
+	if(!full_speed || force) {
+		full_speed = speedgov_measure(CALIB_MSEC, 0);
+	}
+	return full_speed;
+}
+
+long speedgov_measure(long msec, long stall)
+{
+	int intr;
+	unsigned long start, end, last, count = 0;
+
+	intr = get_intr_flag();
+	enable_intr();
+
+	start = nticks;
+	while(nticks == start);
+	start = last = nticks;
+	end = start + MSEC_TO_TICKS(msec);
+
+	while(nticks < end) {
+		cpu_spin(SPIN_CHUNK);
+		count += SPIN_CHUNK;
+		if(stall && nticks != last) {
+			last = nticks;
+			cpu_spin(stall);
+		}
+	}
+
+	set_intr_flag(intr);
+	return count / TICKS_TO_MSEC(end - start);
+}
+
+long speedgov_lookup(const char *name, const void *img, int size)
+{
+	char key[16];
+	const char *s;
+	long speed = 0;
+
+	load_cfg();
+	if(!cfg) return 0;
+
+	if(name) {
+		if((s = strrchr(name, '/'))) {
+			name = s + 1;
+		}
+		speed = cfg_getint(cfg, name, 0);
+	}
+	if(speed <= 0 && img) {
+		sprintf(key, "%08lx", crc32(0, img, size));
+		speed = cfg_getint(cfg, key, 0);
+	}
+	return speed > 0 ? speed : 0;
+}
+
+long speedgov_start(long speed)
+{
+	int level, nlevels;
+	long full, eff;
+	unsigned int regs[4], val[2];
+
+	rm_timer_stall = 0;
+	if(speed <= 0 || (full = speedgov_calibrate(0)) <= speed) {
+		return 0;
+	}
+	eff = full;
+
+	/* clock modulation takes care of the coarse steps, never going below the
+	 * target speed, and duty cycling makes up the difference
+	 */
+	if(cpu_has(CPU_FEAT_MSR | CPU_FEAT_ACPI)) {
+		nlevels = 8;
+		cpuid(0, regs);
+		if(regs[0] >= 6) {
+			cpuid(6, regs);
+			if(regs[0] & CPUID6_ECMD) nlevels = 16;
+		}
+
+		level = (speed * nlevels + full - 1) / full;
+		if(level < nlevels) {
+			rdmsr(MSR_CLOCK_MOD, clkmod_saved);
+			val[0] = (clkmod_saved[0] & ~CLKMOD_MASK) | CLKMOD_ENABLE |
+				(nlevels == 8 ? level << 1 : level);
+			val[1] = clkmod_saved[1];
+			wrmsr(MSR_CLOCK_MOD, val);
+			clkmod_active = 1;
+
+			/* the actual speed at this duty cycle varies, measure it */
+			eff = speedgov_measure(RECALIB_MSEC, 0);
+			printf("speed governor: clock modulation %d/%d: %ld per ms\n", level,
+					nlevels, eff);
+		}
+	}
+
+	if(eff > speed) {
+		rm_timer_stall = (eff - speed) * TICKS_TO_MSEC(1);
+	}
+	printf("speed governor: %ld -> %ld per ms, stall %lu per tick\n", full, speed,
+			(unsigned long)rm_timer_stall);
+	return rm_timer_stall;
+}
+
+void speedgov_stop(void)
+{
+	rm_timer_stall = 0;
+	if(clkmod_active) {
+		wrmsr(MSR_CLOCK_MOD, clkmod_saved);
+		clkmod_active = 0;
+	}
+}
+
+static void load_cfg(void)
+{
+	FILE *fp;
+	char *fname;
+
+	if(cfg_loaded) return;
+	cfg_loaded = 1;
+
+	if(init_datapath() == -1) return;
+	fname = datafile(SPEEDGOV_CFG);
+
+	/* no profiles is the common case, don't let load_cfglist complain */
+	if(!(fp = fopen(fname, "rb"))) return;
+	fclose(fp);
+
+	cfg = load_cfglist(fname);
+}
@@ -0,0 +1,48 @@
+/*
+256boss - bootable launcher for 256byte intros
+Copyright (C) 2018-2020  John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY, without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef SPEEDGOV_H_
+#define SPEEDGOV_H_
+
+/* per-intro speed profiles, one "name = speed" line each, where name is the
+ * COM file name, or the crc32 of its contents as 8 hex digits, and speed is
+ * in cpu_spin iterations per millisecond (see speedgov_calibrate)
+ */
+#define SPEEDGOV_CFG	"speed.cfg"
+
+/* measures how many cpu_spin iterations per millisecond the CPU runs at full
+ * speed. The result is kept, and only measured again if force is non-zero.
+ */
+long speedgov_calibrate(int force);
+/* measures the effective speed for msec milliseconds, while burning stall
+ * iterations after every timer tick, like the real mode timer handler does
+ */
+long speedgov_measure(long msec, long stall);
+
+/* looks up the speed profile of a COM program by name (which may be null) or
+ * by the crc32 of its image. Returns 0 if there is none.
+ */
+long speedgov_lookup(const char *name, const void *img, int size);
+
+/* throttle the CPU down to the given speed until speedgov_stop is called,
+ * using clock modulation if available, and duty cycling in the real mode
+ * timer handler for the rest. Returns the stall iterations per tick.
+ */
+long speedgov_start(long speed);
+void speedgov_stop(void);
+
+#endif	/* SPEEDGOV_H_ */
@@ -18,19 +18,34 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include <stdlib.h>
 #include "psys.h"
 
+static void spawn(struct emitter *ps);
 static void evalcurve(float *cv, int numcv, float t, float *xret, float *yret);
 static inline float bspline(float a, float b, float c, float d, float t);
 
 int create_emitter(struct emitter *ps, int count)
 {
-	if(!(ps->plist = calloc(count, sizeof *ps->plist))) {
+	int32_t *buf;
+
+	/* all the particle arrays share one allocation */
+	if(!(buf = malloc(count * 7 * sizeof *buf))) {
 		return -1;
 	}
+	ps->px = buf;
+	ps->py = buf + count;
+	ps->pvx = buf + count * 2;
+	ps->pvy = buf + count * 3;
+	ps->pcol = buf + count * 4;
+	ps->pdcol = buf + count * 5;
+	ps->ptime = buf + count * 6;
+
+	ps->pcount = 0;
 	ps->pmax = count;
 	ps->plife = 1000;
 	ps->pcol_start = 0;
 	ps->pcol_end = 255;
 	ps->spawn_rate = SPAWN_PER_SEC(10, 1);
+	ps->spawn_acc = 0;
+	ps->prev_upd = 0;
 	ps->damping = 0.9999;
 	ps->grav_y = 9;
 	ps->curve_scale_x = ps->curve_scale_y = 1.0f;
@@ -40,83 +55,113 @@ int create_emitter(struct emitter *ps, int count)
 
 void destroy_emitter(struct emitter *ps)
 {
-	free(ps->plist);
+	free(ps->px);
 }
 
 #define frand()		((float)rand() / (float)RAND_MAX)
 
+/* float pixels per second (squared) to fixed point per millisecond (squared) */
+#define VEL_FIX(x)	((int32_t)((x) * (float)(1 << PSYS_VEL_SHIFT) / 1000.0f))
+#define ACC_FIX(x)	((int32_t)((x) * (float)(1 << PSYS_VEL_SHIFT) / 1000000.0f))
+
+static void spawn(struct emitter *ps)
+{
+	int idx;
+	long life;
+	float x, y, vx, vy;
+
+	if(ps->pcount >= ps->pmax) {
+		return;
+	}
+	idx = ps->pcount++;
+
+	x = ps->x;
+	y = ps->y;
+	if(ps->x_range != 0.0f) x += ps->x_range * frand() - ps->x_range * 0.5f;
+	if(ps->y_range != 0.0f) y += ps->y_range * frand() - ps->y_range * 0.5f;
+	vx = ps->vx;
+	vy = ps->vy;
+	if(ps->vx_range != 0.0f) vx += ps->vx_range * frand() - ps->vx_range * 0.5f;
+	if(ps->vy_range != 0.0f) vy += ps->vy_range * frand() - ps->vy_range * 0.5f;
+	life = ps->plife;
+	if(ps->plife_range) life += rand() % ps->plife_range - ps->plife_range / 2;
+	if(life < 1) life = 1;
+
+	if(ps->curve_cv) {
+		float cx, cy, t, tlen;
+		tlen = ps->curve_tend - ps->curve_tbeg;
+		t = ps->curve_tbeg + frand() * tlen;
+		evalcurve(ps->curve_cv, ps->curve_num_cv, t, &cx, &cy);
+		x += cx * ps->curve_scale_x;
+		y += cy * ps->curve_scale_y;
+	}
+
+	ps->px[idx] = (int32_t)(x * (float)(1 << PSYS_POS_SHIFT));
+	ps->py[idx] = (int32_t)(y * (float)(1 << PSYS_POS_SHIFT));
+	ps->pvx[idx] = VEL_FIX(vx);
+	ps->pvy[idx] = VEL_FIX(vy);
+	ps->ptime[idx] = life;
+	/* color goes linearly from pcol_start to pcol_end over the lifetime */
+	ps->pcol[idx] = ps->pcol_start << PSYS_COL_SHIFT;
+	ps->pdcol[idx] = ((ps->pcol_start - ps->pcol_end) << PSYS_COL_SHIFT) / life;
+}
+
 void update_psys(struct emitter *ps, long msec)
 {
-	int i;
-	struct particle *p;
+	int i, last;
 	long dtms;
-	float dt;
+	int32_t ax, ay, damp;
 
 	if(ps->prev_upd <= 0) {
 		ps->prev_upd = msec;
 		return;
 	}
 	dtms = msec - ps->prev_upd;
-	dt = (float)dtms / 1000.0f;
 	ps->prev_upd = msec;
 
 	ps->spawn_acc += ps->spawn_rate * dtms / 1000;
 	while(ps->spawn_acc >= 0x100) {
-		p = 0;
-		for(i=0; i<ps->pmax; i++) {
-			if(ps->plist[i].life <= 0) {
-				p = ps->plist + i;
-				break;
-			}
-		}
-
-		if(p) {
-			p->x = ps->x;
-			p->y = ps->y;
-			if(ps->x_range != 0.0f) p->x += ps->x_range * frand() - ps->x_range * 0.5f;
-			if(ps->y_range != 0.0f) p->y += ps->y_range * frand() - ps->y_range * 0.5f;
-			p->vx = ps->vx;
-			p->vy = ps->vy;
-			if(ps->vx_range != 0.0f) p->vx += ps->vx_range * frand() - ps->vx_range * 0.5f;
-			if(ps->vy_range != 0.0f) p->vy += ps->vy_range * frand() - ps->vy_range * 0.5f;
-			p->life = ps->plife;
-			if(ps->plife_range) p->life += rand() % ps->plife_range - ps->plife_range / 2;
-			p->max_life = p->life;
-			p->col = ps->pcol_start;
-
-			if(ps->curve_cv) {
-				float cx, cy, t, tlen;
-				tlen = ps->curve_tend - ps->curve_tbeg;
-				t = ps->curve_tbeg + frand() * tlen;
-				evalcurve(ps->curve_cv, ps->curve_num_cv, t, &cx, &cy);
-				p->x += cx * ps->curve_scale_x;
-				p->y += cy * ps->curve_scale_y;
-			}
-		}
-
+		spawn(ps);
 		ps->spawn_acc -= 0x100;
 	}
 
+	if(dtms > PSYS_MAX_DT) dtms = PSYS_MAX_DT;
+
 	ps->fx = ps->grav_x;
 	ps->fy = ps->grav_y;
+	ax = ACC_FIX(ps->fx) * dtms;
+	ay = ACC_FIX(ps->fy) * dtms;
+	/* damping as the fraction of the velocity taken away per update, in 16
+	 * bits. The default 0.9999 becomes 7/65536, about 7% stronger than asked
+	 * for, which is as close as 16 bits get.
+	 */
+	damp = ps->damping >= 1.0f ? 0 : 65536 - (int32_t)(ps->damping * 65536.0f + 0.5f);
+
+	i = 0;
+	while(i < ps->pcount) {
+		if((ps->ptime[i] -= dtms) <= 0) {
+			/* move the last live particle here, and process it next */
+			last = --ps->pcount;
+			ps->px[i] = ps->px[last];
+			ps->py[i] = ps->py[last];
+			ps->pvx[i] = ps->pvx[last];
+			ps->pvy[i] = ps->pvy[last];
+			ps->pcol[i] = ps->pcol[last];
+			ps->pdcol[i] = ps->pdcol[last];
+			ps->ptime[i] = ps->ptime[last];
+			continue;
+		}
 
-	p = ps->plist;
-	for(i=0; i<ps->pmax; i++) {
-		if(p->life > 0) {
-			p->life -= dtms;
-			if(p->life > 0) {
-				p->x += p->vx * dt;
-				p->y += p->vy * dt;
-				p->vx = p->vx * ps->damping + ps->fx * dt;
-				p->vy = p->vy * ps->damping + ps->fy * dt;
-
-				/* lerp is backwards because life starts max and decreases */
-				p->col = ps->pcol_end + (ps->pcol_start - ps->pcol_end) * p->life / p->max_life;
-			} else {
-				p->life = 0;
-			}
+		ps->px[i] += (ps->pvx[i] * dtms) >> (PSYS_VEL_SHIFT - PSYS_POS_SHIFT);
+		ps->py[i] += (ps->pvy[i] * dtms) >> (PSYS_VEL_SHIFT - PSYS_POS_SHIFT);
+		if(damp) {
+			ps->pvx[i] -= (ps->pvx[i] >> 16) * damp;
+			ps->pvy[i] -= (ps->pvy[i] >> 16) * damp;
 		}
-		p++;
+		ps->pvx[i] += ax;
+		ps->pvy[i] += ay;
+		ps->pcol[i] -= ps->pdcol[i] * dtms;
+		i++;
 	}
 
 	ps->fx = ps->fy = 0;
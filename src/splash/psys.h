@@ -18,11 +18,22 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #ifndef PSYS_H_
 #define PSYS_H_
 
-struct particle {
-	float x, y, vx, vy;
-	long life, max_life;
-	int col;
-};
+#include <inttypes.h>
+
+/* Particles are kept as a structure of arrays in fixed point, with the live
+ * ones packed at the start: spawning appends at pcount, and a dying particle
+ * is replaced by the last live one, so everything past pcount is free.
+ *
+ *   position: 16.16 pixels
+ *   velocity: 8.24 pixels per millisecond
+ *   color:    16.16, dcol is the change per millisecond
+ */
+#define PSYS_POS_SHIFT	16
+#define PSYS_VEL_SHIFT	24
+#define PSYS_COL_SHIFT	16
+
+/* longer time steps are clamped, to keep velocity * dt in 32 bits */
+#define PSYS_MAX_DT		64
 
 struct emitter {
 	float x, y, x_range, y_range;
@@ -30,7 +41,9 @@ struct emitter {
 	float grav_x, grav_y;
 	float fx, fy;
 
-	struct particle *plist;
+	int32_t *px, *py, *pvx, *pvy;
+	int32_t *pcol, *pdcol;
+	int32_t *ptime;	/* remaining lifetime in msec */
 	int pcount, pmax;
 	long spawn_rate, spawn_acc;
 	float damping;
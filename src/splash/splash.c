@@ -30,13 +30,24 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "datapath.h"
 #include "data.h"
 #include "psys.h"
+#include "tunnel.h"
+#include "ui/fsview.h"
 
 static void setup_video(void);
+static void setup_preroll(void);
+static void preroll_pal(long msec, int level);
+static void setup_tunpal(void);
+static int load_step(void);
+static int run_loader(long budget);
 static void draw(long msec);
 static void draw_tunnel(long msec);
-static int precalc_tunnel(void);
+static FILE *open_tunlut(const char *fname);
+static int load_cached_image(struct image *img, const char *name, int col_offs);
+static void tex_loaded(void);
+static void build_fogtex(int blursel);
 static void draw_psys(struct emitter *psys, long msec);
 static void setup_psys_cmap(long msec);
+static void setup_flamepal(void);
 
 /* data/bos.s */
 void bos48(void *fb, int x, int y, int idx);
@@ -49,6 +60,8 @@ static unsigned char *vmem = (unsigned char*)0xa0000;
 static struct image img_ui, img_tex;
 static long start_ticks;
 static struct cmapent tunpal[256];
+/* palette fades, computed once the colors they need are loaded */
+static struct pal_ramp tun_fadein, tun_flash, flame_fadein, flame_fadeout;
 
 #define UI_COL_OFFS			192
 #define TEXT_COL_OFFS		64
@@ -64,6 +77,18 @@ static struct cmapent tunpal[256];
 
 #define SPLASH_DUR			(TUN_DUR + FLAME_DUR)
 
+#define FADEIN_DUR	3000
+#define EASEIN_START	2000
+#define EASEIN_DUR	2000
+#define TUN_FLASH_R	221
+#define TUN_FLASH_G	234
+#define TUN_FLASH_B	239
+
+/* fade-ins keep going a bit past their end, to make sure the final colors
+ * are set exactly even if there's no frame right at the end.
+ */
+#define FADE_SETTLE	100
+
 
 #define HEADER_HEIGHT	17
 #define FX_TEX_SIZE		128
@@ -71,58 +96,74 @@ static struct cmapent tunpal[256];
 
 #define FX_PAL_OFFS		64
 #define FX_PAL_SIZE		32
-#define FX_FOG_LEVELS	6
+#define FX_FOG_LEVELS	TUN_FOG_LEVELS
 
-#define FX_TEX_USCALE	0.5
-#define FX_TEX_VSCALE	0.5
-
-#define TUN_WIDTH		450
-#define TUN_HEIGHT		300
 #define TUN_PAN_XSZ		(TUN_WIDTH - 320)
 #define TUN_PAN_YSZ		(TUN_HEIGHT - 200)
-struct tunnel {
-	unsigned short x, y;
-	unsigned char fog;
-} *tunlut;
+static uint32_t *tunlut;
+/* the selected blur level of the texture, with the fog already added: one
+ * FX_TEX_SIZE^2 plane per fog level, plus a black one for full fog.
+ */
+static unsigned char *fogtex;
+static int fogtex_blur;
+#define FOGTEX_SIZE		((FX_FOG_LEVELS + 1) * FX_TEX_SIZE * FX_TEX_SIZE)
+
+/* frame time counters for the tunnel part */
+static long tun_frames, tun_worst;
 
 static struct emitter psys;
 
+/* Loading is split into stages which are advanced in small steps between
+ * frames, so that the splash animation starts right away instead of after all
+ * the assets are decoded. The tunnel can't start before LD_UI, and until then
+ * a palette-cycled ring pattern, which costs nothing to draw, keeps the screen
+ * moving. The flame part needs everything up to LD_FSVIEW.
+ */
+enum {
+	LD_DATAPATH,	/* locate the data dir, start decoding the tunnel texture */
+	LD_TEX,			/* tunnel texture rows */
+	LD_TUNNEL,		/* tunnel LUT, from data/tunnel.lut or computed in rows */
+	LD_UI,			/* UI image rows */
+	LD_FSVIEW,		/* root directory scan for the file browser */
+	LD_DONE
+};
+static int ldstage;
+static struct img_loader imgld;
+static int tunrow;	/* -1 until we've tried loading the LUT file */
+static FILE *tunfp;	/* LUT file being read, 0 if it's computed instead */
+
+#define LOAD_BUDGET_MSEC	8	/* loading time per frame once the tunnel runs */
+#define PREROLL_BUDGET_MSEC	12	/* and before that, with nothing to draw */
+#define LOAD_ROWS_PER_STEP	8
+#define LUT_ROWS_PER_READ	2	/* 3.6k, a few sectors even from floppies */
+
+/* the preroll rings fade in over this long, and out as fast once the tunnel
+ * is ready, so they're barely visible if loading is quick.
+ */
+#define PREROLL_FADE_DUR	1000
+#define PREROLL_COL_OFFS	1
+#define PREROLL_NCOLS		32
+
 
 void splash_screen(void)
 {
-	int i;
-	long msec;
-
-	if(init_datapath() == -1) {
-		printf("splash_screen: failed to locate the data dir\n");
-	}
-
-	if(!(fb = malloc(64000))) {
-		printf("splash_screen: failed to allocate back buffer\n");
-		goto end;
-	}
+	long msec, level;
+	unsigned long prev_ticks;
 
+	ldstage = LD_DATAPATH;
+	tunrow = -1;
+	tunfp = 0;
 	tunlut = 0;
+	fogtex = 0;
+	fogtex_blur = -1;
+	tun_frames = tun_worst = 0;
 	img_ui.pixels = img_tex.pixels = 0;
 
-	if(precalc_tunnel() == -1) {
-		goto end;
-	}
-
-	if(load_image(&img_ui, datafile("256boss.png")) == -1 || img_ui.bpp != 8) {
-		printf("splash_screen: failed to load UI image\n");
-		goto end;
-	}
-	for(i=0; i<img_ui.width * img_ui.height; i++) {
-		img_ui.pixels[i] += UI_COL_OFFS;
-	}
-
-	if(load_image(&img_tex, datafile("sstex2.png")) == -1 || img_tex.bpp != 8) {
-		printf("splash_screen: failed to load texture\n");
+	if(!(fb = malloc(64000)) || !(tunlut = malloc(TUN_WIDTH * TUN_HEIGHT * sizeof *tunlut)) ||
+			!(fogtex = malloc(FOGTEX_SIZE))) {
+		printf("splash_screen: failed to allocate back buffer\n");
 		goto end;
 	}
-	image_color_offset(&img_tex, FX_PAL_OFFS);
-	img_tex.width = img_tex.height;
 
 	create_emitter(&psys, 8192);
 	psys.spawn_rate = SPAWN_PER_SEC(4000, 0);
@@ -143,8 +184,41 @@ void splash_screen(void)
 
 	while(kb_getkey() >= 0);	/* empty any input queues */
 
+	/* cycle the preroll palette until the tunnel has everything it needs,
+	 * loading for most of every frame, and then fade the rings out.
+	 */
 	setup_video();
-	start_ticks = nticks;
+	setup_preroll();
+	start_ticks = prev_ticks = nticks;
+	level = 0;
+	while(ldstage < LD_UI || level > 0) {
+		if(kb_getkey() >= 0) {
+			goto end;
+		}
+		msec = TICKS_TO_MSEC(nticks - start_ticks);
+		if(ldstage < LD_UI) {
+			level += TICKS_TO_MSEC(nticks - prev_ticks) * 256 / PREROLL_FADE_DUR;
+			if(level > 256) level = 256;
+		} else {
+			level -= TICKS_TO_MSEC(nticks - prev_ticks) * 256 / PREROLL_FADE_DUR;
+			if(level < 0) level = 0;
+		}
+		prev_ticks = nticks;
+
+		/* no vsync wait, that's time the loader can use */
+		preroll_pal(msec, level);
+		pal_commit(0);
+
+		if(ldstage < LD_UI) {
+			if(run_loader(MSEC_TO_TICKS(PREROLL_BUDGET_MSEC)) == -1) {
+				goto end;
+			}
+		} else {
+			halt_cpu();
+		}
+	}
+
+	start_ticks = prev_ticks = nticks;
 	msec = 0;
 
 	while(msec < SPLASH_DUR) {
@@ -154,10 +228,45 @@ void splash_screen(void)
 		}
 
 		msec = TICKS_TO_MSEC(nticks - start_ticks);
+		if(msec >= TUN_DUR && ldstage < LD_DONE) {
+			/* very slow machine, the rest is needed right now */
+			if(run_loader(-1) == -1) break;
+		}
 		draw(msec);
+
+		if(msec < TUN_DUR) {
+			long dt = TICKS_TO_MSEC(nticks - prev_ticks);
+			if(dt > tun_worst) tun_worst = dt;
+			tun_frames++;
+		}
+		prev_ticks = nticks;
+
+		if(ldstage < LD_DONE && run_loader(MSEC_TO_TICKS(LOAD_BUDGET_MSEC)) == -1) {
+			break;
+		}
+	}
+
+	if(tun_frames > 0) {
+		msec = TICKS_TO_MSEC(prev_ticks - start_ticks);
+		if(msec > TUN_DUR) msec = TUN_DUR;
+		printf("splash: tunnel %ld frames in %ld ms (%ld fps), slowest frame %ld ms\n",
+				tun_frames, msec, msec > 0 ? tun_frames * 1000 / msec : 0, tun_worst);
 	}
 
 end:
+	/* drop whatever is still being loaded, but textui needs fsview */
+	if(tunfp) {
+		fclose(tunfp);
+		tunfp = 0;
+	}
+	if(ldstage < LD_FSVIEW) {
+		load_image_end(&imgld);
+		ldstage = LD_FSVIEW;
+	}
+	if(ldstage == LD_FSVIEW) {
+		load_step();
+	}
+
 	textui();
 	con_scr_enable();
 	set_vga_mode(3);
@@ -165,19 +274,181 @@ end:
 	destroy_emitter(&psys);
 	free(fb);
 	free(tunlut);
+	free(fogtex);
 	free(img_ui.pixels);
 	free(img_tex.pixels);
 }
 
+/* advances the current loading stage by one step, returns -1 on failure */
+static int load_step(void)
+{
+	int res;
+
+	switch(ldstage) {
+	case LD_DATAPATH:
+		if(init_datapath() == -1) {
+			printf("splash_screen: failed to locate the data dir\n");
+		}
+		if(load_cached_image(&img_tex, "sstex2", FX_PAL_OFFS) != -1) {
+			tex_loaded();
+			ldstage = LD_TUNNEL;
+			break;
+		}
+		if(load_image_begin(&imgld, &img_tex, datafile("sstex2.png")) == -1) {
+			printf("splash_screen: failed to load texture\n");
+			return -1;
+		}
+		ldstage++;
+		break;
+
+	case LD_TEX:
+		if((res = load_image_rows(&imgld, LOAD_ROWS_PER_STEP)) == -1 || (res && img_tex.bpp != 8)) {
+			printf("splash_screen: failed to load texture\n");
+			return -1;
+		}
+		if(res) {
+			image_color_offset(&img_tex, FX_PAL_OFFS);
+			tex_loaded();
+			ldstage++;
+		}
+		break;
+
+	case LD_TUNNEL:
+		if(tunrow == -1) {
+			/* generated at build time by tools/tunlut, computing it here is
+			 * just the fallback if it's missing.
+			 */
+			tunfp = open_tunlut(datafile("tunnel.lut"));
+			tunrow = 0;
+		} else if(tunfp) {
+			/* read in small pieces, a big read would stall the preroll */
+			int nrows = TUN_HEIGHT - tunrow;
+			size_t sz;
+
+			if(nrows > LUT_ROWS_PER_READ) nrows = LUT_ROWS_PER_READ;
+			sz = nrows * TUN_WIDTH * sizeof *tunlut;
+			if(fread(tunlut + tunrow * TUN_WIDTH, 1, sz, tunfp) < sz) {
+				printf("splash_screen: unexpected end of tunnel LUT, computing the rest\n");
+				fclose(tunfp);
+				tunfp = 0;
+			} else {
+				tunrow += nrows;
+			}
+		} else if(tunrow < TUN_HEIGHT) {
+			tun_calc_rows(tunlut, tunrow, LOAD_ROWS_PER_STEP);
+			tunrow += LOAD_ROWS_PER_STEP;
+		}
+		if(tunrow >= TUN_HEIGHT) {
+			if(tunfp) {
+				fclose(tunfp);
+				tunfp = 0;
+			}
+			if(load_cached_image(&img_ui, "256boss", UI_COL_OFFS) != -1) {
+				setup_flamepal();
+				ldstage = LD_FSVIEW;
+				break;
+			}
+			if(load_image_begin(&imgld, &img_ui, datafile("256boss.png")) == -1) {
+				printf("splash_screen: failed to load UI image\n");
+				return -1;
+			}
+			ldstage++;
+		}
+		break;
+
+	case LD_UI:
+		if((res = load_image_rows(&imgld, LOAD_ROWS_PER_STEP)) == -1 || (res && img_ui.bpp != 8)) {
+			printf("splash_screen: failed to load UI image\n");
+			return -1;
+		}
+		if(res) {
+			image_color_offset(&img_ui, UI_COL_OFFS);
+			setup_flamepal();
+			ldstage++;
+		}
+		break;
+
+	case LD_FSVIEW:
+		fsv_init(&fsview);
+		ldstage++;
+		break;
+
+	default:
+		break;
+	}
+	return 0;
+}
+
+/* runs loading steps for up to budget ticks (at least one step), or until
+ * everything is loaded if budget is negative.
+ */
+static int run_loader(long budget)
+{
+	unsigned long start = nticks;
+
+	do {
+		if(load_step() == -1) {
+			return -1;
+		}
+	} while(ldstage < LD_DONE && (budget < 0 || nticks - start < budget));
+	return 0;
+}
+
 static void setup_video(void)
 {
-	int i, j;
-	struct cmapent *col;
+	int i;
 
 	con_clear();	/* this has the side-effect of resetting CRTC scroll regs */
 	set_vga_mode(0x13);
 	con_scr_disable();
 
+	/* the tunnel fades in from black, keep its colors dark until it starts */
+	for(i=FX_PAL_OFFS; i<256; i++) {
+		pal_set(i, 0, 0, 0);
+	}
+	pal_commit(1);
+}
+
+/* concentric rings around the center of the screen, one palette entry each,
+ * drawn once; preroll_pal moves them by cycling the colors.
+ */
+static void setup_preroll(void)
+{
+	int i, j;
+	unsigned char *pptr = vmem;
+
+	/* start from black, not the default mode 13h colors */
+	preroll_pal(0, 0);
+	pal_commit(0);
+
+	for(i=0; i<200; i++) {
+		int dy = i - 100;
+		for(j=0; j<320; j++) {
+			int dx = j - 160;
+			*pptr++ = PREROLL_COL_OFFS + (((dx * dx + dy * dy) >> 7) & (PREROLL_NCOLS - 1));
+		}
+	}
+}
+
+/* a bright band moving outwards, at intensity level out of 256 */
+static void preroll_pal(long msec, int level)
+{
+	int i, w;
+
+	for(i=0; i<PREROLL_NCOLS; i++) {
+		w = (i * (512 / PREROLL_NCOLS) - msec / 2) & 511;
+		w = w < 256 ? w : 511 - w;
+		w = w * level >> 8;
+		pal_set(PREROLL_COL_OFFS + i, w * TUN_FLASH_R >> 9, w * TUN_FLASH_G >> 9,
+				w * TUN_FLASH_B >> 9);
+	}
+}
+
+static void setup_tunpal(void)
+{
+	int i, j;
+	struct cmapent *col, flash[256];
+
 	col = img_tex.cmap;
 	for(i=0; i<img_tex.cmap_ncolors; i++) {
 		for(j=0; j<FX_FOG_LEVELS; j++) {
@@ -185,13 +456,46 @@ static void setup_video(void)
 			int g = (int)col->g * (FX_FOG_LEVELS - j) / FX_FOG_LEVELS;
 			int b = (int)col->b * (FX_FOG_LEVELS - j) / FX_FOG_LEVELS;
 			int idx = i + FX_PAL_OFFS + FX_PAL_SIZE * j;
-			set_pal_entry(idx, r, g, b);
 			tunpal[idx].r = r;
 			tunpal[idx].g = g;
 			tunpal[idx].b = b;
 		}
 		col++;
 	}
+
+	pal_ramp_init(&tun_fadein, FX_PAL_OFFS, 256 - FX_PAL_OFFS, 0,
+			(unsigned char*)(tunpal + FX_PAL_OFFS));
+
+	for(i=0; i<256; i++) {
+		flash[i].r = TUN_FLASH_R;
+		flash[i].g = TUN_FLASH_G;
+		flash[i].b = TUN_FLASH_B;
+	}
+	pal_ramp_init(&tun_flash, 0, 256, (unsigned char*)tunpal, (unsigned char*)flash);
+}
+
+/* white to the flame, UI and text colors, and then the flame and text to black */
+static void setup_flamepal(void)
+{
+	int i;
+	struct cmapent white[256], pal[256];
+
+	memset(white, 0xff, sizeof white);
+	memset(pal, 0xff, sizeof pal);
+
+	for(i=0; i<64; i++) {
+		pal[i].r = firepal[i][0];
+		pal[i].g = firepal[i][1];
+		pal[i].b = firepal[i][2];
+	}
+	for(i=0; i<30; i++) {
+		int idx = i + TEXT_COL_OFFS;
+		pal[idx].r = pal[idx].g = pal[idx].b = i * 255 / 30;
+	}
+	memcpy(pal + UI_COL_OFFS, img_ui.cmap, (256 - UI_COL_OFFS) * sizeof *pal);
+
+	pal_ramp_init(&flame_fadein, 0, 256, (unsigned char*)white, (unsigned char*)pal);
+	pal_ramp_init(&flame_fadeout, 0, TEXT_COL_OFFS + 30, (unsigned char*)pal, 0);
 }
 
 static int bosx[] = {111, 143, 175, 207};
@@ -253,39 +557,22 @@ static void draw(long msec)
 	}
 
 	wait_vsync();
+	pal_commit(0);
 	memcpy(vmem, fb, 64000);
 }
 
-#define FADEIN_DUR	3000
-#define EASEIN_START	2000
-#define EASEIN_DUR	2000
-#define TUN_FLASH_R	221
-#define TUN_FLASH_G	234
-#define TUN_FLASH_B	239
 static void draw_tunnel(long msec)
 {
-	int i, j, tx, ty, xoffs, yoffs;
-	struct tunnel *tun;
-	unsigned char *pptr;
+	int i, j, xoffs, yoffs;
+	uint32_t *tun, *pptr;
 	float shake, t;
-	int blursel, bluroffs;
+	int blursel;
 	long anmt;
 
-	if(msec < FADEIN_DUR) {
-		for(i=FX_PAL_OFFS; i<256; i++) {
-			int r = tunpal[i].r * msec / FADEIN_DUR;
-			int g = tunpal[i].g * msec / FADEIN_DUR;
-			int b = tunpal[i].b * msec / FADEIN_DUR;
-			set_pal_entry(i, r, g, b);
-		}
+	if(msec < FADEIN_DUR + FADE_SETTLE) {
+		pal_ramp_set(&tun_fadein, msec * 256 / FADEIN_DUR);
 	} else if(msec >= TUN_FADEOUT_START && msec < TUN_FADEOUT_START + TUN_FADEOUT_DUR) {
-		for(i=0; i<256; i++) {
-			int tm = msec - TUN_FADEOUT_START;
-			int r = (int)tunpal[i].r + (TUN_FLASH_R - (int)tunpal[i].r) * tm / TUN_FADEOUT_DUR;
-			int g = (int)tunpal[i].g + (TUN_FLASH_G - (int)tunpal[i].g) * tm / TUN_FADEOUT_DUR;
-			int b = (int)tunpal[i].b + (TUN_FLASH_B - (int)tunpal[i].b) * tm / TUN_FADEOUT_DUR;
-			set_pal_entry(i, r, g, b);
-		}
+		pal_ramp_set(&tun_flash, (msec - TUN_FADEOUT_START) * 256 / TUN_FADEOUT_DUR);
 	}
 
 	anmt = msec * msec / 2048;
@@ -293,7 +580,9 @@ static void draw_tunnel(long msec)
 	blursel = (msec - 500) / 1800;
 	if(blursel < 0) blursel = 0;
 	if(blursel > 3) blursel = 3;
-	bluroffs = blursel * FX_TEX_SIZE;
+	if(blursel != fogtex_blur) {
+		build_fogtex(blursel);
+	}
 
 	t = (float)msec / 1000.0f;
 	shake = (t - 2) * 0.08;
@@ -301,139 +590,128 @@ static void draw_tunnel(long msec)
 	xoffs = (int)(cos(t * 3.0) * shake * (TUN_PAN_XSZ / 2) + (TUN_PAN_XSZ / 2));
 	yoffs = (int)(sin(t * 4.0) * shake * (TUN_PAN_YSZ / 2) + (TUN_PAN_YSZ / 2));
 
+	/* the fog level and u coordinate are already in place in the LUT entries,
+	 * so each texel is an add and a mask away. 4 pixels per store.
+	 */
 	tun = tunlut + yoffs * TUN_WIDTH + xoffs;
-	pptr = fb;
+	pptr = (uint32_t*)fb;
 	for(i=0; i<200; i++) {
-		for(j=0; j<320; j++) {
-			if(tun->fog >= FX_FOG_LEVELS) {
-				*pptr++ = 0;
-			} else {
-				tx = ((int)tun->x * FX_TEX_SIZE) >> 10;
-				ty = ((int)tun->y * FX_TEX_SIZE) >> 12;
-
-				//tx = (tx + anmt / 2) >> 3;
-				tx >>= 3;
-				ty = (ty + anmt) >> 3;
-
-				tx &= FX_TEX_SIZE - 1;
-				ty &= FX_TEX_SIZE - 1;
+		for(j=0; j<320 / 4; j++) {
+			uint32_t p0 = fogtex[TUN_TEXEL(tun[0], anmt)];
+			uint32_t p1 = fogtex[TUN_TEXEL(tun[1], anmt)];
+			uint32_t p2 = fogtex[TUN_TEXEL(tun[2], anmt)];
+			uint32_t p3 = fogtex[TUN_TEXEL(tun[3], anmt)];
+			*pptr++ = p0 | (p1 << 8) | (p2 << 16) | (p3 << 24);
+			tun += 4;
+		}
+		tun += TUN_WIDTH - 320;
+	}
+}
 
-				*pptr++ = img_tex.pixels[bluroffs + ty * FX_TEX_PITCH + tx] + tun->fog * FX_PAL_SIZE;
+/* builds the fogged texture planes for blur level blursel */
+static void build_fogtex(int blursel)
+{
+	int i, j, k;
+	unsigned char *src, *dest = fogtex;
+
+	for(i=0; i<FX_FOG_LEVELS; i++) {
+		src = img_tex.pixels + blursel * FX_TEX_SIZE;
+		for(j=0; j<FX_TEX_SIZE; j++) {
+			for(k=0; k<FX_TEX_SIZE; k++) {
+				*dest++ = src[k] + i * FX_PAL_SIZE;
 			}
-			tun++;
+			src += FX_TEX_PITCH;
 		}
-		tun += TUN_WIDTH - 320;
 	}
+	memset(dest, 0, FX_TEX_SIZE * FX_TEX_SIZE);
+	fogtex_blur = blursel;
 }
 
-#define TUN_ASPECT	((float)TUN_WIDTH / (float)TUN_HEIGHT)
-static int precalc_tunnel(void)
+/* tries the pre-decoded copy of data/name.png made by tools/imgcache, with the
+ * palette offset already applied. Falls back to the PNG if it fails.
+ */
+static int load_cached_image(struct image *img, const char *name, int col_offs)
 {
-	int i, j;
-	struct tunnel *tun;
+	char fname[64], srcpath[256];
+	unsigned long start = nticks;
+
+	/* datafile returns the same buffer every time */
+	sprintf(fname, "%s.png", name);
+	strncpy(srcpath, datafile(fname), sizeof srcpath - 1);
+	srcpath[sizeof srcpath - 1] = 0;
 
-	if(!(tunlut = malloc(TUN_WIDTH * TUN_HEIGHT * sizeof *tunlut))) {
-		printf("failed to allocate tunnel buffer\n");
+	sprintf(fname, "%s.rimg", name);
+	if(load_image_cache(img, datafile(fname), srcpath, col_offs) == -1) {
 		return -1;
 	}
-	tun = tunlut;
-
-	for(i=0; i<TUN_HEIGHT; i++) {
-		float dy = 2.0f * (float)i / (float)TUN_HEIGHT - 1.0f;
-		for(j=0; j<TUN_WIDTH; j++) {
-			float dx = (2.0f * (float)j / (float)TUN_WIDTH - 1.0f) * TUN_ASPECT;
-			float tu = atan2(dy, dx) / M_PI * 0.5 + 0.5;
-			float r = sqrt(dx * dx + dy * dy);
-			float tv = r == 0.0f ? 65536.0f : 1.0f / r;
+	if(img->bpp != 8) {
+		printf("splash_screen: %s: not an 8bpp image\n", fname);
+		free(img->pixels);
+		img->pixels = 0;
+		return -1;
+	}
+	printf("splash_screen: %s loaded in %lu ms\n", fname, TICKS_TO_MSEC(nticks - start));
+	return 0;
+}
 
-			float dither_tv = tv + (0.8 * ((float)rand() / (float)RAND_MAX) - 0.4);
-			int fog = (int)(dither_tv * 1.15 - 0.25);
-			if(fog < 0) fog = 0;
+/* the tunnel samples a square texture, as tall as the image */
+static void tex_loaded(void)
+{
+	img_tex.width = img_tex.height;
+	setup_tunpal();
+}
 
-			tun->x = (unsigned short)(tu * 65536.0f * FX_TEX_USCALE);
-			tun->y = (unsigned short)(tv * 65536.0f * FX_TEX_VSCALE);
+/* opens the precomputed tunnel LUT and checks its header, the entries are read
+ * a few rows at a time by load_step.
+ */
+static FILE *open_tunlut(const char *fname)
+{
+	FILE *fp;
+	struct tun_header hdr;
 
-			tun->fog = fog >= FX_FOG_LEVELS ? FX_FOG_LEVELS : fog;
-			tun++;
-		}
+	if(!(fp = fopen(fname, "rb"))) {
+		return 0;
 	}
-
-	return 0;
+	if(fread(&hdr, sizeof hdr, 1, fp) < 1 || memcmp(hdr.magic, TUN_MAGIC, 4) != 0 ||
+			hdr.width != TUN_WIDTH || hdr.height != TUN_HEIGHT) {
+		printf("open_tunlut: %s: invalid tunnel LUT\n", fname);
+		fclose(fp);
+		return 0;
+	}
+	return fp;
 }
 
 static void draw_psys(struct emitter *psys, long msec)
 {
 	int i;
-	struct particle *p;
-
-	p = psys->plist;
-	for(i=0; i<psys->pmax; i++) {
-		if(p->life > 0) {
-			int x = p->x;
-			int y = p->y;
-			if(x >= 0 && y >= 0 && x < 320 && y < 200) {
-				unsigned char *pptr = fb + y * 320 + x;
-				int val, pcol = p->col / 3;
-
-				val = *pptr + pcol;
-				*pptr = val > 63 ? 63 : val;
-				pcol >>= 1;
-				val = pptr[1] + pcol;
-				pptr[1] = val > 63 ? 63 : val;
-				val = pptr[-1] + pcol;
-				pptr[-1] = val > 63 ? 63 : val;
-				val = pptr[320] + pcol;
-				pptr[320] = val > 63 ? 63 : val;
-				val = pptr[-320] + pcol;
-				pptr[-320] = val > 63 ? 63 : val;
-			}
+
+	for(i=0; i<psys->pcount; i++) {
+		int x = psys->px[i] >> PSYS_POS_SHIFT;
+		int y = psys->py[i] >> PSYS_POS_SHIFT;
+		if(x >= 0 && y >= 0 && x < 320 && y < 200) {
+			unsigned char *pptr = fb + y * 320 + x;
+			int val, pcol = (psys->pcol[i] >> PSYS_COL_SHIFT) / 3;
+
+			val = *pptr + pcol;
+			*pptr = val > 63 ? 63 : val;
+			pcol >>= 1;
+			val = pptr[1] + pcol;
+			pptr[1] = val > 63 ? 63 : val;
+			val = pptr[-1] + pcol;
+			pptr[-1] = val > 63 ? 63 : val;
+			val = pptr[320] + pcol;
+			pptr[320] = val > 63 ? 63 : val;
+			val = pptr[-320] + pcol;
+			pptr[-320] = val > 63 ? 63 : val;
 		}
-		p++;
 	}
 }
 
 static void setup_psys_cmap(long msec)
 {
-	int i;
-	struct cmapent *col;
-
-	if(msec <= FLAME_FADEIN_DUR) {
-		for(i=0; i<64; i++) {
-			int r = 255 + (firepal[i][0] - 255) * msec / FLAME_FADEIN_DUR;
-			int g = 255 + (firepal[i][1] - 255) * msec / FLAME_FADEIN_DUR;
-			int b = 255 + (firepal[i][2] - 255) * msec / FLAME_FADEIN_DUR;
-			set_pal_entry(i, r, g, b);
-		}
-
-		col = img_ui.cmap;
-		for(i=0; i<img_ui.cmap_ncolors; i++) {
-			int idx = i + UI_COL_OFFS;
-			int r = 255 + (col->r - 255) * msec / FLAME_FADEIN_DUR;
-			int g = 255 + (col->g - 255) * msec / FLAME_FADEIN_DUR;
-			int b = 255 + (col->b - 255) * msec / FLAME_FADEIN_DUR;
-			set_pal_entry(idx, r, g, b);
-			col++;
-		}
-
-		for(i=0; i<30; i++) {
-			int idx = i + TEXT_COL_OFFS;
-			int col = i * 255 / 30;
-			set_pal_entry(idx, col, col, col);
-		}
-
+	if(msec <= FLAME_FADEIN_DUR + FADE_SETTLE) {
+		pal_ramp_set(&flame_fadein, msec * 256 / FLAME_FADEIN_DUR);
 	} else if(msec >= FLAME_FADEOUT_START) {
-		long tm = FLAME_FADEOUT_DUR - msec + FLAME_FADEOUT_START;
-		for(i=0; i<64; i++) {
-			int r = firepal[i][0] * tm / FLAME_FADEOUT_DUR;
-			int g = firepal[i][1] * tm / FLAME_FADEOUT_DUR;
-			int b = firepal[i][2] * tm / FLAME_FADEOUT_DUR;
-			set_pal_entry(i, r, g, b);
-		}
-
-		for(i=0; i<30; i++) {
-			int idx = i + TEXT_COL_OFFS;
-			int col = (i * 255 / 30) * tm / FLAME_FADEOUT_DUR;
-			set_pal_entry(idx, col, col, col);
-		}
+		pal_ramp_set(&flame_fadeout, (msec - FLAME_FADEOUT_START) * 256 / FLAME_FADEOUT_DUR);
 	}
 }
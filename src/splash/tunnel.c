@@ -0,0 +1,68 @@
+/*
+256boss - bootable launcher for 256byte intros
+Copyright (C) 2018-2020  John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY, without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+/* This is also built into tools/tunlut, to generate the LUT file at build
+ * time. Keep it free of anything kernel-specific.
+ */
+#include <stdlib.h>
+#include <math.h>
+#include "tunnel.h"
+
+#define TUN_ASPECT		((float)TUN_WIDTH / (float)TUN_HEIGHT)
+#define TUN_USCALE		0.5
+#define TUN_VSCALE		0.5
+
+void tun_calc_rows(uint32_t *lut, int start, int count)
+{
+	int i, j, end;
+	uint32_t u, v;
+
+	lut += start * TUN_WIDTH;
+
+	end = start + count;
+	if(end > TUN_HEIGHT) end = TUN_HEIGHT;
+
+	for(i=start; i<end; i++) {
+		float dy = 2.0f * (float)i / (float)TUN_HEIGHT - 1.0f;
+		for(j=0; j<TUN_WIDTH; j++) {
+			float dx = (2.0f * (float)j / (float)TUN_WIDTH - 1.0f) * TUN_ASPECT;
+			float tu = atan2(dy, dx) / M_PI * 0.5 + 0.5;
+			float r = sqrt(dx * dx + dy * dy);
+			float tv = r == 0.0f ? 65536.0f : 1.0f / r;
+
+			float dither_tv = tv + (0.8 * ((float)rand() / (float)RAND_MAX) - 0.4);
+			int fog = (int)(dither_tv * 1.15 - 0.25);
+			if(fog < 0) fog = 0;
+
+			if(fog >= TUN_FOG_LEVELS) {
+				/* fully fogged, the texel doesn't matter */
+				*lut++ = (uint32_t)TUN_FOG_LEVELS << TUN_FOG_SHIFT;
+				continue;
+			}
+
+			/* 16.16 texture coordinates, wrapping like the 16bit LUT did */
+			u = (unsigned short)(long)(tu * 65536.0f * TUN_USCALE);
+			v = (unsigned short)(long)(tv * 65536.0f * TUN_VSCALE);
+
+			u = (u * TUN_TEX_SIZE) >> 13;
+			v = (v * TUN_TEX_SIZE) >> 12;
+
+			*lut++ = (v << TUN_VPRE_SHIFT) | ((uint32_t)fog << TUN_FOG_SHIFT) |
+				(u & TUN_U_MASK);
+		}
+	}
+}
@@ -0,0 +1,58 @@
+/*
+256boss - bootable launcher for 256byte intros
+Copyright (C) 2018-2020  John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY, without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef TUNNEL_H_
+#define TUNNEL_H_
+
+#include <inttypes.h>
+
+#define TUN_WIDTH		450
+#define TUN_HEIGHT		300
+
+#define TUN_TEX_SIZE	128
+#define TUN_FOG_LEVELS	6
+
+/* Packed tunnel LUT entry, arranged so that the renderer can form a texel
+ * index into a [fog][v][u] fogged texture with a single add and mask:
+ *
+ *   bits  0-6   u texel coordinate
+ *   bits  7-13  zero, the animated v texel coordinate goes here
+ *   bits 14-16  fog level (TUN_FOG_LEVELS means fully fogged)
+ *   bits 17-31  unanimated v coordinate in 1/8 texel units
+ */
+#define TUN_U_MASK		0x7f
+#define TUN_V_SHIFT		7
+#define TUN_V_MASK		(0x7f << TUN_V_SHIFT)
+#define TUN_FOG_SHIFT	14
+#define TUN_VPRE_SHIFT	17
+
+/* index of the texel for entry e, with the v coordinate advanced by anmt/8 */
+#define TUN_TEXEL(e, anmt) \
+	(((e) & ((1 << TUN_VPRE_SHIFT) - 1)) | \
+	 ((((e) >> (TUN_VPRE_SHIFT - 4)) + ((anmt) << 4)) & TUN_V_MASK))
+
+/* LUT file header, followed by TUN_WIDTH * TUN_HEIGHT little-endian entries */
+struct tun_header {
+	char magic[4];		/* TUN_MAGIC */
+	uint16_t width, height;
+};
+#define TUN_MAGIC	"TUNL"
+
+/* computes count rows of the LUT starting at row start, into lut */
+void tun_calc_rows(uint32_t *lut, int start, int count);
+
+#endif	/* TUNNEL_H_ */
@@ -68,6 +68,14 @@ static struct timer_event *evlist;
 
 
 void init_timer(void)
+{
+	reset_timer_rate();
+
+	/* set the timer interrupt handler */
+	interrupt(IRQ_TO_INTR(0), timer_handler);
+}
+
+void reset_timer_rate(void)
 {
 	/* calculate the reload count: round(osc / freq) */
 	int reload_count = DIV_ROUND(OSC_FREQ_HZ, TICK_FREQ_HZ);
@@ -82,9 +90,6 @@ void init_timer(void)
 	 */
 	outb(reload_count & 0xff, PORT_DATA0);
 	outb((reload_count >> 8) & 0xff, PORT_DATA0);
-
-	/* set the timer interrupt handler */
-	interrupt(IRQ_TO_INTR(0), timer_handler);
 }
 
 void set_alarm(unsigned long msec, void (*func)(void))
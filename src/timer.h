@@ -26,6 +26,8 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 volatile unsigned long nticks;
 
 void init_timer(void);
+/* reprogram the PIT for TICK_FREQ_HZ, after something else changed it */
+void reset_timer_rate(void);
 
 /*
 int sys_sleep(int sec);
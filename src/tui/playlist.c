@@ -0,0 +1,327 @@
+/*
+256boss - bootable launcher for 256byte intros
+Copyright (C) 2018-2020  John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY, without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include "playlist.h"
+#include "comloader.h"
+#include "contty.h"
+#include "video.h"
+#include "keyb.h"
+#include "timer.h"
+#include "asmops.h"
+#include "dynarr.h"
+
+#define NCOLS	80
+#define NROWS	25
+
+/* default time limit for each entry in seconds */
+#define PL_DEF_LIMIT	60
+/* number of entries to keep loaded, counting the current one */
+#define PL_PRELOAD		4
+/* how long to show the title card before each entry, including loading */
+#define PL_CARD_MSEC	3000
+
+#define ATTR_CARD		(WHITE | (BLUE << 4))
+#define ATTR_CARD_DIM	(LTGREY | (BLUE << 4))
+
+struct pl_entry {
+	char *path;
+	unsigned long limit;	/* time limit in milliseconds, 0 for none */
+	void *data;				/* preloaded COM image, or null */
+	int size;
+	int err;				/* failed to load, don't retry */
+};
+
+static int load_playlist(const char *fname);
+static void free_playlist(void);
+static int preload(struct pl_entry *ent);
+static int title_card(int idx, unsigned long start);
+static void draw_card(int idx, int countdown);
+static void print_center(int y, const char *fmt, ...);
+
+static uint16_t *vmem = (uint16_t*)0xb8000;
+
+static struct pl_entry *plist;
+static int num_ents;
+
+
+/* All loading happens while the title card of an entry is up: the entry and
+ * the next few are read into high memory, so starting each one is just a
+ * memcpy into the low memory buffer, with no disk access in between.
+ */
+int playlist_run(const char *fname)
+{
+	int i, j;
+	unsigned long start, end_ticks = 0, switch_msec, gap_msec;
+	struct pl_entry *ent;
+
+	if(load_playlist(fname) == -1) {
+		return -1;
+	}
+	printf("playlist: %s: %d entries\n", fname, num_ents);
+
+	con_scr_disable();
+
+	for(i=0; i<num_ents; i++) {
+		ent = plist + i;
+
+		start = nticks;
+		set_vga_mode(3);
+		/* the mode set resets the CRTC start address, but not the line the
+		 * console thinks the screen starts at after the shell scrolled
+		 */
+		con_clear();
+		con_show_cursor(0);
+		draw_card(i, -1);
+
+		for(j=i; j<num_ents && j<i + PL_PRELOAD; j++) {
+			preload(plist + j);
+		}
+
+		if(title_card(i, start) == -1) {
+			printf("playlist: stopped before entry %d\n", i + 1);
+			break;
+		}
+		if(!ent->data) {
+			printf("playlist: skipping %s\n", ent->path);
+			continue;
+		}
+
+		start = nticks;
+		load_com_image(ent->path, ent->data, ent->size);
+		free(ent->data);
+		ent->data = 0;
+		set_vga_mode(3);
+		switch_msec = TICKS_TO_MSEC(nticks - start);
+		gap_msec = end_ticks ? TICKS_TO_MSEC(nticks - end_ticks) : 0;
+
+		run_com_binary_limit(ent->limit);
+		end_ticks = nticks;
+
+		printf("playlist: %d/%d %s: switch %lu ms, %lu ms since the previous entry, "
+				"ran %lu ms%s\n", i + 1, num_ents, ent->path, switch_msec, gap_msec,
+				com_run_msec, com_timeout ? " (time limit)" : "");
+	}
+
+	free_playlist();
+	return 0;
+}
+
+static int load_playlist(const char *fname)
+{
+	FILE *fp;
+	char buf[256];
+	char *path, *end;
+	long limit;
+	void *tmp;
+	struct pl_entry ent;
+
+	if(!(fp = fopen(fname, "rb"))) {
+		printf("playlist: failed to open: %s\n", fname);
+		return -1;
+	}
+	if(!(plist = dynarr_alloc(0, sizeof *plist))) {
+		fclose(fp);
+		return -1;
+	}
+
+	while(fgets(buf, sizeof buf, fp)) {
+		if((end = strchr(buf, '#'))) {
+			*end = 0;
+		}
+		path = buf;
+		while(*path && isspace(*path)) path++;
+		if(!*path) continue;
+
+		end = path;
+		while(*end && !isspace(*end)) end++;
+
+		limit = PL_DEF_LIMIT;
+		if(*end) {
+			*end++ = 0;
+			while(*end && isspace(*end)) end++;
+			if(*end) {
+				char *endp;
+				limit = strtol(end, &endp, 10);
+				if(endp == end || limit < 0) {
+					printf("playlist: invalid time limit for %s: %s\n", path, end);
+					limit = PL_DEF_LIMIT;
+				}
+			}
+		}
+
+		memset(&ent, 0, sizeof ent);
+		ent.limit = limit * 1000;
+		if(!(ent.path = malloc(strlen(path) + 1))) {
+			goto fail;
+		}
+		strcpy(ent.path, path);
+
+		if(!(tmp = dynarr_push(plist, &ent))) {
+			free(ent.path);
+			goto fail;
+		}
+		plist = tmp;
+	}
+	fclose(fp);
+
+	if(!(num_ents = dynarr_size(plist))) {
+		printf("playlist: %s is empty\n", fname);
+		free_playlist();
+		return -1;
+	}
+	return 0;
+
+fail:
+	printf("playlist: failed to allocate entry\n");
+	num_ents = dynarr_size(plist);
+	free_playlist();
+	fclose(fp);
+	return -1;
+}
+
+static void free_playlist(void)
+{
+	int i;
+
+	for(i=0; i<num_ents; i++) {
+		free(plist[i].path);
+		free(plist[i].data);
+	}
+	dynarr_free(plist);
+	plist = 0;
+	num_ents = 0;
+}
+
+static int preload(struct pl_entry *ent)
+{
+	FILE *fp;
+	long sz;
+	unsigned long start;
+
+	if(ent->data || ent->err) {
+		return ent->data ? 0 : -1;
+	}
+
+	start = nticks;
+	if(!(fp = fopen(ent->path, "rb"))) {
+		printf("playlist: failed to open: %s\n", ent->path);
+		goto err;
+	}
+	sz = filesize(fp);
+	if(sz <= 0 || sz > com_max_size()) {
+		printf("playlist: %s: invalid size: %ld bytes\n", ent->path, sz);
+		goto err;
+	}
+	if(!(ent->data = malloc(sz))) {
+		printf("playlist: failed to allocate %ld bytes for %s\n", sz, ent->path);
+		goto err;
+	}
+	if(fread(ent->data, 1, sz, fp) != sz) {
+		printf("playlist: failed to read: %s\n", ent->path);
+		free(ent->data);
+		ent->data = 0;
+		goto err;
+	}
+	fclose(fp);
+	ent->size = sz;
+
+	printf("playlist: loaded %s: %ld bytes in %lu ms\n", ent->path, sz,
+			TICKS_TO_MSEC(nticks - start));
+	return 0;
+
+err:
+	if(fp) fclose(fp);
+	ent->err = 1;
+	return -1;
+}
+
+/* shows the title card until PL_CARD_MSEC after start, or until a key is
+ * pressed. Returns -1 if the playlist should stop.
+ */
+static int title_card(int idx, unsigned long start)
+{
+	int c, secs, prev_secs = -1;
+	unsigned long end = start + MSEC_TO_TICKS(PL_CARD_MSEC);
+
+	while(nticks < end) {
+		if((c = kb_getkey()) >= 0) {
+			return c == 27 ? -1 : 0;
+		}
+
+		secs = (TICKS_TO_MSEC(end - nticks) + 999) / 1000;
+		if(secs != prev_secs) {
+			draw_card(idx, secs);
+			prev_secs = secs;
+		}
+		halt_cpu();
+	}
+	return 0;
+}
+
+static void draw_card(int idx, int countdown)
+{
+	struct pl_entry *ent = plist + idx;
+	const char *name;
+
+	if((name = strrchr(ent->path, '/'))) {
+		name++;
+	} else {
+		name = ent->path;
+	}
+
+	memset16(vmem, ' ' | (ATTR_CARD << 8), NCOLS * NROWS);
+
+	con_setattr(ATTR_CARD_DIM);
+	print_center(7, "256boss compo playlist - entry %d of %d", idx + 1, num_ents);
+	con_setattr(ATTR_CARD);
+	print_center(10, "%s", name);
+	con_setattr(ATTR_CARD_DIM);
+	if(ent->limit) {
+		print_center(12, "time limit: %lu seconds", ent->limit / 1000);
+	} else {
+		print_center(12, "no time limit");
+	}
+
+	con_setattr(ATTR_CARD);
+	if(countdown < 0) {
+		print_center(15, "loading...");
+	} else {
+		print_center(15, "starting in %d", countdown);
+	}
+
+	con_setattr(ATTR_CARD_DIM);
+	print_center(NROWS - 2, "any key: start now, esc: stop the playlist, esc during an entry skips it");
+}
+
+static void print_center(int y, const char *fmt, ...)
+{
+	va_list ap;
+	char buf[NCOLS + 1];
+	int len;
+
+	va_start(ap, fmt);
+	len = vsnprintf(buf, sizeof buf, fmt, ap);
+	va_end(ap);
+
+	if(len > NCOLS) len = NCOLS;
+	con_printf((NCOLS - len) / 2, y, "%s", buf);
+}
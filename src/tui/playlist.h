@@ -0,0 +1,31 @@
+/*
+256boss - bootable launcher for 256byte intros
+Copyright (C) 2018-2020  John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY, without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef PLAYLIST_H_
+#define PLAYLIST_H_
+
+/* default playlist file name, in the data directory */
+#define PLAYLIST_FILE	"playlist.txt"
+
+/* Run all entries of a playlist back to back. Each line of the playlist file
+ * is a path to a COM file, optionally followed by a time limit in seconds
+ * (0 for none, see PL_DEF_LIMIT for the default). Empty lines and anything
+ * after a # are ignored.
+ */
+int playlist_run(const char *fname);
+
+#endif	/* PLAYLIST_H_ */
@@ -30,6 +30,9 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 #include "panic.h"
 #include "ui/fsview.h"
 #include "txview.h"
+#include "playlist.h"
+#include "datapath.h"
+#include "timer.h"
 #include "util.h"
 
 #define NCOLS	80
@@ -42,6 +45,9 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 #define SIZECOL_LEN	10
 
+/* how long the selection has to rest on a COM file before it's prefetched */
+#define PREFETCH_DELAY	300
+
 #define CHAR_COL(c, fg, bg) \
 	((uint16_t)(c) | ((uint16_t)(fg) << 8) | ((uint16_t)(bg) << 12))
 
@@ -84,6 +90,7 @@ static void draw_frame(const char *title, int x, int y, int w, int h, int colwid
 static void invalidate(int idx);
 
 static void cancel_search(void);
+static void prefetch_sel(void);
 
 static uint16_t *vmem = (uint16_t*)0xb8000;
 static unsigned char orig_attr;
@@ -107,6 +114,9 @@ static int search_len;
 #define MAX_TITLE_LEN	60
 static char top_title[MAX_TITLE_LEN + 1];
 
+static unsigned long last_input;
+static int prefetched;
+
 
 static void init_scr(void)
 {
@@ -151,12 +161,21 @@ int textui(void)
 
 		halt_cpu();
 		while((c = kb_getkey()) >= 0) {
+			last_input = nticks;
+			prefetched = 0;
+
 			/* global overrides for all views */
 			switch(c) {
 			case KB_F3:
 			case KB_F4:
 				break;
 
+			case KB_F6:
+				con_setattr(orig_attr);
+				playlist_run(datafile(PLAYLIST_FILE));
+				init_scr();
+				continue;
+
 			case KB_F8:
 				goto end;
 			}
@@ -175,6 +194,13 @@ int textui(void)
 			dirty &= ~DIRTY_TITLE;
 		}
 		draw_clock();
+
+		/* use the idle time to read the selected intro into the cache */
+		if(!prefetched && keypress == fsview_keypress &&
+				nticks - last_input >= MSEC_TO_TICKS(PREFETCH_DELAY)) {
+			prefetch_sel();
+			prefetched = 1;
+		}
 	}
 
 end:
@@ -353,10 +379,11 @@ static int openfile(const char *path, unsigned int oflags)
 		if(load_com_binary(path) == -1) {
 			return -1;
 		}
+		com_save_screen();
 		con_setattr(orig_attr);
 		set_vga_mode(3);
 		run_com_binary();
-		init_scr();
+		com_restore_screen();
 		return 0;
 	} else {
 		if(txview_open(path) != -1) {
@@ -368,6 +395,19 @@ static int openfile(const char *path, unsigned int oflags)
 	return -1;
 }
 
+static void prefetch_sel(void)
+{
+	struct fsview_dirent *item;
+
+	if(fsview.cursel < 0 || fsview.cursel >= fsview.num_entries) {
+		return;
+	}
+	item = fsview.entries + fsview.cursel;
+	if(item->type == DT_REG && has_suffix(item->name, ".com")) {
+		com_prefetch(item->name);
+	}
+}
+
 static void draw_topbar(void)
 {
 	con_setattr(ATTR_TOPBAR | FG_BRIGHT);
@@ -428,6 +468,7 @@ static const char *infotext[] = {
 	"  text/hex viewer",
 	"*TAB* switches viewer between",
 	"  text and hex modes",
+	"*F6* to run the compo playlist",
 	"*F8* to drop to a debug shell",
 	0
 };
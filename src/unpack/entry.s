@@ -0,0 +1,67 @@
+# 256boss - bootable launcher for 256byte intros
+# Copyright (C) 2018-2019  John Tsiombikas <nuclear@member.fsf.org>
+# 
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+# 
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY, without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+# entry point of the decompressor stage for compressed kernel images.
+# boot2 loads the packed image at main_load_addr and jumps to it in
+# protected mode, just like it does with the uncompressed kernel.
+
+	.code32
+	.section .unpack_entry,"ax"
+
+	.extern unpack
+	.extern _unpack_start
+	.extern _unpack_size
+	.extern _bss_start
+	.extern _bss_size
+
+	.set main_load_addr, 0x100000
+	.equ STACKTOP, 0x80000
+
+	jmp 0f
+
+	# packed image header, see check_packed in boot2.s
+	.align 4
+	.ascii "256Z"
+	.long _unpack_size
+
+0:	cli
+	movl $STACKTOP, %esp
+
+	# we're still running at main_load_addr. Copy ourselves up to our link
+	# address, out of the way of the unpacked kernel, and continue there.
+	cld
+	mov $main_load_addr, %esi
+	mov $_unpack_start, %edi
+	mov $_unpack_size, %ecx
+	shr $2, %ecx
+	rep movsl
+	mov $relocated, %eax
+	jmp *%eax
+
+relocated:
+	# zero the BSS section
+	xor %eax, %eax
+	mov $_bss_start, %edi
+	mov $_bss_size, %ecx
+	shr $2, %ecx
+	rep stosl
+
+	# inflate the kernel image to main_load_addr, and jump to it
+	call unpack
+	mov $main_load_addr, %eax
+	jmp *%eax
+
+	.section .note.GNU-stack,"",@progbits
@@ -0,0 +1,113 @@
+/*
+256boss - bootable launcher for 256byte intros
+Copyright (C) 2018-2019  John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY, without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+/* Decompressor stage for compressed kernel images. Linked separately from
+ * the kernel (see unpack.ld), with just the inflate parts of zlib.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "zlib.h"
+#include "asmops.h"
+
+#define MAIN_LOAD_ADDR	0x100000
+
+/* inflate state and sliding window come to about 40k */
+#define HEAP_SIZE		65536
+
+/* defined in data.s */
+extern unsigned char packed_start[], packed_end[];
+/* defined in the linker script */
+extern unsigned char _unpack_start[];
+
+static void fail(const char *msg);
+
+static unsigned char heap[HEAP_SIZE] __attribute__((aligned(8)));
+static unsigned int heap_top;
+
+
+void unpack(void)
+{
+	z_stream zs;
+	int res;
+
+	zs.zalloc = Z_NULL;
+	zs.zfree = Z_NULL;
+	zs.opaque = Z_NULL;
+	zs.next_in = packed_start;
+	zs.avail_in = packed_end - packed_start;
+
+	/* the unpacked image must not run into us */
+	zs.next_out = (unsigned char*)MAIN_LOAD_ADDR;
+	zs.avail_out = _unpack_start - (unsigned char*)MAIN_LOAD_ADDR;
+
+	/* 15 + 16: max window size, and expect a gzip header */
+	if(inflateInit2(&zs, 15 + 16) != Z_OK) {
+		fail("unpack: failed to initialize inflate");
+	}
+	if((res = inflate(&zs, Z_FINISH)) != Z_STREAM_END) {
+		fail(res == Z_BUF_ERROR ? "unpack: kernel image too large" : "unpack: corrupted kernel image");
+	}
+	/* no need for inflateEnd, the heap goes away with the rest of us */
+}
+
+/* zlib allocations are never freed before we're done, no need for anything
+ * more sophisticated than bumping a pointer
+ */
+void *malloc(size_t sz)
+{
+	void *ptr;
+
+	sz = (sz + 7) & ~7;
+	if(heap_top + sz > HEAP_SIZE) {
+		return 0;
+	}
+	ptr = heap + heap_top;
+	heap_top += sz;
+	return ptr;
+}
+
+void free(void *ptr)
+{
+}
+
+void *memcpy(void *dest, const void *src, size_t n)
+{
+	unsigned char *dptr = dest;
+	const unsigned char *sptr = src;
+
+	while(n-- > 0) {
+		*dptr++ = *sptr++;
+	}
+	return dest;
+}
+
+/* no console at this point, write straight to the bottom line of the text
+ * mode screen, white on red
+ */
+static void fail(const char *msg)
+{
+	uint16_t *vmem = (uint16_t*)0xb8000 + 24 * 80;
+
+	while(*msg) {
+		*vmem++ = 0x4f00 | (unsigned char)*msg++;
+	}
+
+	for(;;) {
+		disable_intr();
+		halt_cpu();
+	}
+}
@@ -0,0 +1,428 @@
+/*
+256boss - bootable launcher for 256byte intros
+Copyright (C) 2018-2019  John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY, without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+/* Virtual 8086 monitor for BIOS calls.
+ *
+ * Instead of dropping back to real mode for every int86 call, the BIOS
+ * handler runs as a v86 task with IOPL 0 and an all-zero I/O permission
+ * bitmap. Port I/O goes straight to the hardware, while the IF-sensitive
+ * instructions (pushf/popf/cli/sti/int/iret) trap to the monitor which
+ * emulates them against a virtual interrupt flag. The real interrupt flag
+ * stays on, so our protected mode IRQ handlers keep running during BIOS
+ * calls, and the PIC never has to be reprogrammed. IRQs without a protected
+ * mode handler are reflected to the real mode IVT handler, which sends its
+ * own EOI. The timer IRQ is both: the kernel tick runs first, and the BIOS
+ * int 8 handler gets every tick that falls due at the BIOS rate of 18.2Hz,
+ * so the BDA tick count and the floppy motor timeout keep going.
+ *
+ * Anything else trapping in v86 mode (mode switches, descriptor table loads,
+ * exceptions) aborts the call, and int86 falls back to int86_rm for that
+ * particular BIOS function from then on.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "config.h"
+#include "v86.h"
+#include "tss.h"
+#include "segm.h"
+#include "asmops.h"
+
+/* real mode stack, same as the one used by int86_rm */
+#define V86_STACK_TOP	0x7be0
+
+#define LINADDR(seg, offs)	(((uint32_t)(seg) << 4) + ((offs) & 0xffff))
+
+/* flags the v86 code doesn't get to change in the real eflags */
+#define VFLAGS_PRIV		(FLAGS_INTR | FLAGS_SIOPL(3) | FLAGS_NTASK)
+#define EFLAGS_RESERVED	2
+
+/* interrupt vectors of the IRQs with the default real mode PIC mapping */
+#define RM_IRQ_VEC(x)	((x) < 8 ? (x) + 8 : (x) + 0x68)
+
+/* PIT input clock, and the reload count the BIOS runs it with */
+#define PIT_OSC_HZ		1193182
+#define BIOS_PIT_RELOAD	65536
+
+#define PIC1_CMD	0x20
+#define PIC2_CMD	0xa0
+#define OCW2_EOI	0x20
+
+/* pushed by the CPU after eflags when interrupting v86 code */
+struct v86_segm {
+	uint32_t esp, ss;
+	uint32_t es, ds, fs, gs;
+} __attribute__((packed));
+
+/* initial v86 state, popped by popal and iret in v86_enter */
+struct v86_frame {
+	struct registers regs;
+	uint32_t eip, cs, eflags;
+	struct v86_segm segm;
+} __attribute__((packed));
+
+/* the I/O permission bitmap covers all 64k ports, and must be followed by a
+ * byte with all bits set
+ */
+struct v86_tss {
+	struct task_state ts;
+	unsigned char iomap[8192];
+	unsigned char iomap_end;
+} __attribute__((packed));
+
+struct vector {
+	uint16_t offs, seg;
+} __attribute__((packed));
+
+static void emulate(struct intr_frame *frm, struct v86_segm *vs);
+static void reflect(struct intr_frame *frm, struct v86_segm *vs, int inum);
+static void deliver_pending(struct intr_frame *frm, struct v86_segm *vs);
+static void finish(int res);
+static uint16_t get_vflags(struct intr_frame *frm);
+static void set_vflags(struct intr_frame *frm, uint16_t flags);
+static void push16(struct v86_segm *vs, uint16_t val);
+static uint16_t pop16(struct v86_segm *vs);
+static uint32_t pop32(struct v86_segm *vs);
+
+/* defined in lowcode.s */
+void int86_rm(int inum, struct int86regs *regs);
+/* defined in v86_asm.s */
+int v86_enter(struct v86_frame *frm, struct task_state *tss);
+void v86_leave(int res);
+extern int v86_exit_stub;
+
+static struct v86_tss tss __attribute__((aligned(16)));
+
+static int enabled;
+static int active;
+static int vif;
+static unsigned int irq_pending;
+static unsigned long bios_tick_acc;
+static struct int86regs result;
+
+/* one bit per interrupt number and AH value, set for BIOS functions which
+ * failed to run in v86 mode
+ */
+static uint32_t blacklist[256 * 256 / 32];
+
+
+void init_v86(void)
+{
+	memset(&tss, 0, sizeof tss);
+	tss.ts.ss0 = selector(SEGM_KDATA, 0);
+	tss.ts.iomap_addr = tss.iomap - (unsigned char*)&tss;
+	tss.iomap_end = 0xff;
+
+	set_tss((uint32_t)&tss);
+
+#ifdef ENABLE_V86
+	enabled = 1;
+#endif
+}
+
+void v86_enable(int onoff)
+{
+	enabled = onoff;
+}
+
+int v86_enabled(void)
+{
+	return enabled;
+}
+
+void int86(int inum, struct int86regs *regs)
+{
+	int func = (inum << 8) | ((regs->eax >> 8) & 0xff);
+
+	/* int86 might get called while a v86 call is in progress, by panic */
+	if(enabled && !active && !(blacklist[func >> 5] & (1 << (func & 0x1f)))) {
+		if(v86_int86(inum, regs) != -1) {
+			return;
+		}
+		printf("v86: int %xh function %xh aborted, falling back to real mode\n",
+				inum, func & 0xff);
+		blacklist[func >> 5] |= 1 << (func & 0x1f);
+	}
+
+	int86_rm(inum, regs);
+}
+
+int v86_int86(int inum, struct int86regs *regs)
+{
+	int res, intr_state;
+	uint16_t *sp;
+	struct v86_frame frm;
+	struct vector *vec = (struct vector*)(inum * 4);
+	uint32_t exit_addr = (uint32_t)&v86_exit_stub;
+
+	memset(&frm, 0, sizeof frm);
+	memcpy(&frm.regs, regs, sizeof frm.regs);
+	frm.segm.es = regs->es;
+	frm.segm.ds = regs->ds;
+	frm.segm.fs = regs->fs;
+	frm.segm.gs = regs->gs;
+
+	/* start with a fake interrupt return frame on the stack, pointing to the
+	 * exit stub, as if the v86 code had executed the int instruction.
+	 */
+	sp = (uint16_t*)V86_STACK_TOP;
+	*--sp = regs->flags;
+	*--sp = exit_addr >> 4;
+	*--sp = exit_addr & 0xf;
+	frm.segm.ss = 0;
+	frm.segm.esp = (uint32_t)sp;
+
+	frm.cs = vec->seg;
+	frm.eip = vec->offs;
+	frm.eflags = EFLAGS_VM | FLAGS_INTR | EFLAGS_RESERVED |
+		(regs->flags & ~(VFLAGS_PRIV | FLAGS_TRAP) & 0xffff);
+
+	vif = 0;
+	irq_pending = 0;
+
+	intr_state = get_intr_flag();
+	disable_intr();
+	active = 1;
+
+	res = v86_enter(&frm, &tss.ts);
+
+	active = 0;
+	set_intr_flag(intr_state);
+
+	if(res == -1) {
+		return -1;
+	}
+	*regs = result;
+	return 0;
+}
+
+void v86_intr(struct intr_frame *frm)
+{
+	struct v86_segm *vs = (struct v86_segm*)(frm + 1);
+
+	if(frm->inum == 13) {
+		/* general protection fault: IOPL-sensitive instruction */
+		emulate(frm, vs);
+		return;
+	}
+
+	if(IS_IRQ(frm->inum)) {
+		/* IRQ without a protected mode handler, pass it on to the BIOS as
+		 * soon as the virtual interrupt flag allows it.
+		 */
+		irq_pending |= 1 << INTR_TO_IRQ(frm->inum);
+		deliver_pending(frm, vs);
+		return;
+	}
+
+	/* any other exception in v86 mode is beyond us */
+	finish(-1);
+}
+
+int v86_timer_tick(struct intr_frame *frm)
+{
+	struct v86_segm *vs = (struct v86_segm*)(frm + 1);
+
+	bios_tick_acc += PIT_OSC_HZ / TICK_FREQ_HZ;
+	if(bios_tick_acc < BIOS_PIT_RELOAD) {
+		return 0;
+	}
+	bios_tick_acc -= BIOS_PIT_RELOAD;
+
+	irq_pending |= 1;
+	deliver_pending(frm, vs);
+	return 1;
+}
+
+static void emulate(struct intr_frame *frm, struct v86_segm *vs)
+{
+	int len = 0, op32 = 0;
+	uint32_t val;
+	unsigned char *ip = (unsigned char*)LINADDR(frm->cs, frm->eip);
+
+	/* skip prefixes, only the operand size prefix matters */
+	while(len < 15) {
+		switch(ip[len]) {
+		case 0x66:
+			op32 = 1;
+			/* fallthrough */
+		case 0x26:
+		case 0x2e:
+		case 0x36:
+		case 0x3e:
+		case 0x64:
+		case 0x65:
+		case 0x67:
+		case 0xf2:
+		case 0xf3:
+			len++;
+			continue;
+		}
+		break;
+	}
+
+	switch(ip[len++]) {
+	case 0x9c:	/* pushf */
+		val = get_vflags(frm);
+		if(op32) {
+			push16(vs, 0);
+		}
+		push16(vs, val);
+		break;
+
+	case 0x9d:	/* popf */
+		val = op32 ? pop32(vs) : pop16(vs);
+		set_vflags(frm, val);
+		break;
+
+	case 0xfa:	/* cli */
+		vif = 0;
+		break;
+
+	case 0xfb:	/* sti */
+		vif = 1;
+		break;
+
+	case 0xcd:	/* int n */
+		frm->eip = (frm->eip + len + 1) & 0xffff;
+		reflect(frm, vs, ip[len]);
+		return;
+
+	case 0xcc:	/* int3 */
+		frm->eip = (frm->eip + len) & 0xffff;
+		reflect(frm, vs, 3);
+		return;
+
+	case 0xcf:	/* iret */
+		if(op32) {
+			frm->eip = pop32(vs) & 0xffff;
+			frm->cs = pop32(vs) & 0xffff;
+			set_vflags(frm, pop32(vs));
+		} else {
+			frm->eip = pop16(vs);
+			frm->cs = pop16(vs);
+			set_vflags(frm, pop16(vs));
+		}
+		deliver_pending(frm, vs);
+		return;
+
+	case 0xf4:	/* hlt */
+		if(ip == (unsigned char*)&v86_exit_stub) {
+			/* the BIOS handler returned to the exit stub, we're done */
+			memcpy(&result, &frm->regs, sizeof frm->regs);
+			result.esp = vs->esp;
+			result.flags = get_vflags(frm);
+			result.es = vs->es;
+			result.ds = vs->ds;
+			result.fs = vs->fs;
+			result.gs = vs->gs;
+			finish(0);
+		}
+		/* the BIOS is waiting for an interrupt. IRQs are enabled anyway, so
+		 * just skip it and let it spin.
+		 */
+		break;
+
+	default:
+		finish(-1);
+	}
+
+	frm->eip = (frm->eip + len) & 0xffff;
+	deliver_pending(frm, vs);
+}
+
+/* push an interrupt frame on the v86 stack, and jump to the real mode handler */
+static void reflect(struct intr_frame *frm, struct v86_segm *vs, int inum)
+{
+	struct vector *vec = (struct vector*)(inum * 4);
+
+	push16(vs, get_vflags(frm));
+	push16(vs, frm->cs);
+	push16(vs, frm->eip);
+
+	vif = 0;
+	frm->eflags &= ~(uint32_t)FLAGS_TRAP;
+	frm->cs = vec->seg;
+	frm->eip = vec->offs;
+}
+
+static void deliver_pending(struct intr_frame *frm, struct v86_segm *vs)
+{
+	int i;
+
+	if(!vif || !irq_pending) return;
+
+	for(i=0; i<16; i++) {
+		if(irq_pending & (1 << i)) {
+			irq_pending &= ~(1 << i);
+			reflect(frm, vs, RM_IRQ_VEC(i));
+			return;
+		}
+	}
+}
+
+static void finish(int res)
+{
+	int i;
+
+	/* IRQs still waiting for the virtual interrupt flag are left in-service
+	 * in the PIC, acknowledge them or they'll never fire again.
+	 */
+	for(i=0; i<16; i++) {
+		if(irq_pending & (1 << i)) {
+			if(i > 7) {
+				outb(OCW2_EOI, PIC2_CMD);
+			}
+			outb(OCW2_EOI, PIC1_CMD);
+		}
+	}
+	irq_pending = 0;
+
+	v86_leave(res);
+}
+
+static uint16_t get_vflags(struct intr_frame *frm)
+{
+	uint16_t flags = frm->eflags & ~VFLAGS_PRIV;
+	return vif ? flags | FLAGS_INTR : flags;
+}
+
+static void set_vflags(struct intr_frame *frm, uint16_t flags)
+{
+	frm->eflags = (frm->eflags & 0xffff0000) | (flags & ~VFLAGS_PRIV) |
+		FLAGS_INTR | EFLAGS_RESERVED;
+	vif = flags & FLAGS_INTR ? 1 : 0;
+}
+
+static void push16(struct v86_segm *vs, uint16_t val)
+{
+	uint16_t sp = vs->esp - 2;
+	*(uint16_t*)LINADDR(vs->ss, sp) = val;
+	vs->esp = (vs->esp & 0xffff0000) | sp;
+}
+
+static uint16_t pop16(struct v86_segm *vs)
+{
+	uint16_t val = *(uint16_t*)LINADDR(vs->ss, vs->esp);
+	vs->esp = (vs->esp & 0xffff0000) | ((vs->esp + 2) & 0xffff);
+	return val;
+}
+
+static uint32_t pop32(struct v86_segm *vs)
+{
+	uint32_t lo = pop16(vs);
+	return lo | ((uint32_t)pop16(vs) << 16);
+}
@@ -0,0 +1,50 @@
+/*
+256boss - bootable launcher for 256byte intros
+Copyright (C) 2018-2019  John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY, without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef V86_H_
+#define V86_H_
+
+#include "intr.h"
+#include "int86.h"
+
+/* virtual 8086 mode bit in eflags */
+#define EFLAGS_VM	(1 << 17)
+
+void init_v86(void);
+
+/* enable/disable running int86 BIOS calls in virtual 8086 mode */
+void v86_enable(int onoff);
+int v86_enabled(void);
+
+/* call a real mode interrupt handler in virtual 8086 mode.
+ * returns -1 if the handler did something the monitor can't emulate, in
+ * which case the call was aborted, and should be retried with int86_rm.
+ */
+int v86_int86(int inum, struct int86regs *regs);
+
+/* called by dispatch_intr for interrupts and exceptions which occured while
+ * executing virtual 8086 code, and don't have a protected mode handler.
+ */
+void v86_intr(struct intr_frame *frm);
+
+/* called by dispatch_intr after the protected mode timer handler, when the
+ * tick interrupted virtual 8086 code. Returns 1 if the tick is passed on to
+ * the BIOS int 8 handler, which then sends the EOI.
+ */
+int v86_timer_tick(struct intr_frame *frm);
+
+#endif	/* V86_H_ */
@@ -0,0 +1,76 @@
+# 256boss - bootable launcher for 256byte intros
+# Copyright (C) 2018-2019  John Tsiombikas <nuclear@member.fsf.org>
+# 
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+# 
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY, without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	# size of struct v86_frame in v86.c: pusha registers, eip, cs, eflags,
+	# and the esp, ss, es, ds, fs, gs popped by iret when returning to v86
+	.set V86_FRAME_SIZE, 68
+
+	.data
+	.align 4
+# kernel stack pointer saved by v86_enter, restored by v86_leave
+saved_esp: .long 0
+
+	.text
+# int v86_enter(struct v86_frame *frm, struct task_state *tss)
+# enters virtual 8086 mode with the register state in frm. Doesn't return
+# until the monitor calls v86_leave, and returns its argument.
+	.global v86_enter
+v86_enter:
+	push %ebp
+	mov %esp, %ebp
+	push %ebx
+	push %esi
+	push %edi
+	mov %esp, saved_esp
+
+	# any interrupt or exception in v86 mode switches to the ring 0 stack
+	# in the TSS (esp0). Point it right here, the frame copied below is
+	# consumed by the iret before anything gets pushed over it.
+	mov 12(%ebp), %eax
+	mov %esp, 4(%eax)
+
+	# copy the frame onto the stack, and iret into v86 mode
+	mov 8(%ebp), %esi
+	sub $V86_FRAME_SIZE, %esp
+	mov %esp, %edi
+	mov $V86_FRAME_SIZE / 4, %ecx
+	cld
+	rep movsl
+	popal
+	iret
+
+# void v86_leave(int res)
+# called by the monitor from the interrupt handler, to abandon the v86 task
+# and return from v86_enter
+	.global v86_leave
+v86_leave:
+	mov 4(%esp), %eax
+	mov saved_esp, %esp
+	pop %edi
+	pop %esi
+	pop %ebx
+	pop %ebp
+	ret
+
+
+	.section .lowtext,"ax"
+	.code16
+	# the v86 call starts with a fake interrupt return frame pointing here
+	# on the stack. The hlt traps to the monitor, which ends the call.
+	.global v86_exit_stub
+v86_exit_stub:
+	hlt
+	jmp v86_exit_stub
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <inttypes.h>
 #include "vbe.h"
@@ -10,6 +11,12 @@
 
 #define MODE_LFB	(1 << 14)
 
+/* vbe_asm.s */
+uint32_t vbe_pmcall(void *func, uint32_t eax, uint32_t ebx, uint32_t ecx,
+		uint32_t edx, void *edi);
+
+static struct vbe_pmif *pmif;
+
 struct vbe_info *vbe_get_info(void)
 {
 	struct vbe_info *info;
@@ -66,6 +73,112 @@ int vbe_set_mode(int mode)
 	return 0;
 }
 
+int vbe_set_disp_start(int x, int y, int func)
+{
+	struct int86regs regs;
+
+	memset(&regs, 0, sizeof regs);
+	regs.eax = 0x4f07;
+	regs.ebx = func;
+	regs.ecx = x;
+	regs.edx = y;
+	int86(0x10, &regs);
+
+	if((regs.eax & 0xffff) != 0x4f) {
+		return -1;
+	}
+	if(func == VBE_DISP_SCHED_DONE) {
+		return regs.ecx & 0xffff ? 1 : 0;
+	}
+	return 0;
+}
+
+int vbe_sched_disp_start(uint32_t addr)
+{
+	struct int86regs regs;
+
+	memset(&regs, 0, sizeof regs);
+	regs.eax = 0x4f07;
+	regs.ebx = VBE_DISP_SCHED;
+	regs.ecx = addr;
+	int86(0x10, &regs);
+
+	if((regs.eax & 0xffff) != 0x4f) {
+		return -1;
+	}
+	return 0;
+}
+
+int vbe_init_pmif(void)
+{
+	static int done_init;
+	struct int86regs regs;
+	uint16_t *ioptr;
+	void *tab;
+	int size;
+
+	if(done_init) {
+		return pmif ? 0 : -1;
+	}
+	done_init = 1;
+
+	memset(&regs, 0, sizeof regs);
+	regs.eax = 0x4f0a;
+	int86(0x10, &regs);
+
+	if((regs.eax & 0xffff) != 0x4f) {
+		return -1;
+	}
+	size = regs.ecx & 0xffff;
+
+	/* the functions are position-independent within the table, and the spec
+	 * recommends running them from a copy in RAM instead of the ROM shadow.
+	 */
+	if(!(tab = malloc(size))) {
+		return -1;
+	}
+	memcpy(tab, (void*)(SEG_ADDR(regs.es) + (regs.edi & 0xffff)), size);
+	pmif = tab;
+
+	if(pmif->iolist_offs) {
+		/* port list terminated by 0xffff, followed by the memory list */
+		ioptr = (uint16_t*)((char*)tab + pmif->iolist_offs);
+		while(*ioptr != 0xffff) ioptr++;
+		if(ioptr[1] != 0xffff) {
+			printf("VBE protected mode interface needs MMIO selectors, not using it\n");
+			free(tab);
+			pmif = 0;
+			return -1;
+		}
+	}
+	return 0;
+}
+
+int vbe_pm_set_disp_start(uint32_t addr, int func)
+{
+	uint32_t res;
+
+	if(func == VBE_DISP_SCHED) {
+		/* scheduled flips take the byte address in ecx */
+		res = vbe_pmcall((char*)pmif + pmif->setdisp_offs, 0x4f07, func, addr, 0, 0);
+	} else {
+		/* the others take it in units of 4 bytes, split across cx and dx */
+		addr >>= 2;
+		res = vbe_pmcall((char*)pmif + pmif->setdisp_offs, 0x4f07, func, addr & 0xffff,
+				addr >> 16, 0);
+	}
+	return (res & 0xffff) == 0x4f ? 0 : -1;
+}
+
+int vbe_pm_set_palette(int idx, int count, struct vbe_palent *pal, int vsync)
+{
+	uint32_t res;
+
+	res = vbe_pmcall((char*)pmif + pmif->setpal_offs, 0x4f09, vsync ? 0x80 : 0, count,
+			idx, pal);
+	return (res & 0xffff) == 0x4f ? 0 : -1;
+}
+
 void print_mode_info(struct vbe_mode_info *mi)
 {
 	static unsigned int maskbits[] = {0, 1, 3, 7, 0xf, 0x1f, 0x3f, 0x7f, 0xff};
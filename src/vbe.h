@@ -6,6 +6,27 @@
 #define VBE_ATTR_LFB	(1 << 7)
 #define VBE_MODE_LFB	(1 << 14)
 
+/* function 4F07h (set display start) subfunctions */
+#define VBE_DISP_SET		0x00
+#define VBE_DISP_SET_VSYNC	0x80
+#define VBE_DISP_SCHED		0x02	/* VBE 3.0: schedule flip, don't wait */
+#define VBE_DISP_SCHED_DONE	0x04	/* VBE 3.0: query scheduled flip status */
+
+/* function 4F09h palette entries, with 6 bits per color channel */
+struct vbe_palent {
+	uint8_t b, g, r, pad;
+} __attribute__((packed));
+
+/* VBE 2.0 protected mode interface table (function 4F0Ah), the offsets are
+ * relative to the start of the table.
+ */
+struct vbe_pmif {
+	uint16_t setwin_offs;
+	uint16_t setdisp_offs;
+	uint16_t setpal_offs;
+	uint16_t iolist_offs;
+} __attribute__((packed));
+
 struct vbe_info {
 	uint8_t sig[4];
 	uint16_t version;
@@ -109,6 +130,22 @@ struct vbe_mode_info *vbe_get_mode_info(int mode);
 
 int vbe_set_mode(int mode);
 
+int vbe_set_disp_start(int x, int y, int func);
+/* VBE 3.0 scheduled flip (VBE_DISP_SCHED), addr is the byte offset of the
+ * display start in video memory.
+ */
+int vbe_sched_disp_start(uint32_t addr);
+
+/* The protected mode interface is copied to RAM and called directly, avoiding
+ * the int86 round trip. It's not used if the BIOS requires a selector for
+ * memory mapped registers. vbe_init_pmif returns -1 when it's unavailable,
+ * and the vbe_pm_* calls must not be used in that case.
+ */
+int vbe_init_pmif(void);
+/* addr is the byte offset of the display start in video memory */
+int vbe_pm_set_disp_start(uint32_t addr, int func);
+int vbe_pm_set_palette(int idx, int count, struct vbe_palent *pal, int vsync);
+
 void print_mode_info(struct vbe_mode_info *modei);
 
 int vbe_get_edid(struct vbe_edid *edid);
@@ -0,0 +1,46 @@
+# 256boss - bootable launcher for 256byte intros
+# Copyright (C) 2018-2019  John Tsiombikas <nuclear@member.fsf.org>
+# 
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+# 
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY, without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+	.text
+	# calls a function of the VBE 2.0 protected mode interface. these expect
+	# the function number and arguments in registers, and ES:EDI pointing to
+	# any buffer argument, which is just our flat data segment.
+	# uint32_t vbe_pmcall(void *func, uint32_t eax, uint32_t ebx, uint32_t ecx,
+	#		uint32_t edx, void *edi)
+	.global vbe_pmcall
+vbe_pmcall:
+	push %ebp
+	mov %esp, %ebp
+	push %ebx
+	push %esi
+	push %edi
+	push %es
+
+	mov %ds, %ax
+	mov %ax, %es
+	mov 12(%ebp), %eax
+	mov 16(%ebp), %ebx
+	mov 20(%ebp), %ecx
+	mov 24(%ebp), %edx
+	mov 28(%ebp), %edi
+	call *8(%ebp)
+
+	pop %es
+	pop %edi
+	pop %esi
+	pop %ebx
+	pop %ebp
+	ret
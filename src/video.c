@@ -16,10 +16,12 @@ You should have received a copy of the GNU General Public License
 along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "video.h"
 #include "vbe.h"
 #include "int86.h"
+#include "fbcon.h"
 
 #define REALPTR(s, o)	(void*)(((uint32_t)(s) << 4) + (uint32_t)(o))
 #define VBEPTR(x)		REALPTR(((x) & 0xffff0000) >> 16, (x) & 0xffff)
@@ -32,29 +34,51 @@ along with this program.  If not, see <https://www.gnu.org/licenses/>.
 	 ((a) == 32 && (b) == 24) || ((a) == 24 && (b) == 32))
 
 
+#define MODE_KEY(w, h)	((unsigned long)(w) | ((unsigned long)(h) << 16))
+
+#define MAX_PAGES	3
+
+
 unsigned int color_mask(int nbits, int pos);
+static int build_mode_table(uint16_t *modes);
+static int modecmp(const void *a, const void *b);
+static void setup_pages(struct video_mode *vm);
+static int show_page(int idx, int func);
 
 static struct vbe_info *vbe_info;
-static uint16_t *modes;
+static int vbe_version, vbe_mem_blocks;	/* vbe_info is in the shared low mem buffer */
+static struct video_mode *modetab;
 static int mode_count;
-static struct vbe_mode_info *mode_info;
+static struct video_mode *curmode;
+
+static unsigned char shadow_pal[256 * 3];
+static int pal_dirty_start = 256, pal_dirty_end;
+
+static int num_pages, front_page, flip_pending;
+static unsigned long page_size;
+static int use_pmif;
 
 void set_vga_mode(int mode)
 {
 	struct int86regs regs;
 
+	fbcon_shutdown();
+
 	memset(&regs, 0, sizeof regs);
 	regs.eax = mode;
 	int86(0x10, &regs);
+
+	curmode = 0;
+	num_pages = 0;
+	use_pmif = 0;
 }
 
 static int init_once(void)
 {
-	int i;
 	static int done_init;
 
 	if(done_init) {
-		return vbe_info && modes ? 0 : -1;
+		return vbe_info && modetab ? 0 : -1;
 	}
 	done_init = 1;
 
@@ -74,58 +98,258 @@ static int init_once(void)
 			(char*)VBEPTR(vbe_info->oem_product_name_ptr), (char*)VBEPTR(vbe_info->oem_product_rev_ptr));
 	printf("Video memory: %dkb\n", vbe_info->total_mem << 6);
 
-	modes = VBEPTR(vbe_info->vid_mode_ptr);
+	vbe_version = vbe_info->version;
+	vbe_mem_blocks = vbe_info->total_mem;
+
+	return build_mode_table(VBEPTR(vbe_info->vid_mode_ptr));
+}
+
+/* query every mode once, so that mode lookups don't need a BIOS call each */
+static int build_mode_table(uint16_t *modes)
+{
+	int i, num;
+	struct vbe_mode_info *inf;
+	struct video_mode *vm;
+
+	num = 0;
+	while(num < 1024 && modes[num] != 0xffff) {	/* upper limit to avoid inf-loops */
+		num++;
+	}
+
+	if(!(modetab = malloc(num * sizeof *modetab))) {
+		printf("failed to allocate video mode table (%d modes)\n", num);
+		return -1;
+	}
 
 	mode_count = 0;
-	for(i=0; i<1024; i++) {	/* impose an upper limit to avoid inf-loops */
-		if(modes[i] == 0xffff) {
-			break;	/* reached the end */
+	for(i=0; i<num; i++) {
+		int mode = modes[i];
+
+		if(!(inf = vbe_get_mode_info(mode | VBE_MODE_LFB))) {
+			continue;
 		}
-		mode_count++;
+		vm = modetab + mode_count++;
+		vm->mode = mode;
+		vm->width = inf->xres;
+		vm->height = inf->yres;
+		vm->bpp = inf->bpp;
+		vm->rbits = inf->rmask_size;
+		vm->gbits = inf->gmask_size;
+		vm->bbits = inf->bmask_size;
+		vm->rshift = inf->rpos;
+		vm->gshift = inf->gpos;
+		vm->bshift = inf->bpos;
+		vm->rmask = color_mask(inf->rmask_size, inf->rpos);
+		vm->gmask = color_mask(inf->gmask_size, inf->gpos);
+		vm->bmask = color_mask(inf->bmask_size, inf->bpos);
+		vm->pitch = inf->scanline_bytes;
+		vm->fb_addr = inf->fb_addr;
 	}
+
+	qsort(modetab, mode_count, sizeof *modetab, modecmp);
 	return 0;
 }
 
+static int modecmp(const void *a, const void *b)
+{
+	const struct video_mode *ma = a;
+	const struct video_mode *mb = b;
+	unsigned long aval = MODE_KEY(ma->width, ma->height);
+	unsigned long bval = MODE_KEY(mb->width, mb->height);
+
+	if(aval != bval) {
+		return aval < bval ? 1 : -1;
+	}
+	return mb->bpp - ma->bpp;
+}
+
 void *set_video_mode(int mode)
 {
+	int i;
+	struct video_mode *vm = 0;
+
 	if(init_once() == -1) return 0;
 	if(mode < 0) return 0;
 
-	if(!(mode_info = vbe_get_mode_info(mode))) {
+	for(i=0; i<mode_count; i++) {
+		if(modetab[i].mode == mode) {
+			vm = modetab + i;
+			break;
+		}
+	}
+	if(!vm) {
+		printf("Video mode %x not in the mode list\n", mode);
 		return 0;
 	}
 
+	fbcon_shutdown();
+
 	if(vbe_set_mode(mode | VBE_MODE_LFB) == -1) {
-		printf("Failed to set video mode %dx%d %dbpp\n", mode_info->xres, mode_info->yres, mode_info->bpp);
+		printf("Failed to set video mode %dx%d %dbpp\n", vm->width, vm->height, vm->bpp);
+		return 0;
+	}
+
+	curmode = vm;
+	setup_pages(vm);
+	return (void*)vm->fb_addr;
+}
+
+/* splits the video memory into up to MAX_PAGES pages of the current mode */
+static void setup_pages(struct video_mode *vm)
+{
+	page_size = (unsigned long)vm->pitch * vm->height;
+	num_pages = ((unsigned long)vbe_mem_blocks << 16) / page_size;
+	if(num_pages > MAX_PAGES) num_pages = MAX_PAGES;
+	if(num_pages < 1) num_pages = 1;
+
+	front_page = 0;
+	flip_pending = 0;
+	use_pmif = vbe_init_pmif() == 0;
+}
+
+int video_page_count(void)
+{
+	return curmode ? num_pages : 0;
+}
+
+void *video_page(int idx)
+{
+	if(!curmode || idx < 0 || idx >= num_pages) {
 		return 0;
 	}
+	return (char*)curmode->fb_addr + idx * page_size;
+}
+
+int video_pmif_active(void)
+{
+	return use_pmif;
+}
+
+static int show_page(int idx, int func)
+{
+	if(use_pmif) {
+		return vbe_pm_set_disp_start(idx * page_size, func);
+	}
+	if(func == VBE_DISP_SCHED) {
+		return vbe_sched_disp_start(idx * page_size);
+	}
+	return vbe_set_disp_start(0, idx * curmode->height, func);
+}
+
+void *page_flip(int vsync)
+{
+	int func, next;
+
+	if(num_pages < 2) {
+		if(vsync) wait_vsync();
+		return video_page(0);
+	}
+	next = (front_page + 1) % num_pages;
+
+	if(vsync && num_pages > 2 && vbe_version >= 0x300) {
+		/* triple buffering: schedule the flip without waiting for the retrace.
+		 * The previous scheduled flip must have happened though, or the page
+		 * we're about to return would still be on screen.
+		 */
+		while(flip_pending && vbe_set_disp_start(0, 0, VBE_DISP_SCHED_DONE) == 0);
+		func = VBE_DISP_SCHED;
+		flip_pending = 1;
+	} else {
+		func = vsync ? VBE_DISP_SET_VSYNC : VBE_DISP_SET;
+	}
+
+	if(show_page(next, func) == -1) {
+		/* can't flip, fall back to drawing on the front page */
+		if(front_page != 0) {
+			show_page(0, VBE_DISP_SET);
+		}
+		num_pages = 1;
+		front_page = 0;
+		return video_page(0);
+	}
+
+	front_page = next;
+	return video_page((next + 1) % num_pages);
+}
+
+int video_pan(int y)
+{
+	if(!curmode) return -1;
+
+	if(use_pmif) {
+		return vbe_pm_set_disp_start((unsigned long)y * curmode->pitch, VBE_DISP_SET);
+	}
+	return vbe_set_disp_start(0, y, VBE_DISP_SET);
+}
+
+int set_palette(int idx, int count, const unsigned char *rgb, int vsync)
+{
+	int i;
+	struct vbe_palent pal[256];
+
+	if(count > 256 - idx) count = 256 - idx;
+
+	if(use_pmif) {
+		for(i=0; i<count; i++) {
+			pal[i].r = rgb[0] >> 2;
+			pal[i].g = rgb[1] >> 2;
+			pal[i].b = rgb[2] >> 2;
+			pal[i].pad = 0;
+			rgb += 3;
+		}
+		if(vbe_pm_set_palette(idx, count, pal, vsync) == 0) {
+			return 0;
+		}
+		rgb -= count * 3;
+	}
 
-	return (void*)mode_info->fb_addr;
+	if(vsync) wait_vsync();
+	for(i=0; i<count; i++) {
+		set_pal_entry(idx + i, rgb[0], rgb[1], rgb[2]);
+		rgb += 3;
+	}
+	return 0;
 }
 
 int find_video_mode_idx(int xsz, int ysz, int bpp)
 {
-	int i, best = -1, best_bpp = 0;
-	struct vbe_mode_info *inf;
+	int i, lo, hi, mid;
+	unsigned long key = MODE_KEY(xsz, ysz);
 
 	if(init_once() == -1) return -1;
 
-	for(i=0; i<mode_count; i++) {
-		inf = vbe_get_mode_info(modes[i] | VBE_MODE_LFB);
-		if(!inf || inf->xres != xsz || inf->yres != ysz) {
-			continue;
-		}
-		if((bpp <= 0 && inf->bpp > best_bpp) || SAME_BPP(inf->bpp, bpp)) {
-			best = i;
-			best_bpp = inf->bpp;
+	/* binary search for the first entry of this resolution (sorted descending) */
+	lo = 0;
+	hi = mode_count;
+	while(lo < hi) {
+		mid = (lo + hi) / 2;
+		if(MODE_KEY(modetab[mid].width, modetab[mid].height) > key) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
 		}
 	}
 
-	if(best == -1) {
-		printf("Requested video mode (%dx%d %dbpp) is unavailable\n", xsz, ysz, bpp);
-		return -1;
+	/* entries of the same resolution follow in order of descending bpp */
+	for(i=lo; i<mode_count; i++) {
+		if(modetab[i].width != xsz || modetab[i].height != ysz) {
+			break;
+		}
+		if(bpp <= 0 || modetab[i].bpp == bpp) {
+			return i;
+		}
 	}
-	return best;
+	for(i=lo; i<mode_count; i++) {
+		if(modetab[i].width != xsz || modetab[i].height != ysz) {
+			break;
+		}
+		if(SAME_BPP(modetab[i].bpp, bpp)) {
+			return i;
+		}
+	}
+
+	printf("Requested video mode (%dx%d %dbpp) is unavailable\n", xsz, ysz, bpp);
+	return -1;
 }
 
 int video_mode_count(void)
@@ -136,59 +360,116 @@ int video_mode_count(void)
 
 int video_mode_info(int n, struct video_mode *vid)
 {
-	struct vbe_mode_info *inf;
-
 	if(init_once() == -1) return -1;
+	if(n < 0 || n >= mode_count) return -1;
 
-	if(!(inf = vbe_get_mode_info(modes[n] | VBE_MODE_LFB))) {
-		return -1;
-	}
-	vid->mode = modes[n];
-	vid->width = inf->xres;
-	vid->height = inf->yres;
-	vid->bpp = inf->bpp;
-	vid->rbits = inf->rmask_size;
-	vid->gbits = inf->gmask_size;
-	vid->bbits = inf->bmask_size;
-	vid->rshift = inf->rpos;
-	vid->gshift = inf->gpos;
-	vid->bshift = inf->bpos;
-	vid->rmask = color_mask(inf->rmask_size, inf->rpos);
-	vid->gmask = color_mask(inf->gmask_size, inf->gpos);
-	vid->bmask = color_mask(inf->bmask_size, inf->bpos);
+	*vid = modetab[n];
 	return 0;
 }
 
+#define MARK_DIRTY(start, end) \
+	do { \
+		if((start) < pal_dirty_start) pal_dirty_start = (start); \
+		if((end) > pal_dirty_end) pal_dirty_end = (end); \
+	} while(0)
+
+void pal_set(int idx, int r, int g, int b)
+{
+	unsigned char *dest = shadow_pal + idx * 3;
+
+	dest[0] = r >> 2;
+	dest[1] = g >> 2;
+	dest[2] = b >> 2;
+	MARK_DIRTY(idx, idx + 1);
+}
+
+void pal_set_range(int idx, int count, const unsigned char *rgb)
+{
+	int i;
+	unsigned char *dest = shadow_pal + idx * 3;
+
+	if(count > 256 - idx) count = 256 - idx;
+
+	for(i=0; i<count * 3; i++) {
+		*dest++ = *rgb++ >> 2;
+	}
+	MARK_DIRTY(idx, idx + count);
+}
+
+void pal_commit(int vsync)
+{
+	if(pal_dirty_start >= pal_dirty_end) {
+		return;
+	}
+
+	if(vsync) wait_vsync();
+	pal_upload(pal_dirty_start, pal_dirty_end - pal_dirty_start, shadow_pal + pal_dirty_start * 3);
+
+	pal_dirty_start = 256;
+	pal_dirty_end = 0;
+}
+
+void pal_ramp_init(struct pal_ramp *ramp, int idx, int count, const unsigned char *from,
+		const unsigned char *to)
+{
+	int i, a, b;
+
+	if(count > 256 - idx) count = 256 - idx;
+	ramp->idx = idx;
+	ramp->count = count;
+
+	for(i=0; i<count * 3; i++) {
+		a = from ? from[i] >> 2 : 0;
+		b = to ? to[i] >> 2 : 0;
+		ramp->from[i] = a << 8;
+		ramp->delta[i] = b - a;
+	}
+}
+
+void pal_ramp_set(struct pal_ramp *ramp, int t)
+{
+	int i;
+	unsigned char *dest = shadow_pal + ramp->idx * 3;
+
+	if(t < 0) t = 0;
+	if(t > 256) t = 256;
+
+	for(i=0; i<ramp->count * 3; i++) {
+		*dest++ = (ramp->from[i] + ramp->delta[i] * t) >> 8;
+	}
+	MARK_DIRTY(ramp->idx, ramp->idx + ramp->count);
+}
+
 int get_color_bits(int *rbits, int *gbits, int *bbits)
 {
-	if(!mode_info) {
+	if(!curmode) {
 		return -1;
 	}
-	*rbits = mode_info->rmask_size;
-	*gbits = mode_info->gmask_size;
-	*bbits = mode_info->bmask_size;
+	*rbits = curmode->rbits;
+	*gbits = curmode->gbits;
+	*bbits = curmode->bbits;
 	return 0;
 }
 
 int get_color_mask(unsigned int *rmask, unsigned int *gmask, unsigned int *bmask)
 {
-	if(!mode_info) {
+	if(!curmode) {
 		return -1;
 	}
-	*rmask = color_mask(mode_info->rmask_size, mode_info->rpos);
-	*gmask = color_mask(mode_info->gmask_size, mode_info->gpos);
-	*bmask = color_mask(mode_info->bmask_size, mode_info->bpos);
+	*rmask = curmode->rmask;
+	*gmask = curmode->gmask;
+	*bmask = curmode->bmask;
 	return 0;
 }
 
 int get_color_shift(int *rshift, int *gshift, int *bshift)
 {
-	if(!mode_info) {
+	if(!curmode) {
 		return -1;
 	}
-	*rshift = mode_info->rpos;
-	*gshift = mode_info->gpos;
-	*bshift = mode_info->bpos;
+	*rshift = curmode->rshift;
+	*gshift = curmode->gshift;
+	*bshift = curmode->bshift;
 	return 0;
 }
 
@@ -207,5 +488,5 @@ const char *get_video_vendor(void)
 int get_video_mem_size(void)
 {
 	if(init_once() == -1) return 0;
-	return vbe_info->total_mem << 6;
+	return vbe_mem_blocks << 6;
 }
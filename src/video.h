@@ -25,6 +25,8 @@ struct video_mode {
 	int rbits, gbits, bbits;
 	int rshift, gshift, bshift;
 	unsigned int rmask, gmask, bmask;
+	int pitch;					/* bytes per scanline */
+	unsigned long fb_addr;		/* physical address of the linear framebuffer */
 };
 
 void set_vga_mode(int mode);
@@ -32,9 +34,54 @@ void set_vga_mode(int mode);
 void *set_video_mode(int mode);
 int find_video_mode_idx(int xsz, int ysz, int bpp);
 
+/* the mode table is built once on first use, sorted by descending resolution
+ * and color depth. mode indices refer to this table.
+ */
 int video_mode_count(void);
 int video_mode_info(int n, struct video_mode *vid);
 
+/* Multiple buffering in video memory. After set_video_mode, page 0 is shown
+ * and page 1 is the first one to draw into. page_flip shows the page drawn
+ * so far and returns the next one to draw into (the front page if there's not
+ * enough video memory). With vsync the flip happens at the vertical retrace,
+ * scheduled without blocking if there are 3 pages and VBE 3.0 is available.
+ */
+int video_page_count(void);
+void *video_page(int idx);
+void *page_flip(int vsync);
+/* non-zero if flips and palette loads use the VBE protected mode interface */
+int video_pmif_active(void);
+
+/* shows the framebuffer starting from scanline y, which can be past the
+ * first page, as long as it fits in video memory.
+ */
+int video_pan(int y);
+
+/* loads count palette entries (8bit r,g,b triplets) starting from idx */
+int set_palette(int idx, int count, const unsigned char *rgb, int vsync);
+
+/* Palette staging: changes are made to a shadow palette, and pal_commit
+ * uploads the span of entries changed since the last commit in one burst.
+ * Colors are given with 8 bits per channel.
+ */
+void pal_set(int idx, int r, int g, int b);
+void pal_set_range(int idx, int count, const unsigned char *rgb);
+/* with vsync, waits for the vertical retrace before uploading. Call with 0
+ * right after wait_vsync if the frame waits for it anyway.
+ */
+void pal_commit(int vsync);
+
+/* precomputed linear fade between two sets of colors */
+struct pal_ramp {
+	int idx, count;
+	short from[256 * 3], delta[256 * 3];	/* in 6bit DAC units, times 256 */
+};
+/* from/to are r,g,b triplets, a null pointer means all black */
+void pal_ramp_init(struct pal_ramp *ramp, int idx, int count, const unsigned char *from,
+		const unsigned char *to);
+/* stages the colors at position t in [0, 256] of the ramp */
+void pal_ramp_set(struct pal_ramp *ramp, int t);
+
 int get_color_bits(int *rbits, int *gbits, int *bbits);
 int get_color_mask(unsigned int *rmask, unsigned int *gmask, unsigned int *bmask);
 int get_color_shift(int *rshift, int *gshift, int *bshift);
@@ -45,5 +92,7 @@ int get_video_mem_size(void);
 /* defined in video_asm.s */
 void wait_vsync(void);
 void set_pal_entry(unsigned char idx, unsigned char r, unsigned char g, unsigned char b);
+/* uploads count entries of 6bit r,g,b triplets starting from idx */
+void pal_upload(int idx, int count, const unsigned char *rgb6);
 
 #endif	/* VIDEO_H_ */
@@ -42,3 +42,18 @@ set_pal_entry:
 	shr $2, %al
 	out %al, %dx
 	ret
+
+	# void pal_upload(int idx, int count, const unsigned char *rgb6)
+	.global pal_upload
+pal_upload:
+	push %esi
+	mov 8(%esp), %eax
+	mov $0x3c8, %dx
+	out %al, %dx
+	inc %dx
+	mov 12(%esp), %ecx
+	lea (%ecx,%ecx,2), %ecx
+	mov 16(%esp), %esi
+	rep outsb
+	pop %esi
+	ret
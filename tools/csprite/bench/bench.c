@@ -0,0 +1,162 @@
+/* host benchmark of the generated sprite code against a generic span (RLE)
+ * blitter, built with make bench (x86-64 only).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "image.h"
+#include "spans.h"
+
+#define FB_WIDTH	320
+#define FB_HEIGHT	200
+#define COFFS		64
+
+typedef void (*blitfunc)(void*, int, int, int);
+
+void bos48(void *fb, int x, int y, int idx);
+void bos64(void *fb, int x, int y, int idx);
+void bos96(void *fb, int x, int y, int idx);
+void bos128(void *fb, int x, int y, int idx);
+void bos48_clip(void *fb, int x, int y, int idx);
+void bos64_clip(void *fb, int x, int y, int idx);
+void bos96_clip(void *fb, int x, int y, int idx);
+void bos128_clip(void *fb, int x, int y, int idx);
+
+/* same sprites as the kernel Makefile */
+static struct {
+	const char *name;
+	int w, h;
+	int rx, ry;
+	blitfunc draw, draw_clip;
+	struct spimage spr;
+} sprites[] = {
+	{"bos48", 30, 48, 120, 224, bos48, bos48_clip},
+	{"bos64", 40, 64, 0, 224, bos64, bos64_clip},
+	{"bos96", 60, 96, 0, 128, bos96, bos96_clip},
+	{"bos128", 80, 128, 0, 0, bos128, bos128_clip}
+};
+#define NUM_SPRITES	(sizeof sprites / sizeof *sprites)
+
+static unsigned char fb[FB_WIDTH * FB_HEIGHT], fbref[FB_WIDTH * FB_HEIGHT];
+
+/* the generic blitter: walks the opaque spans, clipping each one */
+static void rle_blit(unsigned char *fb, int x, int y, struct spimage *spr)
+{
+	int i, j, sx, ex, y0, y1;
+	struct sprow *row;
+	struct span *span;
+	unsigned char *dest;
+
+	y0 = y < 0 ? -y : 0;
+	y1 = y + spr->height > FB_HEIGHT ? FB_HEIGHT - y : spr->height;
+
+	for(i=y0; i<y1; i++) {
+		row = spr->rows + i;
+		dest = fb + (y + i) * FB_WIDTH + x;
+		for(j=0; j<row->nspans; j++) {
+			span = row->spans + j;
+			sx = span->x;
+			ex = sx + span->len;
+			if(x + sx < 0) sx = -x;
+			if(x + ex > FB_WIDTH) ex = FB_WIDTH - x;
+			if(sx < ex) {
+				memcpy(dest + sx, span->pix + sx - span->x, ex - sx);
+			}
+		}
+	}
+}
+
+static long nsec(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+#define ITER	200000
+
+int main(int argc, char **argv)
+{
+	int i, j, x, y, nfail = 0;
+	long t0, t[5];
+	struct image img;
+	const char *fname = argc > 1 ? argv[1] : "../../data/bos.png";
+
+	if(load_image(&img, fname) == -1) {
+		fprintf(stderr, "failed to load %s\n", fname);
+		return 1;
+	}
+
+	for(i=0; i<NUM_SPRITES; i++) {
+		if(build_spans(&sprites[i].spr, &img, sprites[i].rx, sprites[i].ry, sprites[i].w,
+					sprites[i].h, 0, COFFS) == -1) {
+			return 1;
+		}
+	}
+
+	/* the generated code must draw exactly what the span blitter draws,
+	 * including clipped at every edge.
+	 */
+	for(i=0; i<NUM_SPRITES; i++) {
+		int w = sprites[i].w, h = sprites[i].h;
+		for(y=-h; y<=FB_HEIGHT; y+=7) {
+			for(x=-w; x<=FB_WIDTH; x+=5) {
+				memset(fb, 0, sizeof fb);
+				memset(fbref, 0, sizeof fbref);
+				sprites[i].draw_clip(fb, x, y, 0);
+				rle_blit(fbref, x, y, &sprites[i].spr);
+				if(memcmp(fb, fbref, sizeof fb) != 0 && nfail++ < 10) {
+					fprintf(stderr, "%s_clip mismatch at %d,%d\n", sprites[i].name, x, y);
+				}
+				if(x >= 0 && y >= 0 && x + w <= FB_WIDTH && y + h <= FB_HEIGHT) {
+					memset(fb, 0, sizeof fb);
+					sprites[i].draw(fb, x, y, 0);
+					if(memcmp(fb, fbref, sizeof fb) != 0 && nfail++ < 10) {
+						fprintf(stderr, "%s mismatch at %d,%d\n", sprites[i].name, x, y);
+					}
+				}
+			}
+		}
+	}
+	if(nfail) {
+		fprintf(stderr, "%d mismatches\n", nfail);
+		return 1;
+	}
+
+	printf("ns per sprite    compiled   clip(in)  clip(edge)   span(in) span(edge)\n");
+	for(i=0; i<NUM_SPRITES; i++) {
+		struct spimage *spr = &sprites[i].spr;
+		int w = sprites[i].w;
+
+		x = (FB_WIDTH - w) / 2;
+		y = (FB_HEIGHT - sprites[i].h) / 2;
+
+		t0 = nsec();
+		for(j=0; j<ITER; j++) sprites[i].draw(fb, x, y, 0);
+		t[0] = nsec() - t0;
+
+		t0 = nsec();
+		for(j=0; j<ITER; j++) sprites[i].draw_clip(fb, x, y, 0);
+		t[1] = nsec() - t0;
+
+		t0 = nsec();
+		for(j=0; j<ITER; j++) sprites[i].draw_clip(fb, -w / 2, y, 0);
+		t[2] = nsec() - t0;
+
+		t0 = nsec();
+		for(j=0; j<ITER; j++) rle_blit(fb, x, y, spr);
+		t[3] = nsec() - t0;
+
+		t0 = nsec();
+		for(j=0; j<ITER; j++) rle_blit(fb, -w / 2, y, spr);
+		t[4] = nsec() - t0;
+
+		printf("%-6s %dx%d", sprites[i].name, w, sprites[i].h);
+		for(j=0; j<5; j++) {
+			printf(" %10.1f", (double)t[j] / ITER);
+		}
+		putchar('\n');
+	}
+	return 0;
+}
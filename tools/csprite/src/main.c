@@ -2,23 +2,39 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
-#include <assert.h>
-#include <alloca.h>
 #include "image.h"
+#include "spans.h"
 
 struct rect {
 	int x, y, w, h;
 };
 
-int csprite(struct image *img, int x, int y, int xsz, int ysz);
+int csprite(struct spimage *tile, int tidx, int clip);
+int csprite_clip(struct spimage *tiles, int ntiles);
 int proc_sheet(const char *fname);
 void print_usage(const char *argv0);
+static void emit_span(struct span *span, int disp);
+static void emit_span_data(struct span *span);
+
+/* pointer-sized registers and data, depending on the target */
+#define REG_AX		(x64 ? "%rax" : "%eax")
+#define REG_BX		(x64 ? "%rbx" : "%ebx")
+#define REG_CX		(x64 ? "%rcx" : "%ecx")
+#define REG_DX		(x64 ? "%rdx" : "%edx")
+#define REG_SI		(x64 ? "%rsi" : "%esi")
+#define REG_DI		(x64 ? "%rdi" : "%edi")
+#define REG_BP		(x64 ? "%rbp" : "%ebp")
+#define REG_SP		(x64 ? "%rsp" : "%esp")
+#define DATA_PTR	(x64 ? ".quad" : ".long")
 
 int tile_xsz, tile_ysz;
 struct rect rect;
 int cmap_offs;
 int ckey;
 int fbpitch = 320;
+int fbheight = 200;
+int gen_clip;
+int x64;
 const char *name = "sprite";
 
 int main(int argc, char **argv)
@@ -56,6 +72,19 @@ int main(int argc, char **argv)
 					return 1;
 				}
 
+			} else if(strcmp(argv[i], "-fbheight") == 0) {
+				fbheight = atoi(argv[++i]);
+				if(fbheight <= 0) {
+					fprintf(stderr, "-fbheight must be followed by a positive number\n");
+					return 1;
+				}
+
+			} else if(strcmp(argv[i], "-clip") == 0) {
+				gen_clip = 1;
+
+			} else if(strcmp(argv[i], "-m64") == 0) {
+				x64 = 1;
+
 			} else if(strcmp(argv[i], "-n") == 0 || strcmp(argv[i], "-name") == 0) {
 				name = argv[++i];
 				if(!name) {
@@ -103,10 +132,27 @@ const char *prefixfmt =
 	"\tjmp *tiletab(,%%eax,4)\n\n"
 	"tiletab:\n";
 
+/* x86-64 System V version, for the host benchmark: fb in rdi, x in esi,
+ * y in edx, tile index in ecx.
+ */
+const char *prefixfmt64 =
+	"\t.global %s\n"
+	"%s:\n"
+	"\tmovslq %%edx, %%rax\n"
+	"\timul $%d, %%rax, %%rax\n"
+	"\tadd %%rdi, %%rax\n"
+	"\tmovslq %%esi, %%rsi\n"
+	"\tadd %%rsi, %%rax\n"
+	"\tmov %%rax, %%rdx\n"
+	"\tmovslq %%ecx, %%rcx\n"
+	"\tjmp *tiletab(,%%rcx,8)\n\n"
+	"tiletab:\n";
+
 int proc_sheet(const char *fname)
 {
-	int i, j, num_xtiles, num_ytiles, xsz, ysz, tidx;
+	int i, j, num_xtiles, num_ytiles, xsz, ysz, ntiles;
 	struct image img;
+	struct spimage *tiles;
 
 	if(load_image(&img, fname) == -1) {
 		fprintf(stderr, "failed to load image: %s\n", fname);
@@ -127,150 +173,283 @@ int proc_sheet(const char *fname)
 		xsz = tile_xsz;
 		ysz = tile_ysz;
 	}
+	ntiles = num_xtiles * num_ytiles;
 
-	printf(prefixfmt, name, name, fbpitch);
-	for(i=0; i<num_ytiles*num_xtiles; i++) {
-		printf("\t.long tile%d\n", i);
+	if(!(tiles = calloc(ntiles, sizeof *tiles))) {
+		perror("failed to allocate tiles");
+		return -1;
 	}
-	putchar('\n');
-
-	tidx = 0;
 	for(i=0; i<num_ytiles; i++) {
 		for(j=0; j<num_xtiles; j++) {
-			printf("tile%d:\n", tidx++);
-			csprite(&img, rect.x + j * xsz, rect.y + i * ysz, xsz, ysz);
+			if(build_spans(tiles + i * num_xtiles + j, &img, rect.x + j * xsz,
+						rect.y + i * ysz, xsz, ysz, ckey, cmap_offs) == -1) {
+				return -1;
+			}
 		}
 	}
 
-	return 0;
-}
-
-enum {
-	CSOP_SKIP,
-	CSOP_FILL,
-	CSOP_COPY,
-	CSOP_ENDL
-};
+	printf(x64 ? prefixfmt64 : prefixfmt, name, name, fbpitch);
+	for(i=0; i<ntiles; i++) {
+		printf("\t%s tile%d\n", DATA_PTR, i);
+	}
+	putchar('\n');
 
-struct csop {
-	unsigned char op, val;
-	int len;
-};
+	for(i=0; i<ntiles; i++) {
+		printf("tile%d:\n", i);
+		csprite(tiles + i, i, 0);
+	}
 
-int csprite(struct image *img, int x, int y, int xsz, int ysz)
-{
-	int i, j, numops, mode, new_mode, start, skip_acc;
-	unsigned char *pptr = img->pixels + y * img->scansz + x;
-	struct csop *ops, *optr;
-	uint32_t packed;
+	if(gen_clip) {
+		csprite_clip(tiles, ntiles);
+	}
+	if(x64) {
+		/* the host linker wants to know the stack doesn't need to be executable */
+		printf("\n\t.section .note.GNU-stack,\"\",@progbits\n");
+	}
 
-	ops = optr = alloca((xsz + 1) * ysz * sizeof *ops);
+	for(i=0; i<ntiles; i++) {
+		free_spans(tiles + i);
+	}
+	free(tiles);
+	return 0;
+}
 
-	for(i=0; i<ysz; i++) {
-		mode = -1;
-		start = -1;
+/* emits the stores for a span, at displacement disp from edx */
+static void emit_span(struct span *span, int disp)
+{
+	int i;
+	unsigned char *pptr = span->pix;
 
-		if(i > 0) {
-			optr++->op = CSOP_ENDL;
-		}
+	for(i=0; i<span->len - 3; i+=4) {
+		printf("\tmovl $0x%x, %d(%s)\n", pptr[0] | (pptr[1] << 8) | (pptr[2] << 16) |
+				((uint32_t)pptr[3] << 24), disp + i, REG_DX);
+		pptr += 4;
+	}
+	if(span->len - i >= 2) {
+		printf("\tmovw $0x%x, %d(%s)\n", pptr[0] | (pptr[1] << 8), disp + i, REG_DX);
+		pptr += 2;
+		i += 2;
+	}
+	if(i < span->len) {
+		printf("\tmovb $0x%x, %d(%s)\n", *pptr, disp + i, REG_DX);
+	}
+}
 
-		for(j=0; j<xsz; j++) {
-			if(*pptr == ckey) {
-				new_mode = CSOP_SKIP;
-			} else {
-				new_mode = CSOP_COPY;
+/* Emits the code which draws a tile, with edx pointing to its top-left corner
+ * in the framebuffer. Stores are addressed relative to edx, which is only
+ * advanced when the next span would fall out of the short (8bit) displacement
+ * range, so most spans don't need an add.
+ *
+ * For the clipped variant, every row gets an entry point with edx at the
+ * start of the row, and ends by decrementing the row count in ecx.
+ */
+int csprite(struct spimage *tile, int tidx, int clip)
+{
+	int i, j, offs, target, rowoffs;
+	struct sprow *row;
+	struct span *span;
+
+	offs = 0;	/* edx relative to the top-left corner */
+	for(i=0; i<tile->height; i++) {
+		row = tile->rows + i;
+		rowoffs = i * fbpitch;
+
+		if(clip) {
+			if(offs != rowoffs) {
+				printf("\tadd $%d, %s\n", rowoffs - offs, REG_DX);
+				offs = rowoffs;
 			}
+			printf("ctile%d_r%d:\n", tidx, i);
+		}
 
-			if(new_mode != mode) {
-				if(mode != -1) {
-					assert(start >= 0);
-					optr->op = mode;
-					optr->len = j - start;
-					optr++;
-				}
-				mode = new_mode;
-				start = j;
+		for(j=0; j<row->nspans; j++) {
+			span = row->spans + j;
+			target = rowoffs + span->x;
+			if(target - offs < -128 || target + span->len - offs > 128) {
+				printf("\tadd $%d, %s\n", target - offs, REG_DX);
+				offs = target;
 			}
-			pptr++;
+			emit_span(span, target - offs);
 		}
-		pptr += img->scansz - xsz;
 
-		if(mode != -1) {
-			assert(start >= 0);
-			optr->op = mode;
-			optr->len = xsz - start;
-			optr++;
+		if(clip) {
+			printf("\tdec %%ecx\n");
+			printf("\tjz %s_clip_done\n", name);
 		}
 	}
-	numops = optr - ops;
-
-	pptr = img->pixels + y * img->scansz + x;
-	optr = ops;
-	skip_acc = 0;
-	/* edx points to dest */
-	for(i=0; i<numops; i++) {
-		switch(optr->op) {
-		case CSOP_SKIP:
-			skip_acc += optr->len;
-			pptr += optr->len;
-			break;
-
-		case CSOP_ENDL:
-			skip_acc += fbpitch - xsz;
-			pptr += img->scansz - xsz;
-			break;
-
-		case CSOP_COPY:
-			if(skip_acc) {
-				printf("\tadd $%d, %%edx\n", skip_acc);
-				skip_acc = 0;
-			}
-
-			for(j=0; j<optr->len / 4; j++) {
-				packed = *(uint32_t*)pptr;
-				if(cmap_offs) {
-					uint8_t *p = (uint8_t*)&packed;
-					p[0] += cmap_offs;
-					p[1] += cmap_offs;
-					p[2] += cmap_offs;
-					p[3] += cmap_offs;
-				}
-				printf("\tmovl $0x%x, %d(%%edx)\n", packed, j * 4);
-				pptr += 4;
-			}
-			j *= 4;
-			switch(optr->len % 4) {
-			case 3:
-				printf("\tmovb $0x%x, %d(%%edx)\n", ((unsigned int)*pptr++ + cmap_offs) & 0xff, j++);
-			case 2:
-				packed = *(uint16_t*)pptr & 0xffff;
-				if(cmap_offs) {
-					uint8_t *p = (uint8_t*)&packed;
-					p[0] += cmap_offs;
-					p[1] += cmap_offs;
-				}
-				printf("\tmovw $0x%x, %d(%%edx)\n", packed, j);
-				pptr += 2;
-				j += 2;
-				break;
-			case 1:
-				printf("\tmovb $0x%x, %d(%%edx)\n", ((unsigned int)*pptr++ + cmap_offs) & 0xff, j++);
-				break;
-			}
+	if(!clip) {
+		printf("\tret\n");
+	}
+	return 0;
+}
 
-			skip_acc = optr->len;
-			break;
+/* Emits <name>_clip(fb, x, y, tile), which clips against a fbpitch by
+ * fbheight framebuffer. Vertical clipping enters the compiled code at the
+ * first visible row, with the number of visible rows in ecx. If the sprite
+ * crosses the left or right edge it's drawn from the span tables instead,
+ * since compiled code can't skip pixels.
+ */
+int csprite_clip(struct spimage *tiles, int ntiles)
+{
+	int i, j, k;
+	int xsz = tiles->width, ysz = tiles->height;
+	int wsz = x64 ? 8 : 4;
+	struct sprow *row;
+
+	printf("\n\t.global %s_clip\n", name);
+	printf("%s_clip:\n", name);
+	printf("\tpush %s\n\tpush %s\n\tpush %s\n\tpush %s\n", REG_BP, REG_BX, REG_SI, REG_DI);
+	/* ebx: y, ecx: x, edi: fb, eax: tile */
+	if(x64) {
+		printf("\tmov %%ecx, %%eax\n");
+		printf("\tmov %%edx, %%ebx\n");
+		printf("\tmov %%esi, %%ecx\n");
+	} else {
+		printf("\tmov 28(%%esp), %%ebx\n");
+		printf("\tmov 24(%%esp), %%ecx\n");
+		printf("\tmov 20(%%esp), %%edi\n");
+		printf("\tmov 32(%%esp), %%eax\n");
+	}
+	/* edx: tile table entry, esi: first visible row, ebp: visible rows */
+	printf("\tmov %%eax, %%edx\n");
+	printf("\tshl $%d, %%edx\n", x64 ? 4 : 3);
+	printf("\tadd $%s_ctab, %s\n", name, REG_DX);
+	printf("\txor %%esi, %%esi\n");
+	printf("\ttest %%ebx, %%ebx\n");
+	printf("\tjns 0f\n");
+	printf("\tmov %%ebx, %%esi\n");
+	printf("\tneg %%esi\n");
+	printf("0:\tmov $%d, %%ebp\n", fbheight);
+	printf("\tsub %%ebx, %%ebp\n");
+	printf("\tcmp $%d, %%ebp\n", ysz);
+	printf("\tjle 0f\n");
+	printf("\tmov $%d, %%ebp\n", ysz);
+	printf("0:\tsub %%esi, %%ebp\n");
+	printf("\tjle %s_clip_done\n", name);
+	/* eax: first visible row in the framebuffer, at the sprite's x */
+	printf("\tlea (%%ebx,%%esi), %%eax\n");
+	printf("\timul $%d, %%eax, %%eax\n", fbpitch);
+	printf("\tadd %s, %s\n", REG_DI, REG_AX);
+	if(x64) {
+		printf("\tmovslq %%ecx, %%rbx\n");
+		printf("\tadd %%rbx, %%rax\n");
+	} else {
+		printf("\tadd %%ecx, %%eax\n");
+	}
+	printf("\tmov %s, %s\n", REG_DX, REG_BX);
+	printf("\tmov %s, %s\n", REG_AX, REG_DX);
+	printf("\ttest %%ecx, %%ecx\n");
+	printf("\tjs %s_clip_h\n", name);
+	printf("\tcmp $%d, %%ecx\n", fbpitch - xsz);
+	printf("\tjg %s_clip_h\n", name);
+	/* fully visible horizontally, run the compiled rows */
+	printf("\tmov %%ebp, %%ecx\n");
+	printf("\tmov (%s), %s\n", REG_BX, REG_AX);
+	printf("\tjmp *(%s,%s,%d)\n\n", REG_AX, REG_SI, wsz);
+
+	/* span tables, with both ends clipped to lx <= x < rx in sprite space */
+	printf("%s_clip_h:\n", name);
+	printf("\tcmp $%d, %%ecx\n", -xsz);
+	printf("\tjle %s_clip_done\n", name);
+	printf("\tcmp $%d, %%ecx\n", fbpitch);
+	printf("\tjge %s_clip_done\n", name);
+	printf("\txor %%eax, %%eax\n");
+	printf("\tsub %%ecx, %%eax\n");
+	printf("\tjns 0f\n");
+	printf("\txor %%eax, %%eax\n");
+	printf("0:\tpush %s\n", REG_AX);
+	printf("\tmov $%d, %%eax\n", fbpitch);
+	printf("\tsub %%ecx, %%eax\n");
+	printf("\tcmp $%d, %%eax\n", xsz);
+	printf("\tjle 0f\n");
+	printf("\tmov $%d, %%eax\n", xsz);
+	printf("0:\tpush %s\n", REG_AX);
+	printf("\tmov %d(%s), %s\n", wsz, REG_BX, REG_AX);
+	printf("\tmov (%s,%s,%d), %s\n", REG_AX, REG_SI, wsz, REG_SI);
+	/* stack: next span, rx, lx */
+	printf("%s_clip_row:\n", name);
+	printf("\tmovzwl (%s), %%ebx\n", REG_SI);
+	printf("\tadd $2, %s\n", REG_SI);
+	printf("\ttest %%ebx, %%ebx\n");
+	printf("\tjz 5f\n");
+	printf("1:\tmovzwl (%s), %%eax\n", REG_SI);
+	printf("\tmovzwl 2(%s), %%ecx\n", REG_SI);
+	printf("\tadd $4, %s\n", REG_SI);
+	printf("\tlea (%s,%s), %s\n", REG_SI, REG_CX, REG_DI);
+	printf("\tpush %s\n", REG_DI);
+	printf("\tadd %%eax, %%ecx\n");
+	printf("\tcmp %d(%s), %%ecx\n", wsz, REG_SP);
+	printf("\tjle 2f\n");
+	printf("\tmov %d(%s), %%ecx\n", wsz, REG_SP);
+	printf("2:\tcmp %d(%s), %%eax\n", wsz * 2, REG_SP);
+	printf("\tjge 3f\n");
+	printf("\tmov %d(%s), %%edi\n", wsz * 2, REG_SP);
+	printf("\tsub %%eax, %%edi\n");
+	printf("\tadd %s, %s\n", REG_DI, REG_SI);
+	printf("\tmov %d(%s), %%eax\n", wsz * 2, REG_SP);
+	printf("3:\tsub %%eax, %%ecx\n");
+	printf("\tjle 4f\n");
+	printf("\tlea (%s,%s), %s\n", REG_DX, REG_AX, REG_DI);
+	printf("\trep movsb\n");
+	printf("4:\tpop %s\n", REG_SI);
+	printf("\tdec %%ebx\n");
+	printf("\tjnz 1b\n");
+	printf("5:\tadd $%d, %s\n", fbpitch, REG_DX);
+	printf("\tdec %%ebp\n");
+	printf("\tjnz %s_clip_row\n", name);
+	printf("\tadd $%d, %s\n\n", wsz * 2, REG_SP);
+
+	printf("%s_clip_done:\n", name);
+	printf("\tpop %s\n\tpop %s\n\tpop %s\n\tpop %s\n", REG_DI, REG_SI, REG_BX, REG_BP);
+	printf("\tret\n\n");
+
+	printf("%s_ctab:\n", name);
+	for(i=0; i<ntiles; i++) {
+		printf("\t%s ctile%d_rows, ctile%d_spans\n", DATA_PTR, i, i);
+	}
+	putchar('\n');
 
-		default:
-			printf("\t# invalid op: %d\n", optr->op);
+	for(i=0; i<ntiles; i++) {
+		printf("ctile%d_rows:\n", i);
+		for(j=0; j<ysz; j++) {
+			printf("\t%s ctile%d_r%d\n", DATA_PTR, i, j);
+		}
+		printf("ctile%d_spans:\n", i);
+		for(j=0; j<ysz; j++) {
+			printf("\t%s ctile%d_s%d\n", DATA_PTR, i, j);
+		}
+		for(j=0; j<ysz; j++) {
+			row = tiles[i].rows + j;
+			printf("ctile%d_s%d:\n", i, j);
+			printf("\t.short %d\n", row->nspans);
+			for(k=0; k<row->nspans; k++) {
+				emit_span_data(row->spans + k);
+			}
 		}
-		optr++;
+		putchar('\n');
 	}
-	printf("\tret\n");
 
+	for(i=0; i<ntiles; i++) {
+		printf("ctile%d:\n", i);
+		csprite(tiles + i, i, 1);
+	}
 	return 0;
 }
 
+/* span table entry: x and length, followed by the pixels */
+static void emit_span_data(struct span *span)
+{
+	int i;
+
+	printf("\t.short %d, %d\n", span->x, span->len);
+	for(i=0; i<span->len; i++) {
+		printf(i & 15 ? ", %d" : "\t.byte %d", span->pix[i]);
+		if((i & 15) == 15 || i == span->len - 1) {
+			putchar('\n');
+		}
+	}
+}
+
 void print_usage(const char *argv0)
 {
 	printf("Usage: %s [options] <spritesheet>\n", argv0);
@@ -279,6 +458,9 @@ void print_usage(const char *argv0)
 	printf(" -r,-rect <WxH+X+Y>: use rectangle of the input image (default: whole image)\n");
 	printf(" -coffset <offs>: colormap offset [0, 255] (default: 0)\n");
 	printf(" -fbpitch <pitch>: target framebuffer pitch (scanline size in bytes)\n");
+	printf(" -fbheight <lines>: target framebuffer height, for clipping (default: 200)\n");
 	printf(" -k,-key <color>: color-key for transparency (default: 0)\n");
+	printf(" -clip: also generate <name>_clip, which clips to the framebuffer\n");
+	printf(" -m64: generate x86-64 code (for the host benchmark)\n");
 	printf(" -h: print usage and exit\n");
 }
@@ -0,0 +1,62 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "image.h"
+#include "spans.h"
+
+int build_spans(struct spimage *sp, struct image *img, int x, int y, int xsz, int ysz,
+		int ckey, int coffs)
+{
+	int i, j, start;
+	unsigned char *sptr, *dptr;
+	struct span *span;
+
+	sp->width = xsz;
+	sp->height = ysz;
+	sp->pixels = malloc(xsz * ysz);
+	sp->rows = malloc(ysz * sizeof *sp->rows);
+	/* at most one span every two pixels */
+	span = malloc(ysz * (xsz / 2 + 1) * sizeof *span);
+	if(!sp->pixels || !sp->rows || !span) {
+		perror("failed to allocate sprite spans");
+		free(sp->pixels);
+		free(sp->rows);
+		free(span);
+		return -1;
+	}
+
+	dptr = sp->pixels;
+	for(i=0; i<ysz; i++) {
+		sptr = img->pixels + (y + i) * img->scansz + x;
+		sp->rows[i].spans = span;
+		sp->rows[i].nspans = 0;
+
+		start = -1;
+		for(j=0; j<=xsz; j++) {
+			if(j < xsz && sptr[j] != ckey) {
+				if(start < 0) start = j;
+				dptr[j] = sptr[j] + coffs;
+			} else {
+				if(j < xsz) dptr[j] = 0;
+				if(start >= 0) {
+					span->x = start;
+					span->len = j - start;
+					span->pix = dptr + start;
+					span++;
+					sp->rows[i].nspans++;
+					start = -1;
+				}
+			}
+		}
+		dptr += xsz;
+	}
+	return 0;
+}
+
+void free_spans(struct spimage *sp)
+{
+	if(sp->rows) {
+		free(sp->rows[0].spans);
+	}
+	free(sp->rows);
+	free(sp->pixels);
+}
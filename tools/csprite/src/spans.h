@@ -0,0 +1,26 @@
+#ifndef SPANS_H_
+#define SPANS_H_
+
+/* a run of opaque pixels in a sprite row */
+struct span {
+	int x, len;
+	unsigned char *pix;
+};
+
+struct sprow {
+	int nspans;
+	struct span *spans;
+};
+
+struct spimage {
+	int width, height;
+	struct sprow *rows;
+	unsigned char *pixels;	/* width x height, with the colormap offset added */
+};
+
+/* extracts the opaque spans of the xsz by ysz rect at x,y of an 8bpp image */
+int build_spans(struct spimage *sp, struct image *img, int x, int y, int xsz, int ysz,
+		int ckey, int coffs);
+void free_spans(struct spimage *sp);
+
+#endif	/* SPANS_H_ */
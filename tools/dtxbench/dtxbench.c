@@ -0,0 +1,247 @@
+/*
+256boss - bootable launcher for 256byte intros
+Copyright (C) 2018-2020  John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY, without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+/* compares the libdrawtext distance field generator against the old
+ * brute-force search it replaced, on large synthetic glyph maps.
+ *
+ * usage: dtxbench [size] [glyph size]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include <sys/time.h>
+#include "drawtext.h"
+#include "drawtext_impl.h"
+
+static void gen_glyphs(unsigned char *pixels, int xsz, int ysz, int gsz);
+static void calc_distfield_brute(struct dtx_glyphmap *gmap, unsigned char *dest);
+static long get_usec(void);
+
+int main(int argc, char **argv)
+{
+	int i, shift, num_pixels, diff, dist, max_err = 0, num_err = 0, win_err = 0;
+	int xsz = 1024, gsz = 32;
+	long t0, t_brute, t_edt;
+	unsigned char *orig, *ref;
+	struct dtx_glyphmap gmap;
+
+	if(argc > 1 && (xsz = atoi(argv[1])) <= 0) {
+		fprintf(stderr, "invalid size: %s\n", argv[1]);
+		return 1;
+	}
+	if(argc > 2 && (gsz = atoi(argv[2])) <= 0) {
+		fprintf(stderr, "invalid glyph size: %s\n", argv[2]);
+		return 1;
+	}
+	for(shift=0; (1 << shift) < xsz; shift++);
+	xsz = 1 << shift;
+	num_pixels = xsz * xsz;
+
+	memset(&gmap, 0, sizeof gmap);
+	gmap.xsz = gmap.ysz = xsz;
+	gmap.xsz_shift = shift;
+
+	if(!(orig = malloc(num_pixels)) || !(ref = malloc(num_pixels)) ||
+			!(gmap.pixels = malloc(num_pixels))) {
+		fprintf(stderr, "failed to allocate %dx%d glyphmap\n", xsz, xsz);
+		return 1;
+	}
+	gen_glyphs(orig, xsz, xsz, gsz);
+
+	printf("%dx%d glyphmap, %dpx glyphs\n", xsz, xsz, gsz);
+
+	memcpy(gmap.pixels, orig, num_pixels);
+	t0 = get_usec();
+	calc_distfield_brute(&gmap, ref);
+	t_brute = get_usec() - t0;
+	printf("  brute force: %8.2f ms\n", t_brute / 1000.0);
+
+	memcpy(gmap.pixels, orig, num_pixels);
+	t0 = get_usec();
+	if(dtx_calc_glyphmap_distfield(&gmap) == -1) {
+		return 1;
+	}
+	t_edt = get_usec() - t0;
+	printf("  linear EDT:  %8.2f ms (%.1fx)\n", t_edt / 1000.0, (double)t_brute / t_edt);
+
+	for(i=0; i<num_pixels; i++) {
+		diff = abs((int)gmap.pixels[i] - (int)ref[i]);
+		if(diff) {
+			num_err++;
+			if(diff > max_err) max_err = diff;
+
+			/* the brute force search gives up beyond 64 pixels */
+			dist = gmap.pixels[i] >= 128 ? gmap.pixels[i] - 128 : 127 - gmap.pixels[i];
+			if(dist < 64) win_err++;
+		}
+	}
+	printf("  max error: %d, %d of %d pixels differ (%d within 64px)\n", max_err, num_err,
+			num_pixels, win_err);
+
+	free(orig);
+	free(ref);
+	free(gmap.pixels);
+	return 0;
+}
+
+/* rows of blobby "glyphs": a few overlapping discs and strokes per cell, with
+ * large empty areas around them like a real glyphmap.
+ */
+static void gen_glyphs(unsigned char *pixels, int xsz, int ysz, int gsz)
+{
+	int i, j, k, gx, gy, cx, cy, rad, x0, y0, x1, y1, len;
+	int pad = gsz / 4;
+
+	memset(pixels, 0, xsz * ysz);
+	srand(0);
+
+	for(gy=pad; gy + gsz <= ysz; gy += gsz + pad) {
+		for(gx=pad; gx + gsz <= xsz; gx += gsz + pad) {
+			for(k=0; k<3; k++) {
+				rad = gsz / 8 + rand() % (gsz / 6 + 1);
+				cx = gx + rad + rand() % (gsz - 2 * rad + 1);
+				cy = gy + rad + rand() % (gsz - 2 * rad + 1);
+				for(i=-rad; i<=rad; i++) {
+					for(j=-rad; j<=rad; j++) {
+						if(i * i + j * j <= rad * rad) {
+							pixels[(cy + i) * xsz + cx + j] = 200;
+						}
+					}
+				}
+			}
+			/* a vertical stroke */
+			x0 = gx + rand() % (gsz - 2);
+			y0 = gy;
+			len = gsz / 2 + rand() % (gsz / 2);
+			for(i=0; i<len; i++) {
+				for(j=0; j<2; j++) {
+					pixels[(y0 + i) * xsz + x0 + j] = 255;
+				}
+			}
+			/* and some antialiased edge noise */
+			x1 = gx + rand() % gsz;
+			y1 = gy + rand() % gsz;
+			pixels[y1 * xsz + x1] = rand() & 0xff;
+		}
+	}
+}
+
+#define GET_PIXEL(gm, x, y) ((gm)->pixels[((y) << (gm)->xsz_shift) + (x)])
+
+/* the original libdrawtext distance field code, searching a window of up to
+ * max_dist pixels around each pixel for the nearest pixel of the opposite value
+ */
+static int calc_distance(struct dtx_glyphmap *gmap, int x, int y, int max_dist)
+{
+	int i, j, startx, starty, endx, endy, px, py;
+	int bwidth, bheight;
+	int min_distsq = INT_MAX;
+	unsigned char cpix = GET_PIXEL(gmap, x, y);
+	int dist;
+
+	if(max_dist > 128) max_dist = 128;
+
+	startx = x >= max_dist ? x - max_dist : 0;
+	starty = y >= max_dist ? y - max_dist : 0;
+	endx = x + max_dist < gmap->xsz ? x + max_dist : gmap->xsz - 1;
+	endy = y + max_dist < gmap->ysz ? y + max_dist : gmap->ysz - 1;
+
+	/* try the cardinal directions first to find the search bounding box */
+	for(i=0; i<4; i++) {
+		int max_dist = x - startx;
+		for(j=0; j<max_dist; j++) {
+			if(GET_PIXEL(gmap, x - j, y) != cpix) {
+				startx = x - j;
+				break;
+			}
+		}
+		max_dist = endx + 1 - x;
+		for(j=0; j<max_dist; j++) {
+			if(GET_PIXEL(gmap, x + j, y) != cpix) {
+				endx = x + j;
+				break;
+			}
+		}
+		max_dist = y - starty;
+		for(j=0; j<max_dist; j++) {
+			if(GET_PIXEL(gmap, x, y - j) != cpix) {
+				starty = y - j;
+				break;
+			}
+		}
+		max_dist = endy + 1 - y;
+		for(j=0; j<max_dist; j++) {
+			if(GET_PIXEL(gmap, x, y + j) != cpix) {
+				endy = y + j;
+				break;
+			}
+		}
+	}
+
+	/* find the minimum squared distance inside the bounding box */
+	bwidth = endx + 1 - startx;
+	bheight = endy + 1 - starty;
+
+	py = starty;
+	for(i=0; i<bheight; i++) {
+		px = startx;
+		for(j=0; j<bwidth; j++) {
+			if(GET_PIXEL(gmap, px, py) != cpix) {
+				int dx = px - x;
+				int dy = py - y;
+				int distsq = dx * dx + dy * dy;
+
+				if(distsq < min_distsq) {
+					min_distsq = distsq;
+				}
+			}
+			++px;
+		}
+		++py;
+	}
+
+	dist = (int)sqrt(min_distsq);
+	if(dist > 127) dist = 127;
+
+	return cpix ? dist + 128 : 127 - dist;
+}
+
+static void calc_distfield_brute(struct dtx_glyphmap *gmap, unsigned char *dest)
+{
+	int i, j, num_pixels = gmap->xsz * gmap->ysz;
+	unsigned char *pptr = gmap->pixels;
+
+	for(i=0; i<num_pixels; i++) {
+		*pptr = *pptr < 128 ? 0 : 255;
+		pptr++;
+	}
+
+	for(i=0; i<gmap->ysz; i++) {
+		for(j=0; j<gmap->xsz; j++) {
+			*dest++ = calc_distance(gmap, j, i, 64);
+		}
+	}
+}
+
+static long get_usec(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	return tv.tv_sec * 1000000 + tv.tv_usec;
+}
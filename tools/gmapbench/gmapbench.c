@@ -0,0 +1,266 @@
+/*
+256boss - bootable launcher for 256byte intros
+Copyright (C) 2018-2020  John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY, without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+/* compares libdrawtext glyphmap load times between the textual PGM format
+ * and the binary format, raw and deflated, on a synthetic glyphmap.
+ *
+ * usage: gmapbench [size] [iterations]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "drawtext.h"
+#include "drawtext_impl.h"
+
+#define FIRST_CHAR	32
+#define NUM_GLYPHS	96
+
+static struct dtx_glyphmap *gen_glyphmap(int xsz);
+static int save_text(const char *fname, struct dtx_glyphmap *gmap);
+static void *load_file(const char *fname, long *size);
+static int cmp_glyphmap(struct dtx_glyphmap *a, struct dtx_glyphmap *b);
+static long file_size(const char *fname);
+static long get_usec(void);
+
+static const char *fname_text = "gmapbench.pgm";
+static const char *fname_raw = "gmapbench.raw.gmap";
+static const char *fname_zip = "gmapbench.zip.gmap";
+
+int main(int argc, char **argv)
+{
+	int i, j, xsz = 1024, iter = 20;
+	long t0, usec, size;
+	void *buf;
+	struct dtx_glyphmap *gmap, *res;
+	static const char *fmtname[] = {"text PGM", "binary", "binary+deflate", "binary in memory"};
+	const char *fname[] = {fname_text, fname_raw, fname_zip, fname_raw};
+
+	if(argc > 1 && (xsz = atoi(argv[1])) < 256) {
+		fprintf(stderr, "invalid size: %s\n", argv[1]);
+		return 1;
+	}
+	if(argc > 2 && (iter = atoi(argv[2])) <= 0) {
+		fprintf(stderr, "invalid iteration count: %s\n", argv[2]);
+		return 1;
+	}
+
+	if(!(gmap = gen_glyphmap(xsz))) {
+		return 1;
+	}
+	if(save_text(fname_text, gmap) == -1) {
+		return 1;
+	}
+	dtx_set(DTX_SAVE_DEFLATE, 0);
+	if(dtx_save_glyphmap(fname_raw, gmap) == -1) {
+		return 1;
+	}
+	dtx_set(DTX_SAVE_DEFLATE, 1);
+	if(dtx_save_glyphmap(fname_zip, gmap) == -1) {
+		return 1;
+	}
+
+	printf("%dx%d glyphmap, %d glyphs, %d loads each\n", gmap->xsz, gmap->ysz,
+			gmap->crange, iter);
+
+	for(i=0; i<4; i++) {
+		buf = i == 3 ? load_file(fname[i], &size) : 0;
+		if(i == 3 && !buf) return 1;
+
+		usec = 0;
+		for(j=0; j<iter; j++) {
+			t0 = get_usec();
+			if(buf) {
+				res = dtx_load_glyphmap_mem(buf, size);
+			} else {
+				res = dtx_load_glyphmap(fname[i]);
+			}
+			usec += get_usec() - t0;
+
+			if(!res || cmp_glyphmap(gmap, res) == -1) {
+				fprintf(stderr, "%s: loaded glyphmap doesn't match\n", fmtname[i]);
+				return 1;
+			}
+			dtx_free_glyphmap(res);
+		}
+		printf("  %-17s %8ld bytes %9.3f ms/load\n", fmtname[i], file_size(fname[i]),
+				(double)usec / iter / 1000.0);
+		free(buf);
+	}
+
+	dtx_free_glyphmap(gmap);
+	remove(fname_text);
+	remove(fname_raw);
+	remove(fname_zip);
+	return 0;
+}
+
+/* a grid of glyph cells with blobby antialiased shapes in them */
+static struct dtx_glyphmap *gen_glyphmap(int xsz)
+{
+	int i, j, k, cx, cy, rad, dsq, shift;
+	int cellsz = xsz / 16, ysz;
+	struct dtx_glyphmap *gmap;
+	struct glyph *g;
+
+	for(shift=0; (1 << shift) < xsz; shift++);
+	xsz = 1 << shift;
+	ysz = xsz / 2;
+
+	if(!(gmap = calloc(1, sizeof *gmap)) || !(gmap->pixels = calloc(1, xsz * ysz)) ||
+			!(gmap->glyphs = calloc(NUM_GLYPHS, sizeof *gmap->glyphs))) {
+		fprintf(stderr, "failed to allocate %dx%d glyphmap\n", xsz, ysz);
+		return 0;
+	}
+	gmap->xsz = xsz;
+	gmap->ysz = ysz;
+	gmap->xsz_shift = shift;
+	gmap->ptsize = cellsz * 3 / 4;
+	gmap->line_advance = cellsz;
+	gmap->cstart = FIRST_CHAR;
+	gmap->cend = FIRST_CHAR + NUM_GLYPHS;
+	gmap->crange = NUM_GLYPHS;
+
+	srand(0);
+	for(i=0; i<NUM_GLYPHS; i++) {
+		g = gmap->glyphs + i;
+		g->code = FIRST_CHAR + i;
+		g->x = (i & 15) * cellsz + 2;
+		g->y = (i >> 4) * cellsz + 2;
+		g->width = cellsz - 4 - rand() % (cellsz / 4);
+		g->height = cellsz - 4;
+		g->orig_x = 0;
+		g->orig_y = g->height * 3 / 4;
+		g->advance = g->width + 1;
+		g->nx = g->x / xsz;
+		g->ny = g->y / ysz;
+		g->nwidth = g->width / xsz;
+		g->nheight = g->height / ysz;
+
+		for(k=0; k<3; k++) {
+			rad = cellsz / 8 + rand() % (cellsz / 8);
+			cx = g->x + rad + rand() % ((int)g->width - 2 * rad);
+			cy = g->y + rad + rand() % ((int)g->height - 2 * rad);
+			for(j=-rad; j<=rad; j++) {
+				int x, y = cy + j;
+				for(x=cx-rad; x<=cx+rad; x++) {
+					dsq = (x - cx) * (x - cx) + j * j;
+					if(dsq <= rad * rad) {
+						int c = 255 - 255 * dsq / (rad * rad) / 4;
+						if(c > gmap->pixels[y * xsz + x]) {
+							gmap->pixels[y * xsz + x] = c;
+						}
+					}
+				}
+			}
+		}
+	}
+	return gmap;
+}
+
+/* the textual format read by dtx_load_glyphmap */
+static int save_text(const char *fname, struct dtx_glyphmap *gmap)
+{
+	int i;
+	FILE *fp;
+	struct glyph *g = gmap->glyphs;
+
+	if(!(fp = fopen(fname, "wb"))) {
+		perror("failed to write text glyphmap");
+		return -1;
+	}
+	fprintf(fp, "P5\n");
+	fprintf(fp, "# size: %d\n", gmap->ptsize);
+	fprintf(fp, "# advance: %g\n", gmap->line_advance);
+	for(i=0; i<gmap->crange; i++) {
+		fprintf(fp, "# %d: %gx%g+%g+%g o:%g,%g adv:%g\n", g->code, g->width, g->height,
+				g->x, g->y, g->orig_x, g->orig_y, g->advance);
+		g++;
+	}
+	fprintf(fp, "%d %d\n255\n", gmap->xsz, gmap->ysz);
+	fwrite(gmap->pixels, 1, gmap->xsz * gmap->ysz, fp);
+	fclose(fp);
+	return 0;
+}
+
+static void *load_file(const char *fname, long *size)
+{
+	FILE *fp;
+	void *buf;
+
+	if(!(fp = fopen(fname, "rb"))) {
+		perror("failed to open glyphmap");
+		return 0;
+	}
+	fseek(fp, 0, SEEK_END);
+	*size = ftell(fp);
+	rewind(fp);
+
+	if(!(buf = malloc(*size)) || fread(buf, 1, *size, fp) != *size) {
+		fprintf(stderr, "failed to read %s\n", fname);
+		free(buf);
+		fclose(fp);
+		return 0;
+	}
+	fclose(fp);
+	return buf;
+}
+
+static int cmp_glyphmap(struct dtx_glyphmap *a, struct dtx_glyphmap *b)
+{
+	int i;
+	struct glyph *ga, *gb;
+
+	if(a->xsz != b->xsz || a->ysz != b->ysz || a->ptsize != b->ptsize ||
+			a->cstart != b->cstart || a->cend != b->cend || a->line_advance != b->line_advance) {
+		return -1;
+	}
+	if(memcmp(a->pixels, b->pixels, a->xsz * a->ysz) != 0) {
+		return -1;
+	}
+	for(i=0; i<a->crange; i++) {
+		ga = a->glyphs + i;
+		gb = b->glyphs + i;
+		if(ga->code != gb->code || ga->x != gb->x || ga->y != gb->y ||
+				ga->width != gb->width || ga->height != gb->height ||
+				ga->advance != gb->advance) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static long file_size(const char *fname)
+{
+	long sz;
+	FILE *fp;
+
+	if(!(fp = fopen(fname, "rb"))) {
+		return -1;
+	}
+	fseek(fp, 0, SEEK_END);
+	sz = ftell(fp);
+	fclose(fp);
+	return sz;
+}
+
+static long get_usec(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	return tv.tv_sec * 1000000 + tv.tv_usec;
+}
@@ -0,0 +1,147 @@
+/*
+256boss - bootable launcher for 256byte intros
+Copyright (C) 2018-2020  John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY, without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+/* converts a PNG image into the pre-decoded format loaded by load_image_cache
+ * (see src/imgcache.h), optionally adding a palette offset to all pixels, so
+ * that the splash screen doesn't have to run libpng at every boot.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "image.h"
+#include "imgcache.h"
+
+static int file_stamp(const char *fname, uint32_t *size, unsigned char *stamp);
+static void put16(void *ptr, unsigned int val);
+static void put32(void *ptr, unsigned long val);
+
+int main(int argc, char **argv)
+{
+	int i, coffs = 0;
+	char *endp;
+	const char *infile = 0, *outfile = 0;
+	uint32_t src_size;
+	unsigned char src_stamp[IMGCACHE_STAMP_SIZE];
+	struct image img;
+	struct imgcache_header hdr;
+	FILE *fp;
+
+	for(i=1; i<argc; i++) {
+		if(strcmp(argv[i], "-coffset") == 0) {
+			if(!argv[++i] || (coffs = strtol(argv[i], &endp, 10), endp == argv[i]) ||
+					coffs < 0 || coffs > 255) {
+				fprintf(stderr, "-coffset must be followed by a color offset (0-255)\n");
+				return 1;
+			}
+		} else if(!infile) {
+			infile = argv[i];
+		} else if(!outfile) {
+			outfile = argv[i];
+		} else {
+			fprintf(stderr, "unexpected argument: %s\n", argv[i]);
+			return 1;
+		}
+	}
+	if(!outfile) {
+		fprintf(stderr, "usage: %s [-coffset <offs>] <input png> <output file>\n", argv[0]);
+		return 1;
+	}
+
+	if(load_image(&img, infile) == -1) {
+		fprintf(stderr, "failed to load image: %s\n", infile);
+		return 1;
+	}
+	if(file_stamp(infile, &src_size, src_stamp) == -1) {
+		return 1;
+	}
+	if(coffs) {
+		if(img.bpp != 8) {
+			fprintf(stderr, "%s: color offset only applies to 8bpp images\n", infile);
+			return 1;
+		}
+		image_color_offset(&img, coffs);
+	}
+
+	memcpy(hdr.magic, IMGCACHE_MAGIC, sizeof hdr.magic);
+	put16(&hdr.width, img.width);
+	put16(&hdr.height, img.height);
+	put16(&hdr.pitch, img.pitch);
+	hdr.bpp = img.bpp;
+	hdr.nchan = img.nchan;
+	put16(&hdr.cmap_ncolors, img.cmap_ncolors);
+	put16(&hdr.col_offs, coffs);
+	put32(&hdr.src_size, src_size);
+	memcpy(hdr.src_stamp, src_stamp, sizeof hdr.src_stamp);
+
+	if(!(fp = fopen(outfile, "wb"))) {
+		fprintf(stderr, "failed to open %s for writing: %s\n", outfile, strerror(errno));
+		return 1;
+	}
+	fwrite(&hdr, sizeof hdr, 1, fp);
+	fwrite(img.cmap, sizeof *img.cmap, img.cmap_ncolors, fp);
+	fwrite(img.pixels, img.pitch, img.height, fp);
+	if(fclose(fp) == EOF) {
+		fprintf(stderr, "failed to write %s: %s\n", outfile, strerror(errno));
+		return 1;
+	}
+
+	free(img.pixels);
+	return 0;
+}
+
+/* the size of the PNG, and the CRC of its last chunk before IEND */
+static int file_stamp(const char *fname, uint32_t *size, unsigned char *stamp)
+{
+	FILE *fp;
+	long sz;
+
+	if(!(fp = fopen(fname, "rb"))) {
+		fprintf(stderr, "failed to open %s: %s\n", fname, strerror(errno));
+		return -1;
+	}
+	fseek(fp, 0, SEEK_END);
+	sz = ftell(fp);
+
+	if(sz < 16 || fseek(fp, IMGCACHE_STAMP_OFFS(sz), SEEK_SET) == -1 ||
+			fread(stamp, 1, IMGCACHE_STAMP_SIZE, fp) != IMGCACHE_STAMP_SIZE) {
+		fprintf(stderr, "failed to read %s\n", fname);
+		fclose(fp);
+		return -1;
+	}
+	fclose(fp);
+
+	*size = sz;
+	return 0;
+}
+
+/* the file is little-endian, regardless of the host */
+static void put16(void *ptr, unsigned int val)
+{
+	unsigned char *p = ptr;
+	p[0] = val & 0xff;
+	p[1] = (val >> 8) & 0xff;
+}
+
+static void put32(void *ptr, unsigned long val)
+{
+	unsigned char *p = ptr;
+	p[0] = val & 0xff;
+	p[1] = (val >> 8) & 0xff;
+	p[2] = (val >> 16) & 0xff;
+	p[3] = (val >> 24) & 0xff;
+}
@@ -0,0 +1,359 @@
+/*
+256boss - bootable launcher for 256byte intros
+Copyright (C) 2018-2020  John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY, without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+/* inflate throughput on the data assets and a synthetic corpus. Build both
+ * infbench and infbench-stock (see the Makefile) and compare their output:
+ * the crc column must match between the two.
+ *
+ * Each input is inflated into one big buffer, and again through a small
+ * output buffer the size of a scanline, which is how libpng drives zlib.
+ * PNG files are inflated from their concatenated IDAT chunks, anything else
+ * is deflated first.
+ *
+ * usage: infbench [-s corpus size in MB] [-c chunk size] [files...]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "zlib.h"
+
+/* best of ROUNDS runs of at least ROUND_USEC each */
+#define ROUNDS		5
+#define ROUND_USEC	200000
+
+struct stream {
+	const char *name;
+	unsigned char *zdata, *data;
+	unsigned long zsize, size;
+};
+
+static int bench(struct stream *s, int chunk);
+static int run_inflate(struct stream *s, unsigned char *dest, int chunk);
+static int load_stream(struct stream *s, const char *fname);
+static int load_png_idat(struct stream *s, unsigned char *buf, long size);
+static int gen_corpus(struct stream *s, unsigned long size);
+static int deflate_stream(struct stream *s);
+static unsigned long get_be32(unsigned char *ptr);
+static long get_usec(void);
+
+static const char *def_files[] = {"../../data/bos.png", "../../data/tunnel.lut", 0};
+
+int main(int argc, char **argv)
+{
+	int i, chunk = 321, nfiles = 0;
+	unsigned long corpus_size = 16;
+	const char **files = malloc(argc * sizeof *files);
+	struct stream s;
+
+	for(i=1; i<argc; i++) {
+		if(strcmp(argv[i], "-s") == 0 && i < argc - 1) {
+			corpus_size = atoi(argv[++i]);
+		} else if(strcmp(argv[i], "-c") == 0 && i < argc - 1) {
+			if((chunk = atoi(argv[++i])) <= 0) {
+				fprintf(stderr, "invalid chunk size: %s\n", argv[i]);
+				return 1;
+			}
+		} else if(argv[i][0] == '-') {
+			fprintf(stderr, "usage: %s [-s corpus MB] [-c chunk size] [files...]\n", argv[0]);
+			return 1;
+		} else {
+			files[nfiles++] = argv[i];
+		}
+	}
+	if(!nfiles) {
+		files = def_files;
+		while(files[nfiles]) nfiles++;
+	}
+
+	printf("%s, %d byte chunks\n", argv[0], chunk);
+	printf("%-14s %9s %9s %9s %10s %10s\n", "input", "size", "packed", "crc",
+			"MB/s", "MB/s chunk");
+
+	for(i=0; i<nfiles; i++) {
+		if(load_stream(&s, files[i]) == -1 || bench(&s, chunk) == -1) {
+			return 1;
+		}
+		free(s.data);
+		free(s.zdata);
+	}
+
+	if(corpus_size) {
+		if(gen_corpus(&s, corpus_size << 20) == -1 || deflate_stream(&s) == -1 ||
+				bench(&s, chunk) == -1) {
+			return 1;
+		}
+		free(s.data);
+		free(s.zdata);
+	}
+	return 0;
+}
+
+static int bench(struct stream *s, int chunk)
+{
+	int i, j, n;
+	long t0, usec;
+	double mbs[2];
+	unsigned char *dest;
+
+	if(!(dest = malloc(s->size))) {
+		fprintf(stderr, "failed to allocate %lu bytes\n", s->size);
+		return -1;
+	}
+
+	for(i=0; i<2; i++) {
+		mbs[i] = 0;
+		for(j=0; j<ROUNDS; j++) {
+			n = 0;
+			t0 = get_usec();
+			do {
+				if(run_inflate(s, dest, i ? chunk : 0) == -1) {
+					fprintf(stderr, "%s: inflate failed\n", s->name);
+					free(dest);
+					return -1;
+				}
+				n++;
+			} while((usec = get_usec() - t0) < ROUND_USEC);
+
+			if(memcmp(dest, s->data, s->size) != 0) {
+				fprintf(stderr, "%s: inflated data doesn't match\n", s->name);
+				free(dest);
+				return -1;
+			}
+			if((double)s->size * n / usec > mbs[i]) {
+				mbs[i] = (double)s->size * n / usec;
+			}
+		}
+	}
+
+	printf("%-14s %9lu %9lu %08lx %10.1f %10.1f\n", s->name, s->size, s->zsize,
+			crc32(0, dest, s->size), mbs[0], mbs[1]);
+	free(dest);
+	return 0;
+}
+
+/* inflate the whole stream into dest, chunk bytes of output at a time if
+ * chunk is not 0, copying each chunk out like libpng copies its row buffer.
+ */
+static int run_inflate(struct stream *s, unsigned char *dest, int chunk)
+{
+	int res;
+	z_stream zs;
+	static unsigned char *buf;
+	static int bufsz;
+
+	if(chunk > bufsz) {
+		free(buf);
+		if(!(buf = malloc(chunk))) {
+			bufsz = 0;
+			return -1;
+		}
+		bufsz = chunk;
+	}
+
+	memset(&zs, 0, sizeof zs);
+	if(inflateInit(&zs) != Z_OK) {
+		return -1;
+	}
+	zs.next_in = s->zdata;
+	zs.avail_in = s->zsize;
+
+	if(!chunk) {
+		zs.next_out = dest;
+		zs.avail_out = s->size;
+		res = inflate(&zs, Z_FINISH);
+	} else {
+		do {
+			zs.next_out = buf;
+			zs.avail_out = chunk;
+			res = inflate(&zs, Z_NO_FLUSH);
+			memcpy(dest, buf, chunk - zs.avail_out);
+			dest += chunk - zs.avail_out;
+		} while(res == Z_OK);
+	}
+	inflateEnd(&zs);
+	return res == Z_STREAM_END && zs.total_out == s->size ? 0 : -1;
+}
+
+static int load_stream(struct stream *s, const char *fname)
+{
+	FILE *fp;
+	long size;
+	unsigned char *buf;
+	const char *suffix;
+
+	if(!(fp = fopen(fname, "rb"))) {
+		perror(fname);
+		return -1;
+	}
+	fseek(fp, 0, SEEK_END);
+	size = ftell(fp);
+	rewind(fp);
+
+	if(!(buf = malloc(size)) || fread(buf, 1, size, fp) != size) {
+		fprintf(stderr, "failed to read: %s\n", fname);
+		fclose(fp);
+		free(buf);
+		return -1;
+	}
+	fclose(fp);
+
+	memset(s, 0, sizeof *s);
+	s->name = (suffix = strrchr(fname, '/')) ? suffix + 1 : fname;
+
+	if(size > 8 && memcmp(buf, "\x89PNG", 4) == 0) {
+		return load_png_idat(s, buf, size);
+	}
+	s->data = buf;
+	s->size = size;
+	return deflate_stream(s);
+}
+
+/* gather the IDAT chunks into one zlib stream, and inflate it once with the
+ * slow path only (tiny output buffer) to get the reference output.
+ */
+static int load_png_idat(struct stream *s, unsigned char *buf, long size)
+{
+	unsigned char *ptr = buf + 8, *end = buf + size;
+	unsigned long len, cap;
+	z_stream zs;
+	int res;
+
+	if(!(s->zdata = malloc(size))) {
+		free(buf);
+		return -1;
+	}
+	while(ptr + 12 <= end) {
+		len = get_be32(ptr);
+		if(ptr + 12 + len > end) break;
+		if(memcmp(ptr + 4, "IDAT", 4) == 0) {
+			memcpy(s->zdata + s->zsize, ptr + 8, len);
+			s->zsize += len;
+		}
+		ptr += 12 + len;
+	}
+	free(buf);
+
+	cap = s->zsize * 4 + 4096;
+	memset(&zs, 0, sizeof zs);
+	if(!(s->data = malloc(cap)) || inflateInit(&zs) != Z_OK) {
+		return -1;
+	}
+	zs.next_in = s->zdata;
+	zs.avail_in = s->zsize;
+	do {
+		if(zs.total_out == cap) {
+			cap *= 2;
+			if(!(s->data = realloc(s->data, cap))) {
+				return -1;
+			}
+		}
+		zs.next_out = s->data + zs.total_out;
+		zs.avail_out = 1;
+		res = inflate(&zs, Z_NO_FLUSH);
+	} while(res == Z_OK);
+	s->size = zs.total_out;
+	inflateEnd(&zs);
+
+	if(res != Z_STREAM_END) {
+		fprintf(stderr, "%s: bad IDAT stream\n", s->name);
+		return -1;
+	}
+	return 0;
+}
+
+/* a mix of the kind of data we inflate: palettized image scanlines with
+ * PNG filter bytes, plain byte runs, and text.
+ */
+static int gen_corpus(struct stream *s, unsigned long size)
+{
+	static const char *words[] = {
+		"boot", "intro", "256", "bytes", "mode", "13h", "palette", "tunnel",
+		"plasma", "int", "10h", "sector", "loader", "the", "a", "of", "com"
+	};
+	unsigned long i = 0, j, n, seed = 1;
+	unsigned char *ptr;
+	int k, x, y;
+
+	memset(s, 0, sizeof *s);
+	s->name = "synthetic";
+	if(!(s->data = malloc(size))) {
+		return -1;
+	}
+	ptr = s->data;
+	s->size = size;
+
+#define RND()	(seed = seed * 1103515245 + 12345, (seed >> 16) & 0x7fff)
+	while(i < size) {
+		switch(RND() % 3) {
+		case 0:		/* 320x200 8bpp image: filter byte + gradient with noise */
+			for(y=0; y<200 && i < size; y++) {
+				ptr[i++] = y & 1;
+				for(x=0; x<320 && i < size; x++) {
+					ptr[i++] = ((x + y) >> 2) + (RND() % 7 == 0 ? RND() & 3 : 0);
+				}
+			}
+			break;
+
+		case 1:		/* runs */
+			for(j=0; j<64 && i < size; j++) {
+				n = RND() % 200 + 1;
+				k = RND() & 0xff;
+				while(n-- && i < size) ptr[i++] = k;
+			}
+			break;
+
+		default:	/* text */
+			for(j=0; j<4096 && i < size; j++) {
+				const char *w = words[RND() % (sizeof words / sizeof *words)];
+				while(*w && i < size) ptr[i++] = *w++;
+				if(i < size) ptr[i++] = RND() % 9 ? ' ' : '\n';
+			}
+			break;
+		}
+	}
+#undef RND
+	return 0;
+}
+
+static int deflate_stream(struct stream *s)
+{
+	unsigned long cap = compressBound(s->size);
+
+	if(!(s->zdata = malloc(cap))) {
+		return -1;
+	}
+	s->zsize = cap;
+	if(compress2(s->zdata, &s->zsize, s->data, s->size, 9) != Z_OK) {
+		fprintf(stderr, "%s: failed to deflate\n", s->name);
+		return -1;
+	}
+	return 0;
+}
+
+static unsigned long get_be32(unsigned char *ptr)
+{
+	return ((unsigned long)ptr[0] << 24) | ((unsigned long)ptr[1] << 16) |
+		((unsigned long)ptr[2] << 8) | ptr[3];
+}
+
+static long get_usec(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	return tv.tv_sec * 1000000 + tv.tv_usec;
+}
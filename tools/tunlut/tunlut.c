@@ -0,0 +1,77 @@
+/*
+256boss - bootable launcher for 256byte intros
+Copyright (C) 2018-2020  John Tsiombikas <nuclear@member.fsf.org>
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY, without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+/* generates the splash screen tunnel LUT (data/tunnel.lut), so that it doesn't
+ * have to be computed at every boot.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "tunnel.h"
+
+int main(int argc, char **argv)
+{
+	int i, nent;
+	FILE *fp;
+	uint32_t *lut;
+	unsigned char *ptr;
+	struct tun_header hdr;
+
+	if(argc != 2) {
+		fprintf(stderr, "usage: %s <output file>\n", argv[0]);
+		return 1;
+	}
+
+	nent = TUN_WIDTH * TUN_HEIGHT;
+	if(!(lut = malloc(nent * sizeof *lut))) {
+		perror("failed to allocate tunnel LUT");
+		return 1;
+	}
+	tun_calc_rows(lut, 0, TUN_HEIGHT);
+
+	/* the file is little-endian, regardless of the host */
+	ptr = (unsigned char*)lut;
+	for(i=0; i<nent; i++) {
+		uint32_t e = lut[i];
+		*ptr++ = e & 0xff;
+		*ptr++ = (e >> 8) & 0xff;
+		*ptr++ = (e >> 16) & 0xff;
+		*ptr++ = e >> 24;
+	}
+
+	memcpy(hdr.magic, TUN_MAGIC, sizeof hdr.magic);
+	ptr = (unsigned char*)&hdr.width;
+	ptr[0] = TUN_WIDTH & 0xff;
+	ptr[1] = TUN_WIDTH >> 8;
+	ptr = (unsigned char*)&hdr.height;
+	ptr[0] = TUN_HEIGHT & 0xff;
+	ptr[1] = TUN_HEIGHT >> 8;
+
+	if(!(fp = fopen(argv[1], "wb"))) {
+		fprintf(stderr, "failed to open %s for writing: %s\n", argv[1], strerror(errno));
+		return 1;
+	}
+	if(fwrite(&hdr, sizeof hdr, 1, fp) < 1 || fwrite(lut, sizeof *lut, nent, fp) < nent) {
+		fprintf(stderr, "failed to write %s: %s\n", argv[1], strerror(errno));
+		fclose(fp);
+		return 1;
+	}
+	fclose(fp);
+	free(lut);
+	return 0;
+}